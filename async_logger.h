@@ -0,0 +1,300 @@
+/**
+ * @file async_logger.h
+ * @brief 异步日志 - 把std::cout移出生产者/消费者的热路径
+ *
+ * 直接在工作线程里写std::cout << ... << std::endl，所有线程都会串行在流的锁上，
+ * 而且每条日志都触发一次flush系统调用。AsyncLogger：
+ * - 每个线程第一次写日志时分配一个自己的缓冲区（SpscQueue），之后写日志无锁、无原子读-改-写
+ * - 后台线程周期性地收集所有缓冲区，按时间戳排序后批量写出，每批只flush一次
+ * - 缓冲区满时丢弃日志并计数，绝不阻塞调用线程
+ * - 可选限速模式：每条日志消耗一个token（由自己的TokenManager/TokenProducer提供），
+ *   超出速率的日志被抑制并计数
+ * 同一线程的日志保持顺序；不同线程的日志在同一批内按时间戳排序。
+ */
+
+#pragma once
+
+#include "spsc_queue.h"
+#include "token_manager.h"
+#include "token_producer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct AsyncLoggerConfig
+ * @brief 异步日志配置
+ */
+struct AsyncLoggerConfig {
+    size_t buffer_capacity = 4096;                  // 每个线程缓冲区的容量（条）
+    std::chrono::milliseconds flush_interval{50};   // 后台线程的写出周期
+    double rate_limit = 0.0;                        // 每秒最多输出的日志条数，0表示不限速
+    size_t burst = 100;                             // 限速模式下允许的突发条数
+};
+
+/**
+ * @class AsyncLogger
+ * @brief 每线程缓冲、后台批量写出的异步日志
+ */
+class AsyncLogger {
+private:
+    struct Record {
+        int64_t time_ns = 0;
+        std::string text;
+    };
+
+    // 一个线程的缓冲区：该线程写入，后台线程读出
+    struct Buffer {
+        explicit Buffer(size_t capacity) : records(capacity) {}
+
+        SpscQueue<Record> records;
+        std::atomic<bool> retired{false};   // 所属线程已退出，读空后可以移除
+        std::atomic<bool> closed{false};    // 日志对象已销毁，线程侧可以丢弃该缓冲区
+    };
+
+    // 当前线程在各个日志对象上的缓冲区
+    struct ThreadBuffers {
+        std::vector<std::pair<uint64_t, std::shared_ptr<Buffer>>> entries;
+
+        ~ThreadBuffers() {
+            for (auto& entry : entries) {
+                entry.second->retired.store(true);
+            }
+        }
+    };
+
+    const AsyncLoggerConfig config_;                 // 配置
+    const uint64_t id_;                              // 区分不同日志对象的ID
+    std::ostream& out_;                              // 输出流
+    std::vector<std::shared_ptr<Buffer>> buffers_;  // 所有线程的缓冲区
+    std::mutex buffers_mtx_;                         // 保护buffers_
+    std::shared_ptr<TokenManager> limiter_;          // 限速模式的token桶（不限速时为空）
+    std::unique_ptr<TokenProducer> limiter_producer_;
+    std::atomic<uint64_t> dropped_{0};               // 缓冲区满丢弃的条数
+    std::atomic<uint64_t> suppressed_{0};            // 超出速率被抑制的条数
+    uint64_t reported_dropped_ = 0;                  // 已报告过的丢弃条数（仅后台线程访问）
+    uint64_t reported_suppressed_ = 0;               // 已报告过的抑制条数（仅后台线程访问）
+    std::thread flush_thread_;                       // 后台写出线程
+    std::atomic<bool> running_{false};               // 运行标志
+    uint64_t flush_requests_ = 0;                    // Flush请求序号（受mtx_保护）
+    uint64_t flushed_ = 0;                           // 已完成的Flush请求序号（受mtx_保护）
+    std::mutex mtx_;                                 // 保护Flush请求和后台线程休眠
+    std::condition_variable cond_;                   // 唤醒后台线程
+    std::condition_variable flushed_cond_;           // 通知Flush完成
+
+    static uint64_t NextId () {
+        static std::atomic<uint64_t> next{1};
+        return next.fetch_add(1);
+    }
+
+    static ThreadBuffers& Local () {
+        static thread_local ThreadBuffers local;
+        return local;
+    }
+
+public:
+    /**
+     * @brief 构造函数
+     * @param out 输出流
+     * @param config 配置
+     *
+     * 创建日志对象，但不会自动启动后台线程。需要调用start()方法来启动。
+     */
+    explicit AsyncLogger(std::ostream& out = std::cout, AsyncLoggerConfig config = AsyncLoggerConfig())
+        : config_(config), id_(NextId()), out_(out) {
+        if (config_.rate_limit > 0) {
+            ProducerConfig producer_config;
+            producer_config.rate = config_.rate_limit;
+            producer_config.burst = std::max<size_t>(1, config_.burst);
+            limiter_ = std::make_shared<TokenManager>(producer_config.burst);
+            limiter_producer_ = std::make_unique<TokenProducer>(limiter_, producer_config);
+        }
+    }
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    /**
+     * @brief 析构函数
+     *
+     * 写出所有缓冲的日志后停止后台线程。
+     */
+    ~AsyncLogger() {
+        stop();
+        std::lock_guard<std::mutex> lock(buffers_mtx_);
+        for (auto& buffer : buffers_) {
+            buffer->closed.store(true);
+        }
+    }
+
+    /**
+     * @brief 写一条日志（不含换行）
+     * @param text 日志内容
+     * @return 成功缓冲返回true；缓冲区满或超出速率被丢弃返回false
+     */
+    bool Log (std::string text) {
+        if (limiter_ && !limiter_->TryConsumeTokens(1)) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        Record record;
+        record.time_ns = NowNs();
+        record.text = std::move(text);
+        if (!LocalBuffer().records.try_put(std::move(record))) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief 等待调用前已缓冲的日志全部写出
+     *
+     * 后台线程未运行时直接返回。
+     */
+    void Flush () {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (!running_.load()) {
+            return;
+        }
+        uint64_t target = ++flush_requests_;
+        cond_.notify_one();
+        flushed_cond_.wait(lock, [this, target]() { return flushed_ >= target || !running_.load(); });
+    }
+
+    /**
+     * @brief 启动后台写出线程（限速模式下同时启动token生产者）
+     */
+    void start () {
+        if (running_.exchange(true)) {
+            return;
+        }
+        if (limiter_producer_) {
+            limiter_producer_->start();
+        }
+        flush_thread_ = std::thread([this]() {
+            while (running_.load()) {
+                uint64_t target;
+                {
+                    std::unique_lock<std::mutex> lock(mtx_);
+                    cond_.wait_for(lock, config_.flush_interval, [this]() {
+                        return flush_requests_ > flushed_ || !running_.load();
+                    });
+                    target = flush_requests_;
+                }
+                Drain();
+                {
+                    std::lock_guard<std::mutex> lock(mtx_);
+                    flushed_ = target;
+                }
+                flushed_cond_.notify_all();
+            }
+            Drain();  // 停止前写出剩余日志
+        });
+    }
+
+    /**
+     * @brief 停止后台线程
+     *
+     * 已缓冲的日志会在线程退出前写出。
+     */
+    void stop () {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            running_ = false;
+        }
+        cond_.notify_all();
+        flushed_cond_.notify_all();
+        if (flush_thread_.joinable()) {
+            flush_thread_.join();
+        }
+        if (limiter_producer_) {
+            limiter_producer_->stop();
+        }
+    }
+
+    /**
+     * @brief 获取因缓冲区满而丢弃的日志总条数
+     */
+    uint64_t Dropped () const { return dropped_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 获取因超出速率而被抑制的日志总条数
+     */
+    uint64_t Suppressed () const { return suppressed_.load(std::memory_order_relaxed); }
+
+private:
+    static int64_t NowNs () {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 当前线程在本日志对象上的缓冲区，第一次调用时注册
+    Buffer& LocalBuffer () {
+        auto& entries = Local().entries;
+        for (auto& entry : entries) {
+            if (entry.first == id_) {
+                return *entry.second;
+            }
+        }
+        // 顺便清理已销毁的日志对象留下的缓冲区
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [](const auto& entry) {
+            return entry.second->closed.load();
+        }), entries.end());
+        auto buffer = std::make_shared<Buffer>(config_.buffer_capacity);
+        {
+            std::lock_guard<std::mutex> lock(buffers_mtx_);
+            buffers_.push_back(buffer);
+        }
+        entries.emplace_back(id_, buffer);
+        return *buffer;
+    }
+
+    // 收集所有缓冲区，按时间戳排序后一次写出（仅后台线程调用）
+    void Drain () {
+        std::vector<std::shared_ptr<Buffer>> buffers;
+        {
+            std::lock_guard<std::mutex> lock(buffers_mtx_);
+            buffers = buffers_;
+        }
+        std::vector<Record> batch;
+        Record record;
+        for (auto& buffer : buffers) {
+            bool retired = buffer->retired.load();  // 先读标志再读空，之后不会再有新日志
+            while (buffer->records.try_get(record)) {
+                batch.push_back(std::move(record));
+            }
+            if (retired) {
+                std::lock_guard<std::mutex> lock(buffers_mtx_);
+                buffers_.erase(std::remove(buffers_.begin(), buffers_.end(), buffer), buffers_.end());
+            }
+        }
+        std::stable_sort(batch.begin(), batch.end(), [](const Record& a, const Record& b) {
+            return a.time_ns < b.time_ns;
+        });
+        for (const auto& item : batch) {
+            out_ << item.text << '\n';
+        }
+        // 报告自上一批以来丢弃和抑制的条数
+        uint64_t dropped = Dropped() - reported_dropped_;
+        uint64_t suppressed = Suppressed() - reported_suppressed_;
+        reported_dropped_ += dropped;
+        reported_suppressed_ += suppressed;
+        if (dropped > 0 || suppressed > 0) {
+            out_ << "[logger] dropped " << dropped << ", suppressed " << suppressed << '\n';
+        }
+        if (!batch.empty() || dropped > 0 || suppressed > 0) {
+            out_.flush();
+        }
+    }
+};
@@ -0,0 +1,235 @@
+/**
+ * @file blocking_queue.h
+ * @brief 通用有界阻塞队列 - 支持只可移动的元素和批量存取
+ *
+ * MpmcQueue/SpscQueue适合小而可复制的元素。请求对象之类的工作项通常只可移动、
+ * 大小不一，这时用互斥锁保护的std::deque更合适：
+ * - 元素只需可移动构造，支持原地构造（emplace）
+ * - put_bulk/get_bulk一次加锁搬运多个元素，加锁和唤醒的开销由整批分摊
+ * - 只在有等待者时才通知条件变量
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <utility>
+
+/**
+ * @class BlockingQueue
+ * @brief 线程安全的有界阻塞队列
+ * @tparam T 元素类型，只需可移动构造
+ */
+template <typename T>
+class BlockingQueue {
+private:
+    const size_t capacity_;                 // 容量
+    std::deque<T> items_;                   // 元素
+    size_t put_waiters_ = 0;                // 因队列满而等待的生产者数
+    size_t get_waiters_ = 0;                // 因队列空而等待的消费者数
+    std::mutex mtx_;                        // 保护以上成员
+    std::condition_variable not_full_;      // 队列不满
+    std::condition_variable not_empty_;     // 队列非空
+
+public:
+    /**
+     * @brief 构造函数
+     * @param capacity 容量（至少为1）
+     */
+    explicit BlockingQueue(size_t capacity) : capacity_(std::max<size_t>(1, capacity)) {}
+
+    BlockingQueue(const BlockingQueue&) = delete;
+    BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+    /**
+     * @brief 阻塞入队
+     * @param val 要入队的元素
+     */
+    void put (T val) {
+        emplace(std::move(val));
+    }
+
+    /**
+     * @brief 阻塞地原地构造一个元素
+     * @param args 传给T构造函数的参数
+     */
+    template <typename... Args>
+    void emplace (Args&&... args) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        WaitNotFull(lock);
+        items_.emplace_back(std::forward<Args>(args)...);
+        NotifyGetters(1);
+    }
+
+    /**
+     * @brief 尝试入队（非阻塞）
+     * @param val 要入队的元素，失败时保持不变
+     * @return 成功返回true，队列满返回false
+     */
+    bool try_put (T&& val) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (items_.size() >= capacity_) {
+            return false;
+        }
+        items_.push_back(std::move(val));
+        NotifyGetters(1);
+        return true;
+    }
+
+    /**
+     * @brief 阻塞出队
+     * @return 出队的元素
+     */
+    T get () {
+        std::unique_lock<std::mutex> lock(mtx_);
+        WaitNotEmpty(lock);
+        T val = std::move(items_.front());
+        items_.pop_front();
+        NotifyPutters(1);
+        return val;
+    }
+
+    /**
+     * @brief 尝试出队（非阻塞）
+     * @param out 出队的元素
+     * @return 成功返回true，队列空返回false
+     */
+    bool try_get (T& out) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (items_.empty()) {
+            return false;
+        }
+        out = std::move(items_.front());
+        items_.pop_front();
+        NotifyPutters(1);
+        return true;
+    }
+
+    /**
+     * @brief 批量阻塞入队
+     * @param first 第一个元素的迭代器（元素会被移走）
+     * @param last 结束迭代器
+     *
+     * 每次加锁放入当前能容纳的全部元素，直到所有元素都入队。
+     */
+    template <typename InputIt>
+    void put_bulk (InputIt first, InputIt last) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (first != last) {
+            WaitNotFull(lock);
+            size_t moved = 0;
+            for (; first != last && items_.size() < capacity_; ++first, ++moved) {
+                items_.push_back(std::move(*first));
+            }
+            NotifyGetters(moved);
+        }
+    }
+
+    /**
+     * @brief 批量尝试入队（非阻塞）
+     * @param first 第一个元素的迭代器
+     * @param last 结束迭代器
+     * @return 入队的元素数量，只有这些元素被移走
+     */
+    template <typename InputIt>
+    size_t try_put_bulk (InputIt first, InputIt last) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        size_t moved = 0;
+        for (; first != last && items_.size() < capacity_; ++first, ++moved) {
+            items_.push_back(std::move(*first));
+        }
+        NotifyGetters(moved);
+        return moved;
+    }
+
+    /**
+     * @brief 批量阻塞出队
+     * @param out 输出迭代器
+     * @param max_items 最多取出的元素数量
+     * @return 取出的元素数量
+     *
+     * 队列为空时等待，之后一次取出所有可取的元素（不超过max_items）。
+     */
+    template <typename OutputIt>
+    size_t get_bulk (OutputIt out, size_t max_items) {
+        if (max_items == 0) {
+            return 0;
+        }
+        std::unique_lock<std::mutex> lock(mtx_);
+        WaitNotEmpty(lock);
+        return TakeLocked(out, max_items);
+    }
+
+    /**
+     * @brief 批量尝试出队（非阻塞）
+     * @param out 输出迭代器
+     * @param max_items 最多取出的元素数量
+     * @return 取出的元素数量，队列空时为0
+     */
+    template <typename OutputIt>
+    size_t try_get_bulk (OutputIt out, size_t max_items) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return TakeLocked(out, max_items);
+    }
+
+    /**
+     * @brief 获取容量
+     */
+    size_t capacity () const { return capacity_; }
+
+    /**
+     * @brief 获取当前元素数量
+     */
+    size_t size () {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return items_.size();
+    }
+
+private:
+    void WaitNotFull (std::unique_lock<std::mutex>& lock) {
+        if (items_.size() < capacity_) {
+            return;
+        }
+        put_waiters_++;
+        not_full_.wait(lock, [this]() { return items_.size() < capacity_; });
+        put_waiters_--;
+    }
+
+    void WaitNotEmpty (std::unique_lock<std::mutex>& lock) {
+        if (!items_.empty()) {
+            return;
+        }
+        get_waiters_++;
+        not_empty_.wait(lock, [this]() { return !items_.empty(); });
+        get_waiters_--;
+    }
+
+    template <typename OutputIt>
+    size_t TakeLocked (OutputIt out, size_t max_items) {
+        size_t n = std::min(max_items, items_.size());
+        auto end = items_.begin() + n;
+        std::move(items_.begin(), end, out);
+        items_.erase(items_.begin(), end);
+        NotifyPutters(n);
+        return n;
+    }
+
+    // 新增了n个元素/空位时，只唤醒需要的等待者
+    void NotifyGetters (size_t n) {
+        if (n == 0 || get_waiters_ == 0) {
+            return;
+        }
+        n == 1 ? not_empty_.notify_one() : not_empty_.notify_all();
+    }
+
+    void NotifyPutters (size_t n) {
+        if (n == 0 || put_waiters_ == 0) {
+            return;
+        }
+        n == 1 ? not_full_.notify_one() : not_full_.notify_all();
+    }
+};
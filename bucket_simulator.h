@@ -0,0 +1,469 @@
+/**
+ * @file bucket_simulator.h
+ * @brief 令牌桶离散事件模拟器 - 上线前评估max_tokens/速率/消费者配置
+ *
+ * 单线程、虚拟时间的离散事件模拟：
+ * - 桶使用BasicTokenManager<NullLock, NoWait, steady_clock, size_t, FifoQueue>，与线上完全相同的扣除和FIFO异步分配逻辑
+ * - 补充使用RefillPacer，与TokenProducer相同的唤醒间隔、突发量和追赶规则
+ * - 请求到达可以是泊松过程、固定间隔或录制的轨迹
+ * - 获得token后交给固定数量的工作者处理（可选），统计排队和处理
+ * 输出吞吐量、拒绝率、等待token与端到端延迟的分位数，以及按时间采样的利用率曲线。
+ * 每秒可以处理数百万个事件，适合大范围参数扫描。
+ */
+
+#pragma once
+
+#include "refill_pacer.h"
+#include "token_manager.h"
+#include "token_producer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @struct Arrival
+ * @brief 一个请求的到达
+ */
+struct Arrival {
+    double time = 0.0;   // 到达时间（相对模拟起点的秒数）
+    size_t cost = 1;     // 需要的token数量
+};
+
+/**
+ * @brief 到达过程：每次调用产生下一个到达（时间不递减），没有更多到达时返回false
+ */
+using ArrivalProcess = std::function<bool(Arrival&)>;
+
+/**
+ * @brief 泊松到达过程
+ * @param rate 平均每秒到达的请求数
+ * @param cost 每个请求需要的token数量
+ * @param seed 随机种子，相同的种子产生相同的序列
+ */
+inline ArrivalProcess PoissonArrivals (double rate, size_t cost = 1, uint64_t seed = 1) {
+    auto engine = std::make_shared<std::mt19937_64>(seed);
+    auto gap = std::make_shared<std::exponential_distribution<double>>(rate);
+    auto now = std::make_shared<double>(0.0);
+    return [engine, gap, now, cost](Arrival& arrival) {
+        *now += (*gap)(*engine);
+        arrival.time = *now;
+        arrival.cost = cost;
+        return true;
+    };
+}
+
+/**
+ * @brief 固定间隔的到达过程
+ * @param rate 每秒到达的请求数
+ * @param cost 每个请求需要的token数量
+ */
+inline ArrivalProcess ConstantArrivals (double rate, size_t cost = 1) {
+    auto count = std::make_shared<uint64_t>(0);
+    return [count, rate, cost](Arrival& arrival) {
+        arrival.time = static_cast<double>((*count)++) / rate;
+        arrival.cost = cost;
+        return true;
+    };
+}
+
+/**
+ * @brief 按录制的轨迹重放
+ * @param trace 按时间排序的到达序列
+ */
+inline ArrivalProcess TraceArrivals (std::vector<Arrival> trace) {
+    auto data = std::make_shared<std::vector<Arrival>>(std::move(trace));
+    auto next = std::make_shared<size_t>(0);
+    return [data, next](Arrival& arrival) {
+        if (*next >= data->size()) {
+            return false;
+        }
+        arrival = (*data)[(*next)++];
+        return true;
+    };
+}
+
+/**
+ * @brief 读取轨迹文件
+ * @param in 每行"到达时间(秒) [token数量]"，token数量缺省为1，'#'开头的行被忽略
+ * @return 按时间排序的到达序列
+ */
+inline std::vector<Arrival> LoadTrace (std::istream& in) {
+    std::vector<Arrival> trace;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        Arrival arrival;
+        size_t pos = 0;
+        arrival.time = std::stod(line, &pos);
+        if (pos < line.size() && line.find_first_not_of(" \t,\r", pos) != std::string::npos) {
+            arrival.cost = std::stoul(line.substr(line.find_first_not_of(" \t,", pos)));
+        }
+        trace.push_back(arrival);
+    }
+    std::stable_sort(trace.begin(), trace.end(),
+                     [](const Arrival& a, const Arrival& b) { return a.time < b.time; });
+    return trace;
+}
+
+/**
+ * @struct SimulationConfig
+ * @brief 模拟配置
+ */
+struct SimulationConfig {
+    size_t max_tokens = 10;                              // 桶的最大token数量
+    ProducerConfig producer;                             // 补充速率、突发量和唤醒间隔（与TokenProducer相同）
+    size_t workers = 0;                                  // 获得token后处理请求的工作者数量，0表示不模拟处理
+    std::chrono::nanoseconds service_time{0};            // 每个请求的平均处理时间
+    bool exponential_service = false;                    // 处理时间服从指数分布（否则为固定值）
+    size_t max_waiting = std::numeric_limits<size_t>::max();  // 等待token的请求上限，超出时拒绝；0表示只尝试不等待
+    std::chrono::nanoseconds timeout{0};                 // 等待token的超时时间，0表示不超时
+    std::chrono::nanoseconds duration{std::chrono::seconds(60)};  // 模拟时长
+    std::chrono::nanoseconds sample_interval{std::chrono::seconds(1)};  // 利用率曲线的采样间隔
+    uint64_t seed = 1;                                   // 处理时间的随机种子
+};
+
+/**
+ * @struct LatencySummary
+ * @brief 延迟分布
+ */
+struct LatencySummary {
+    std::chrono::nanoseconds mean{0};
+    std::chrono::nanoseconds p50{0};
+    std::chrono::nanoseconds p90{0};
+    std::chrono::nanoseconds p99{0};
+    std::chrono::nanoseconds p999{0};
+    std::chrono::nanoseconds max{0};
+};
+
+/**
+ * @struct SimulationSample
+ * @brief 利用率曲线上的一个采样点（统计的是上一个采样间隔）
+ */
+struct SimulationSample {
+    double time = 0.0;              // 采样时间（秒）
+    size_t tokens = 0;              // 桶中的token数量
+    size_t waiting = 0;             // 等待token的请求数量
+    size_t backlog = 0;             // 已获得token、等待工作者的请求数量
+    double worker_utilization = 0;  // 工作者忙碌时间占比
+    double throughput = 0;          // 获得token的请求数/秒
+    double rejections = 0;          // 被拒绝（含超时）的请求数/秒
+};
+
+/**
+ * @struct SimulationResult
+ * @brief 模拟结果
+ */
+struct SimulationResult {
+    uint64_t events = 0;            // 处理的事件数
+    uint64_t arrivals = 0;          // 到达的请求数
+    uint64_t granted = 0;           // 获得token的请求数
+    uint64_t rejected = 0;          // 因等待队列已满、成本超过max_tokens（或只尝试模式下token不足）被拒绝的请求数
+    uint64_t timed_out = 0;         // 等待token超时的请求数
+    uint64_t completed = 0;         // 处理完成的请求数
+    uint64_t tokens_added = 0;      // 实际补充进桶的token数（溢出部分不计）
+    double throughput = 0;          // 获得token的请求数/秒
+    double rejection_rate = 0;      // (rejected + timed_out) / arrivals
+    double worker_utilization = 0;  // 工作者平均利用率
+    LatencySummary token_wait;      // 从到达到获得token的时间
+    LatencySummary latency;         // 从到达到处理完成的时间（不模拟处理时等于token_wait）
+    std::vector<SimulationSample> curve;  // 利用率曲线
+};
+
+/**
+ * @class BucketSimulator
+ * @brief 令牌桶离散事件模拟器
+ *
+ * 非线程安全，一个实例只运行一次；参数扫描时为每组参数创建一个实例（可以在多个线程中并行）。
+ */
+class BucketSimulator {
+private:
+    // 单线程的桶：不加锁、不阻塞，只使用非阻塞扣除和异步分配
+    using Bucket = BasicTokenManager<NullLock, NoWait, std::chrono::steady_clock, size_t, FifoQueue>;
+
+    enum class EventType : uint8_t { kRefill, kArrival, kTimeout, kServiceDone, kSample };
+
+    struct Event {
+        double time;
+        uint64_t seq;      // 同一时刻的事件按产生顺序处理，保证结果可重复
+        EventType type;
+        size_t request;    // 相关的请求下标
+        bool operator> (const Event& other) const {
+            return time != other.time ? time > other.time : seq > other.seq;
+        }
+    };
+
+    struct Request {
+        double arrival;         // 到达时间
+        size_t cost;            // 需要的token数量
+        uint64_t async_id = 0;  // 排队中的异步请求ID，0表示不在排队
+    };
+
+    const SimulationConfig config_;      // 模拟配置
+    ArrivalProcess arrivals_;            // 到达过程
+    Bucket bucket_;                      // 被模拟的桶
+    RefillPacer pacer_;                  // 补充节拍
+    double refill_interval_;             // 补充唤醒间隔（秒）
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;  // 按时间排序的事件
+    uint64_t next_seq_ = 0;              // 下一个事件序号
+    double now_ = 0.0;                   // 当前虚拟时间（秒）
+
+    std::vector<Request> requests_;      // 所有到达过的请求
+    size_t waiting_ = 0;                 // 等待token的请求数
+    std::deque<size_t> backlog_;         // 已获得token、等待工作者的请求
+    size_t busy_workers_ = 0;            // 忙碌的工作者数量
+    double busy_since_ = 0.0;            // 上次工作者数量变化的时间
+    double busy_area_ = 0.0;             // 工作者忙碌时间的积分
+    std::mt19937_64 service_rng_;        // 处理时间的随机数
+
+    std::vector<double> token_waits_;    // 每个请求等待token的时间（秒）
+    std::vector<double> latencies_;      // 每个请求的端到端延迟（秒）
+    SimulationResult result_;            // 累计的结果
+
+    // 采样间隔内的计数
+    uint64_t interval_granted_ = 0;
+    uint64_t interval_rejected_ = 0;
+    double interval_busy_area_ = 0.0;
+
+public:
+    /**
+     * @brief 构造函数
+     * @param config 模拟配置
+     * @param arrivals 到达过程
+     */
+    BucketSimulator(SimulationConfig config, ArrivalProcess arrivals)
+        : config_(std::move(config)),
+          arrivals_(std::move(arrivals)),
+          bucket_(config_.max_tokens),
+          pacer_(config_.producer.rate, config_.producer.burst),
+          service_rng_(config_.seed) {
+        auto interval = pacer_.Interval(config_.producer.min_interval);
+        pacer_.FitBurst(interval);
+        refill_interval_ = std::chrono::duration<double>(interval).count();
+    }
+
+    /**
+     * @brief 运行模拟
+     * @return 模拟结果
+     */
+    SimulationResult Run () {
+        const double end = std::chrono::duration<double>(config_.duration).count();
+        const double sample = std::chrono::duration<double>(config_.sample_interval).count();
+        Push(0.0, EventType::kRefill);  // 与TokenProducer一样，起点立即补充
+        ScheduleArrival();
+        if (sample > 0) {
+            Push(sample, EventType::kSample);
+        }
+        while (!events_.empty() && events_.top().time <= end) {
+            Event event = events_.top();
+            events_.pop();
+            now_ = event.time;
+            result_.events++;
+            switch (event.type) {
+            case EventType::kRefill:
+                OnRefill();
+                break;
+            case EventType::kArrival:
+                OnArrival(event.request);
+                break;
+            case EventType::kTimeout:
+                OnTimeout(event.request);
+                break;
+            case EventType::kServiceDone:
+                OnServiceDone(event.request);
+                break;
+            case EventType::kSample:
+                OnSample();
+                Push(now_ + sample, EventType::kSample);
+                break;
+            }
+        }
+        now_ = end;
+        return Finish(end);
+    }
+
+private:
+    void Push (double time, EventType type, size_t request = 0) {
+        events_.push(Event{time, next_seq_++, type, request});
+    }
+
+    void ScheduleArrival () {
+        Arrival arrival;
+        if (arrivals_(arrival)) {
+            requests_.push_back(Request{arrival.time, arrival.cost});
+            Push(arrival.time, EventType::kArrival, requests_.size() - 1);
+        }
+    }
+
+    void OnRefill () {
+        size_t due = pacer_.Due(now_);
+        if (due > 0) {
+            result_.tokens_added += bucket_.AddTokens(due);  // 满足的异步请求在这里回调OnGranted
+        }
+        Push(now_ + refill_interval_, EventType::kRefill);
+    }
+
+    void OnArrival (size_t id) {
+        result_.arrivals++;
+        size_t cost = requests_[id].cost;
+        ScheduleArrival();
+        if (config_.max_waiting == 0) {
+            // 只尝试不等待
+            if (bucket_.TryConsumeTokens(cost)) {
+                OnGranted(id);
+            } else {
+                Reject();
+            }
+            return;
+        }
+        if (waiting_ >= config_.max_waiting) {
+            Reject();
+            return;
+        }
+        uint64_t async_id = bucket_.ConsumeTokensAsync(cost, [this, id]() { OnGranted(id); });
+        if (async_id == Bucket::kRejected) {
+            Reject();  // 成本超过max_tokens，永远无法满足
+            return;
+        }
+        if (async_id != 0) {
+            requests_[id].async_id = async_id;
+            waiting_++;
+            if (config_.timeout.count() > 0) {
+                Push(now_ + std::chrono::duration<double>(config_.timeout).count(), EventType::kTimeout, id);
+            }
+        }
+    }
+
+    void OnTimeout (size_t id) {
+        Request& request = requests_[id];
+        if (request.async_id != 0 && bucket_.CancelAsync(request.async_id)) {
+            request.async_id = 0;
+            waiting_--;
+            result_.timed_out++;
+            interval_rejected_++;
+        }
+    }
+
+    void Reject () {
+        result_.rejected++;
+        interval_rejected_++;
+    }
+
+    void OnGranted (size_t id) {
+        Request& request = requests_[id];
+        if (request.async_id != 0) {
+            request.async_id = 0;
+            waiting_--;
+        }
+        result_.granted++;
+        interval_granted_++;
+        token_waits_.push_back(now_ - request.arrival);
+        if (config_.workers == 0) {
+            latencies_.push_back(now_ - request.arrival);
+            return;
+        }
+        if (busy_workers_ < config_.workers) {
+            StartService(id);
+        } else {
+            backlog_.push_back(id);
+        }
+    }
+
+    void StartService (size_t id) {
+        AccountBusy();
+        busy_workers_++;
+        double mean = std::chrono::duration<double>(config_.service_time).count();
+        double service = mean;
+        if (config_.exponential_service && mean > 0) {
+            service = std::exponential_distribution<double>(1.0 / mean)(service_rng_);
+        }
+        Push(now_ + service, EventType::kServiceDone, id);
+    }
+
+    void OnServiceDone (size_t id) {
+        AccountBusy();
+        busy_workers_--;
+        result_.completed++;
+        latencies_.push_back(now_ - requests_[id].arrival);
+        if (!backlog_.empty()) {
+            size_t next = backlog_.front();
+            backlog_.pop_front();
+            StartService(next);
+        }
+    }
+
+    // 累计工作者忙碌时间的积分
+    void AccountBusy () {
+        double area = busy_workers_ * (now_ - busy_since_);
+        busy_area_ += area;
+        interval_busy_area_ += area;
+        busy_since_ = now_;
+    }
+
+    void OnSample () {
+        AccountBusy();
+        double span = std::chrono::duration<double>(config_.sample_interval).count();
+        SimulationSample sample;
+        sample.time = now_;
+        sample.tokens = bucket_.GetTokens();
+        sample.waiting = waiting_;
+        sample.backlog = backlog_.size();
+        sample.worker_utilization = config_.workers > 0 ? interval_busy_area_ / (config_.workers * span) : 0.0;
+        sample.throughput = interval_granted_ / span;
+        sample.rejections = interval_rejected_ / span;
+        result_.curve.push_back(sample);
+        interval_granted_ = 0;
+        interval_rejected_ = 0;
+        interval_busy_area_ = 0.0;
+    }
+
+    SimulationResult Finish (double end) {
+        AccountBusy();
+        result_.throughput = end > 0 ? result_.granted / end : 0.0;
+        if (result_.arrivals > 0) {
+            result_.rejection_rate = static_cast<double>(result_.rejected + result_.timed_out) / result_.arrivals;
+        }
+        if (config_.workers > 0 && end > 0) {
+            result_.worker_utilization = busy_area_ / (config_.workers * end);
+        }
+        result_.token_wait = Summarize(token_waits_);
+        result_.latency = Summarize(latencies_);
+        return std::move(result_);
+    }
+
+    static LatencySummary Summarize (std::vector<double>& samples) {
+        LatencySummary summary;
+        if (samples.empty()) {
+            return summary;
+        }
+        std::sort(samples.begin(), samples.end());
+        auto to_ns = [](double seconds) {
+            return std::chrono::nanoseconds(static_cast<int64_t>(seconds * 1e9));
+        };
+        auto at = [&samples, &to_ns](double q) {
+            size_t index = std::min(samples.size() - 1, static_cast<size_t>(q * samples.size()));
+            return to_ns(samples[index]);
+        };
+        double sum = 0.0;
+        for (double sample : samples) {
+            sum += sample;
+        }
+        summary.mean = to_ns(sum / samples.size());
+        summary.p50 = at(0.50);
+        summary.p90 = at(0.90);
+        summary.p99 = at(0.99);
+        summary.p999 = at(0.999);
+        summary.max = to_ns(samples.back());
+        return summary;
+    }
+};
@@ -0,0 +1,20 @@
+/**
+ * @file cache_line.h
+ * @brief 缓存行大小常量
+ *
+ * 被不同线程频繁写入的字段应当放在不同的缓存行上，否则会发生伪共享（false sharing）：
+ * 两个线程各写各的变量，却在同一条缓存行上来回争抢所有权。
+ * 主流x86和ARM服务器的缓存行都是64字节。
+ */
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief 缓存行大小（字节），用于alignas对齐和填充
+ *
+ * 不使用std::hardware_destructive_interference_size：它的值随编译选项变化，
+ * 放在头文件中会导致不同翻译单元看到不同的布局。
+ */
+constexpr size_t kCacheLineSize = 64;
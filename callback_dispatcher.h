@@ -0,0 +1,238 @@
+/**
+ * @file callback_dispatcher.h
+ * @brief 异步回调分发器 - 把消费回调移出消费者的获取循环
+ *
+ * TokenCustomer默认在消费线程上同步调用回调，慢回调（例如持有全局流锁的std::cout）
+ * 会直接拖慢消费速度。CallbackDispatcher用一个专用线程执行回调：
+ * - 每个回调来源对应一个Channel，Post只做原子计数，必要时把Channel压入无锁MPSC队列
+ * - 同一个Channel在被分发前收到的多次Post合并为一批，只入队一次
+ * - 分发线程一次取出一批Channel，按计数调用回调（或调用一次批量回调）
+ * 分发线程空闲时休眠，Post只在它休眠时才加锁唤醒。
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * @class CallbackDispatcher
+ * @brief 在专用线程上批量执行回调
+ */
+class CallbackDispatcher {
+public:
+    /**
+     * @class Channel
+     * @brief 一个回调来源（例如一个消费者）
+     *
+     * 只能同时挂在一个CallbackDispatcher上。销毁前必须先调用Flush，
+     * 确保分发线程不再引用它。
+     */
+    class Channel {
+        friend class CallbackDispatcher;
+
+        std::function<void(bool)> callback_;                  // 逐次回调
+        std::function<void(size_t, size_t)> batch_callback_;  // 批量回调（成功数、失败数）
+        std::atomic<Channel*> next_{nullptr};                 // MPSC队列的链接
+        std::atomic<uint64_t> ok_{0};                         // 待分发的成功次数
+        std::atomic<uint64_t> failed_{0};                     // 待分发的失败次数
+        std::atomic<bool> queued_{false};                     // 是否已在队列中
+
+        Channel() = default;  // 仅用于队列的哨兵节点
+
+    public:
+        /**
+         * @brief 构造函数
+         * @param callback 逐次回调，参数为成功与否
+         * @param batch_callback 批量回调（可选），设置后每批只调用一次，参数为本批的成功数和失败数
+         */
+        explicit Channel(std::function<void(bool)> callback,
+                         std::function<void(size_t, size_t)> batch_callback = nullptr)
+            : callback_(std::move(callback)), batch_callback_(std::move(batch_callback)) {}
+    };
+
+private:
+    Channel stub_;                                 // MPSC队列的哨兵节点
+    std::atomic<Channel*> head_;                   // 队列头（生产者交换）
+    Channel* tail_;                                // 队列尾（仅分发线程访问）
+    std::atomic<Channel*> current_{nullptr};       // 正在分发的Channel
+    const size_t max_batch_;                       // 每次唤醒最多处理的Channel数
+    std::thread dispatch_thread_;                  // 分发线程
+    std::atomic<bool> running_{false};             // 运行标志
+    std::atomic<bool> sleeping_{false};            // 分发线程是否在休眠
+    std::atomic<size_t> flush_waiters_{0};         // 正在Flush的线程数
+    std::mutex mtx_;                               // 休眠和Flush用的互斥锁
+    std::condition_variable cond_;                 // 唤醒分发线程
+    std::condition_variable flush_cond_;           // 唤醒Flush的线程
+
+public:
+    /**
+     * @brief 构造函数
+     * @param max_batch 每次唤醒最多处理的Channel数量
+     *
+     * 创建分发器，但不会自动启动线程。需要调用start()方法来启动分发线程。
+     */
+    explicit CallbackDispatcher(size_t max_batch = 256)
+        : head_(&stub_), tail_(&stub_), max_batch_(max_batch) {}
+
+    /**
+     * @brief 析构函数
+     *
+     * 分发完已排队的回调后停止分发线程。
+     */
+    ~CallbackDispatcher() { stop(); }
+
+    /**
+     * @brief 投递一次回调
+     * @param channel 回调来源
+     * @param ok 传给回调的结果
+     *
+     * 无锁：只增加计数；Channel尚未排队时才入队。
+     */
+    void Post (Channel& channel, bool ok) {
+        (ok ? channel.ok_ : channel.failed_).fetch_add(1);
+        if (channel.queued_.exchange(true)) {
+            return;  // 已经在队列中，本次会与之前的合并分发
+        }
+        Push(&channel);
+        if (sleeping_.load()) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            cond_.notify_one();
+        }
+    }
+
+    /**
+     * @brief 等待某个Channel上已投递的回调全部执行完
+     * @param channel 回调来源
+     *
+     * 调用方应保证此后不再向该Channel投递。分发器已停止时直接返回。
+     */
+    void Flush (Channel& channel) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        flush_waiters_.fetch_add(1);
+        flush_cond_.wait(lock, [this, &channel]() {
+            return !running_.load() || (!channel.queued_.load() && current_.load() != &channel);
+        });
+        flush_waiters_.fetch_sub(1);
+    }
+
+    /**
+     * @brief 启动分发线程
+     */
+    void start () {
+        running_ = true;
+        dispatch_thread_ = std::thread([this]() {
+            while (running_.load()) {
+                if (DispatchBatch() > 0) {
+                    continue;
+                }
+                // 队列为空，休眠直到有新的投递
+                std::unique_lock<std::mutex> lock(mtx_);
+                sleeping_.store(true);
+                if (running_.load() && Empty()) {
+                    cond_.wait_for(lock, std::chrono::milliseconds(100));
+                }
+                sleeping_.store(false);
+            }
+            while (DispatchBatch() > 0) {
+                // 停止前分发完已排队的回调
+            }
+            std::lock_guard<std::mutex> lock(mtx_);
+            flush_cond_.notify_all();
+        });
+    }
+
+    /**
+     * @brief 停止分发线程
+     *
+     * 已排队的回调会在线程退出前分发完。
+     */
+    void stop () {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            running_ = false;
+        }
+        cond_.notify_all();
+        if (dispatch_thread_.joinable()) {
+            dispatch_thread_.join();
+        }
+    }
+
+private:
+    // Vyukov无锁MPSC队列：入队只需一次原子交换
+    void Push (Channel* node) {
+        node->next_.store(nullptr, std::memory_order_relaxed);
+        Channel* prev = head_.exchange(node);
+        prev->next_.store(node, std::memory_order_release);
+    }
+
+    // 出队（仅分发线程调用），队列为空或有入队尚未完成时返回nullptr
+    Channel* Pop () {
+        Channel* tail = tail_;
+        Channel* next = tail->next_.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next_.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_.load()) {
+            return nullptr;  // 有生产者正在入队，稍后再取
+        }
+        Push(&stub_);
+        next = tail->next_.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    bool Empty () const {
+        return tail_->next_.load(std::memory_order_acquire) == nullptr && head_.load() == tail_;
+    }
+
+    // 分发一批Channel，返回处理的数量
+    size_t DispatchBatch () {
+        size_t count = 0;
+        Channel* channel;
+        while (count < max_batch_ && (channel = Pop()) != nullptr) {
+            current_.store(channel);
+            // 先清除排队标记再取计数：之后的Post会重新入队，不会丢失
+            channel->queued_.store(false);
+            uint64_t ok = channel->ok_.exchange(0);
+            uint64_t failed = channel->failed_.exchange(0);
+            if (ok + failed > 0) {
+                if (channel->batch_callback_) {
+                    channel->batch_callback_(ok, failed);
+                } else if (channel->callback_) {
+                    for (uint64_t i = 0; i < ok; i++) {
+                        channel->callback_(true);
+                    }
+                    for (uint64_t i = 0; i < failed; i++) {
+                        channel->callback_(false);
+                    }
+                }
+            }
+            current_.store(nullptr);
+            count++;
+        }
+        if (count > 0 && flush_waiters_.load() > 0) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            flush_cond_.notify_all();
+        }
+        return count;
+    }
+};
@@ -0,0 +1,314 @@
+/**
+ * @file clock_source.h
+ * @brief 可注入的时钟 - 真实时间或虚拟时间
+ *
+ * TokenProducer、TokenCustomer等通过ClockSource读取时间和睡眠：
+ * - SystemClock：真实时间（steady_clock）
+ * - VirtualClock：虚拟时间，所有参与线程都在等待时直接跳到最早的截止时间，
+ *   几小时的生产/消费过程几毫秒就能跑完，适合确定性测试和大范围参数扫描
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ClockSource
+ * @brief 时钟接口
+ *
+ * 等待统一使用WaitUntil(deadline, ready)：ready在时钟的内部锁下检查，
+ * 修改ready依赖的状态（应为原子变量）之后必须调用Notify()。
+ */
+class ClockSource {
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+    using duration = std::chrono::steady_clock::duration;
+
+    virtual ~ClockSource() = default;
+
+    /**
+     * @brief 当前时间
+     */
+    virtual time_point Now () const = 0;
+
+    /**
+     * @brief 等待直到ready()为true或到达截止时间
+     * @param deadline 截止时间，time_point::max()表示不限时
+     * @param ready 唤醒条件（可为空），在时钟的内部锁下调用
+     * @return 返回时ready()的值
+     */
+    virtual bool WaitUntil (time_point deadline, const std::function<bool()>& ready) = 0;
+
+    /**
+     * @brief 通知等待者重新检查唤醒条件
+     */
+    virtual void Notify () = 0;
+
+    /**
+     * @brief 登记一个参与线程（在创建该线程之前由控制线程调用）
+     *
+     * 虚拟时钟只在所有参与线程都在等待时才推进时间；真实时钟为空操作。
+     */
+    virtual void Attach () {}
+
+    /**
+     * @brief 把当前线程标记为已登记的参与线程（在参与线程开始运行时调用）
+     */
+    virtual void Bind () {}
+
+    /**
+     * @brief 注销当前参与线程（线程退出前调用）
+     */
+    virtual void Detach () {}
+
+    /**
+     * @brief 等待一个线程结束
+     * @param thread 要join的线程
+     *
+     * 虚拟时钟在join期间把当前参与线程计为等待，被join的线程因此可以在虚拟时间中继续运行到结束；
+     * 被join的参与线程Detach时把忙碌计数直接交还给等待者，时间不会在两者之间推进。
+     */
+    virtual void Join (std::thread& thread) {
+        thread.join();
+    }
+
+    /**
+     * @brief 睡眠到指定时间
+     */
+    void SleepUntil (time_point deadline) {
+        WaitUntil(deadline, nullptr);
+    }
+
+    /**
+     * @brief 睡眠指定时长
+     */
+    void SleepFor (duration d) {
+        SleepUntil(Now() + d);
+    }
+};
+
+/**
+ * @class SystemClock
+ * @brief 真实时间
+ */
+class SystemClock : public ClockSource {
+private:
+    std::mutex mtx_;
+    std::condition_variable cond_;
+
+public:
+    time_point Now () const override {
+        return std::chrono::steady_clock::now();
+    }
+
+    bool WaitUntil (time_point deadline, const std::function<bool()>& ready) override {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (!ready) {
+            while (cond_.wait_until(lock, deadline) != std::cv_status::timeout) {}
+            return false;
+        }
+        return cond_.wait_until(lock, deadline, ready);
+    }
+
+    void Notify () override {
+        std::lock_guard<std::mutex> lock(mtx_);
+        cond_.notify_all();
+    }
+};
+
+/**
+ * @class VirtualClock
+ * @brief 虚拟时间
+ *
+ * 时间从start开始，只在以下情况推进：
+ * - 所有参与线程（Attach登记的线程）都在WaitUntil中等待时，跳到最早的截止时间并唤醒到期的等待者
+ * - 调用Advance/AdvanceTo手动推进
+ * 被Notify或时间推进唤醒的参与线程在唤醒的同时就被计为忙碌，
+ * 因此唤醒者（例如补充token的生产者）和被唤醒者之间不会有时间漏跳。
+ *
+ * 参与线程应由Join()回收（不要直接join），否则对方在WaitUntil中睡眠时时间无法推进。
+ */
+class VirtualClock : public ClockSource {
+private:
+    // 一个等待者（位于等待线程的栈上）
+    struct Waiter {
+        time_point deadline;
+        const std::function<bool()>* ready;
+        bool participant;   // 是否为参与线程（等待期间不计为忙碌）
+        bool woken;         // 已被唤醒，参与线程已重新计为忙碌
+    };
+
+    // 一个参与线程正在join的线程
+    struct PendingJoin {
+        std::thread::id target;
+        bool handed;        // 目标线程已Detach并把忙碌计数交给了join方
+    };
+
+    mutable std::mutex mtx_;
+    std::condition_variable cond_;
+    time_point now_;                      // 当前虚拟时间
+    size_t busy_ = 0;                     // 未在等待的参与线程数量
+    std::vector<Waiter*> waiters_;        // 正在等待的线程
+    std::vector<PendingJoin*> joins_;     // 正在进行的Join
+    std::vector<std::thread::id> exited_; // 已Detach、尚未被Join的参与线程
+
+    static inline thread_local const VirtualClock* bound_ = nullptr;  // 当前线程所属的虚拟时钟
+
+public:
+    /**
+     * @brief 构造函数
+     * @param start 起始时间，默认为纪元后1秒（不为0，统计中常用0表示"未开始"）
+     */
+    explicit VirtualClock(time_point start = time_point(std::chrono::seconds(1))) : now_(start) {}
+
+    time_point Now () const override {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return now_;
+    }
+
+    bool WaitUntil (time_point deadline, const std::function<bool()>& ready) override {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if ((ready && ready()) || now_ >= deadline) {
+            return ready && ready();
+        }
+        Waiter waiter{deadline, ready ? &ready : nullptr, bound_ == this, false};
+        waiters_.push_back(&waiter);
+        if (waiter.participant) {
+            busy_--;
+        }
+        MaybeAdvance();
+        cond_.wait(lock, [&waiter]() { return waiter.woken; });
+        waiters_.erase(std::find(waiters_.begin(), waiters_.end(), &waiter));
+        return ready && ready();
+    }
+
+    void Notify () override {
+        std::lock_guard<std::mutex> lock(mtx_);
+        bool any = false;
+        for (Waiter* waiter : waiters_) {
+            if (!waiter->woken && waiter->ready && (*waiter->ready)()) {
+                Wake(*waiter);
+                any = true;
+            }
+        }
+        if (any) {
+            cond_.notify_all();
+        }
+    }
+
+    void Attach () override {
+        std::lock_guard<std::mutex> lock(mtx_);
+        busy_++;
+    }
+
+    void Bind () override {
+        bound_ = this;
+    }
+
+    void Detach () override {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (bound_ == this) {
+            bound_ = nullptr;
+        }
+        for (PendingJoin* join : joins_) {
+            if (join->target == std::this_thread::get_id() && !join->handed) {
+                join->handed = true;  // 忙碌计数交给正在join本线程的参与线程
+                return;
+            }
+        }
+        exited_.push_back(std::this_thread::get_id());  // 之后的Join不必再等待
+        busy_--;
+        MaybeAdvance();
+    }
+
+    void Join (std::thread& thread) override {
+        if (bound_ != this) {
+            thread.join();
+            return;
+        }
+        PendingJoin join{thread.get_id(), false};
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto exited = std::find(exited_.begin(), exited_.end(), join.target);
+            if (exited != exited_.end()) {
+                // 目标已经Detach，忙碌计数已归还，直接join，当前线程保持忙碌
+                exited_.erase(exited);
+                thread.join();
+                return;
+            }
+            joins_.push_back(&join);
+            busy_--;
+            MaybeAdvance();
+        }
+        thread.join();
+        std::lock_guard<std::mutex> lock(mtx_);
+        joins_.erase(std::find(joins_.begin(), joins_.end(), &join));
+        if (!join.handed) {
+            busy_++;  // 被join的不是参与线程，自己恢复忙碌
+        }
+    }
+
+    /**
+     * @brief 手动推进时间
+     * @param d 推进的时长
+     */
+    void Advance (duration d) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        SetTime(now_ + d);
+    }
+
+    /**
+     * @brief 手动推进到指定时间（早于当前时间时不变）
+     */
+    void AdvanceTo (time_point t) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        SetTime(std::max(now_, t));
+    }
+
+private:
+    // 唤醒一个等待者，参与线程重新计为忙碌（调用时已持有mtx_）
+    void Wake (Waiter& waiter) {
+        waiter.woken = true;
+        if (waiter.participant) {
+            busy_++;
+        }
+    }
+
+    // 设置时间并唤醒到期的等待者（调用时已持有mtx_）
+    void SetTime (time_point t) {
+        now_ = t;
+        bool any = false;
+        for (Waiter* waiter : waiters_) {
+            if (!waiter->woken && waiter->deadline <= now_) {
+                Wake(*waiter);
+                any = true;
+            }
+        }
+        if (any) {
+            cond_.notify_all();
+        }
+    }
+
+    // 所有参与线程都在等待时，跳到最早的截止时间（调用时已持有mtx_）
+    void MaybeAdvance () {
+        if (busy_ > 0) {
+            return;
+        }
+        time_point next = time_point::max();
+        for (Waiter* waiter : waiters_) {
+            if (!waiter->woken) {
+                next = std::min(next, waiter->deadline);
+            }
+        }
+        if (next != time_point::max()) {
+            SetTime(std::max(now_, next));
+        }
+    }
+};
@@ -0,0 +1,296 @@
+/**
+ * @file compact_bucket.h
+ * @brief 16字节的紧凑令牌桶和按slab分配的桶表 - 用于千万级数量的桶（每用户、每连接一个）
+ *
+ * TokenManager带锁、条件变量和异步等待队列，每个实例占一到数条缓存行，再加上shared_ptr控制块；
+ * 桶的数量到千万级时内存和缓存都放不下。CompactBucket只有两个64位字：
+ * - 状态字：理论到达时间（TAT，GCRA算法），token数量由它和当前时间推导，无锁CAS更新
+ * - 配置字：每个token的间隔（39位）、时间单位标志（1位）和突发量（24位）；
+ *   低速率的间隔以纳秒为单位，高速率（间隔不到约65微秒）以1/64纳秒为单位，避免整数纳秒的取整误差
+ * 补充是惰性的：访问时按当前时间计算可用的token，不需要生产者线程，也不需要遍历所有桶。
+ * CompactBucketTable把桶连续存放在固定大小的slab中，用32位ID引用；
+ * 销毁的桶进入空闲链表（链表指针就存放在桶自身的状态字里），稳态下创建和销毁都不分配内存。
+ */
+
+#pragma once
+
+#include "cache_line.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+
+/**
+ * @class CompactBucket
+ * @brief 16字节、无锁的令牌桶（GCRA）
+ *
+ * 时间由调用方传入（纳秒，任意起点，单调递增），通常取自CompactBucketTable::Now()。
+ * 状态字保存"桶恰好变满的时刻"：每消费n个token向后推n个间隔，
+ * 推到当前时间之后超过突发量对应的时长时拒绝。桶创建时是满的。
+ * 只提供非阻塞操作；需要等待时用WaitTime得到还需等待的时长，由调用方自行调度。
+ *
+ * 内部时间按桶的时间单位计：低速率桶为纳秒，高速率桶为1/64纳秒（now乘以64），
+ * 因此高速率桶要求now小于2^57纳秒（约4.5年；CompactBucketTable::Now()从表创建时开始计时）。
+ */
+class CompactBucket {
+private:
+    static constexpr int kBurstBits = 24;
+    static constexpr uint64_t kBurstMask = (uint64_t(1) << kBurstBits) - 1;
+    static constexpr uint64_t kFineFlag = uint64_t(1) << kBurstBits;   // 间隔以1/64纳秒为单位
+    static constexpr int kIntervalShift = kBurstBits + 1;
+    static constexpr int kFineBits = 6;                                // 高速率桶每纳秒的单位数 = 2^6
+    static constexpr double kFineBelowNs = 65536.0;                    // 间隔短于此值（纳秒）时使用细单位
+    static constexpr uint64_t kMaxSpan = uint64_t(1) << 61;            // 突发量×间隔的上限，now加上它的两倍不会溢出
+
+    std::atomic<uint64_t> tat_{0};   // 理论到达时间（桶的时间单位）；空闲时存放空闲链表的下一个ID
+    uint64_t config_ = 0;            // 间隔（高39位）| 细单位标志（1位）| 突发量（低24位）
+
+public:
+    static constexpr uint64_t kMaxBurst = kBurstMask;                          // 突发量上限（约1677万）
+    static constexpr uint64_t kMaxInterval = (uint64_t(1) << (64 - kIntervalShift)) - 1;  // 间隔上限（纳秒，约9分钟）
+    static constexpr double kMaxRate = 1e9;                                    // 速率上限（每纳秒一个token）
+
+    /**
+     * @brief 设置速率和突发量，并把桶重置为满
+     * @param rate 每秒token数量，约0.002到kMaxRate，超出范围时截断；间隔短于约65微秒（速率高于约15000）时
+     *             按1/64纳秒取整，相对误差不超过0.8%（3e8/s时约0.2%），更低的速率按纳秒取整，误差可以忽略
+     * @param burst 突发量（桶容量），不超过kMaxBurst；突发量×间隔超过2^61个时间单位时截断，保证时间计算不溢出
+     * @param now 当前时间
+     */
+    void Reset (double rate, size_t burst, uint64_t now) {
+        double interval_ns = std::min(static_cast<double>(kMaxInterval), 1e9 / std::min(rate, kMaxRate));
+        bool fine = interval_ns < kFineBelowNs;
+        double units = fine ? std::ldexp(interval_ns, kFineBits) : interval_ns;
+        uint64_t interval = static_cast<uint64_t>(std::llround(std::max(units, 1.0)));
+        uint64_t capacity = std::min<uint64_t>(std::max<size_t>(burst, 1), kMaxBurst);
+        capacity = std::min(capacity, kMaxSpan / interval);
+        config_ = (interval << kIntervalShift) | (fine ? kFineFlag : 0) | capacity;
+        tat_.store(Units(now), std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 尝试消费n个token（无锁）
+     * @return 成功返回true；token不足或n超过突发量返回false
+     */
+    bool TryConsume (size_t n, uint64_t now) {
+        if (n > Burst()) {
+            return false;
+        }
+        now = Units(now);
+        uint64_t interval = Interval();
+        uint64_t limit = now + Burst() * interval;  // 状态字最多推到这里
+        uint64_t cost = n * interval;
+        uint64_t tat = tat_.load(std::memory_order_relaxed);
+        for (;;) {
+            uint64_t next = std::max(tat, now) + cost;
+            if (next > limit) {
+                return false;
+            }
+            if (tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+
+    /**
+     * @brief 当前可用的token数量
+     */
+    size_t Tokens (uint64_t now) const {
+        now = Units(now);
+        uint64_t interval = Interval();
+        uint64_t tat = std::max(tat_.load(std::memory_order_relaxed), now);
+        uint64_t full = Burst() * interval;
+        uint64_t used = tat - now;
+        return used >= full ? 0 : static_cast<size_t>((full - used) / interval);
+    }
+
+    /**
+     * @brief 还需等待多久才有n个token
+     * @return 纳秒数，0表示现在就可以消费；n超过突发量（永远无法满足）时返回UINT64_MAX
+     */
+    uint64_t WaitTime (size_t n, uint64_t now) const {
+        if (n > Burst()) {
+            return UINT64_MAX;
+        }
+        now = Units(now);
+        uint64_t interval = Interval();
+        uint64_t next = std::max(tat_.load(std::memory_order_relaxed), now) + n * interval;
+        uint64_t limit = now + Burst() * interval;
+        if (next <= limit) {
+            return 0;
+        }
+        uint64_t wait = next - limit;
+        return Fine() ? (wait + (uint64_t(1) << kFineBits) - 1) >> kFineBits : wait;  // 向上取整到纳秒
+    }
+
+    /**
+     * @brief 突发量（桶容量）
+     */
+    size_t Burst () const { return static_cast<size_t>(config_ & kBurstMask); }
+
+    /**
+     * @brief 速率（每秒token数）
+     */
+    double Rate () const {
+        double per_ns = Fine() ? static_cast<double>(uint64_t(1) << kFineBits) : 1.0;
+        return 1e9 * per_ns / static_cast<double>(Interval());
+    }
+
+private:
+    friend class CompactBucketTable;
+
+    // 间隔，以桶的时间单位计
+    uint64_t Interval () const { return config_ >> kIntervalShift; }
+
+    bool Fine () const { return (config_ & kFineFlag) != 0; }
+
+    // 纳秒换算为桶的时间单位
+    uint64_t Units (uint64_t now) const { return Fine() ? now << kFineBits : now; }
+};
+
+static_assert(sizeof(CompactBucket) == 16, "CompactBucket must stay 16 bytes");
+
+/**
+ * @brief 桶在CompactBucketTable中的ID
+ */
+using CompactBucketId = uint32_t;
+
+/**
+ * @class CompactBucketTable
+ * @brief 按slab分配的CompactBucket表
+ *
+ * 每个slab连续存放65536个桶（1 MiB，每条缓存行4个桶），ID的高16位是slab编号、低16位是slab内下标。
+ * 通过ID访问桶无锁；Create/Destroy持有一个短暂的互斥锁，只做空闲链表操作，
+ * 只有空闲链表为空时才分配新的slab，slab在表销毁前不会释放。
+ * 相邻的桶共享缓存行，不同线程高频操作相邻的桶时会有伪共享；需要时可以按线程划分ID范围。
+ */
+class CompactBucketTable {
+private:
+    static constexpr int kSlabBits = 16;
+    static constexpr size_t kSlabSize = size_t(1) << kSlabBits;   // 每个slab的桶数量
+    static constexpr size_t kMaxSlabs = size_t(1) << (32 - kSlabBits);
+    static constexpr CompactBucketId kNone = UINT32_MAX;          // 空闲链表结束
+
+    using Clock = std::chrono::steady_clock;
+
+    std::unique_ptr<std::atomic<CompactBucket*>[]> slabs_;  // slab指针，只增不减，读取无锁
+    const Clock::time_point epoch_;                         // Now()的起点
+    std::mutex mtx_;                                        // 保护以下成员
+    CompactBucketId free_head_ = kNone;                     // 空闲链表头
+    size_t slab_count_ = 0;                                 // 已分配的slab数量
+    size_t next_unused_ = 0;                                // 最新slab中下一个从未使用过的下标
+    size_t live_ = 0;                                       // 存活的桶数量
+
+public:
+    CompactBucketTable()
+        : slabs_(new std::atomic<CompactBucket*>[kMaxSlabs]()), epoch_(Clock::now()) {}
+
+    CompactBucketTable(const CompactBucketTable&) = delete;
+    CompactBucketTable& operator=(const CompactBucketTable&) = delete;
+
+    /**
+     * @brief 析构函数：释放所有slab
+     */
+    ~CompactBucketTable() {
+        for (size_t i = 0; i < slab_count_; i++) {
+            ::operator delete(slabs_[i].load(), std::align_val_t(kCacheLineSize));
+        }
+    }
+
+    /**
+     * @brief 当前时间（纳秒，自表创建起）
+     */
+    uint64_t Now () const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - epoch_).count());
+    }
+
+    /**
+     * @brief 创建一个桶（满的）
+     * @param rate 每秒token数量
+     * @param burst 突发量
+     * @return 桶ID
+     * @throw std::bad_alloc 需要新slab但分配失败，或ID已用尽
+     */
+    CompactBucketId Create (double rate, size_t burst) {
+        CompactBucketId id;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (free_head_ != kNone) {
+                id = free_head_;
+                free_head_ = static_cast<CompactBucketId>(At(id).tat_.load(std::memory_order_relaxed));
+            } else {
+                if (slab_count_ == 0 || next_unused_ == kSlabSize) {
+                    AddSlabLocked();
+                }
+                id = static_cast<CompactBucketId>(((slab_count_ - 1) << kSlabBits) | next_unused_++);
+                if (id == kNone) {
+                    throw std::bad_alloc();  // 最后一个ID用作链表结束标记
+                }
+                new (&At(id)) CompactBucket();  // 首次使用时构造
+            }
+            live_++;
+        }
+        At(id).Reset(rate, burst, Now());
+        return id;
+    }
+
+    /**
+     * @brief 销毁一个桶，ID之后可能被重用
+     */
+    void Destroy (CompactBucketId id) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        At(id).tat_.store(free_head_, std::memory_order_relaxed);
+        free_head_ = id;
+        live_--;
+    }
+
+    /**
+     * @brief 按ID访问桶（无锁）
+     */
+    CompactBucket& operator[] (CompactBucketId id) { return At(id); }
+    const CompactBucket& operator[] (CompactBucketId id) const { return At(id); }
+
+    /**
+     * @brief 用当前时间尝试消费
+     */
+    bool TryConsume (CompactBucketId id, size_t n) {
+        return At(id).TryConsume(n, Now());
+    }
+
+    /**
+     * @brief 存活的桶数量
+     */
+    size_t Size () {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return live_;
+    }
+
+    /**
+     * @brief 已分配的内存（字节）
+     */
+    size_t MemoryBytes () {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return slab_count_ * kSlabSize * sizeof(CompactBucket);
+    }
+
+private:
+    CompactBucket& At (CompactBucketId id) const {
+        return slabs_[id >> kSlabBits].load(std::memory_order_acquire)[id & (kSlabSize - 1)];
+    }
+
+    // 分配一个新slab（调用时已持有mtx_）
+    void AddSlabLocked () {
+        if (slab_count_ == kMaxSlabs) {
+            throw std::bad_alloc();
+        }
+        void* memory = ::operator new(kSlabSize * sizeof(CompactBucket), std::align_val_t(kCacheLineSize));
+        slabs_[slab_count_].store(static_cast<CompactBucket*>(memory), std::memory_order_release);
+        slab_count_++;
+        next_unused_ = 0;
+    }
+};
@@ -0,0 +1,361 @@
+/**
+ * @file concurrency_limiter.h
+ * @brief 自适应并发限制 - token表示在途请求的槽位，上限按观测到的延迟自动调整
+ *
+ * 固定的max_tokens要么压垮后端，要么浪费容量。ConcurrencyLimiter把一个TokenManager当作槽位池：
+ * 获取一个token = 占用一个在途槽位，请求完成后归还并报告本次的往返时间（RTT）。
+ * 上限（limit）按RTT样本自动调整，支持两种算法：
+ * - Vegas：以最小RTT估计无排队时的延迟，按 limit × (1 - 最小RTT/RTT) 估计排队的请求数，
+ *   排队少于alpha时增大上限，多于beta时减小（类似TCP Vegas）
+ * - Gradient：比较平滑后的RTT与最小RTT，RTT超过最小RTT的tolerance倍时按比例收缩，
+ *   否则以sqrt(limit)的余量试探增大
+ * 两种算法的最小RTT都每隔probe_samples个样本重新测量，后端变慢（或变快）后基线随之更新。
+ * 上限按窗口调整：每收集到约一个上限数量的样本（满负荷时约一个RTT）调整一次。
+ * 一个RTT内完成的请求都是在同一个排队状态下发出的，逐个样本调整会把上限推过头并持续振荡。
+ * 出现失败（超时、被拒绝等）时不等窗口结束，立即按比例减小上限。
+ * RTT可以通过Lease::Release报告，也可以用Measure包装TokenCustomer的下游任务自动测量。
+ */
+
+#pragma once
+
+#include "token_manager.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+/**
+ * @struct ConcurrencyLimiterConfig
+ * @brief 自适应并发限制配置
+ */
+struct ConcurrencyLimiterConfig {
+    enum class Mode { kVegas, kGradient };
+
+    Mode mode = Mode::kVegas;               // 控制算法
+    size_t initial_limit = 20;              // 初始并发上限
+    size_t min_limit = 1;                   // 并发上限的下限
+    size_t max_limit = 1000;                // 并发上限的上限
+    double backoff = 0.9;                   // 出现失败时上限乘以该系数
+    uint64_t probe_samples = 1000;          // 每隔多少个样本重新测量最小RTT
+    double vegas_alpha = 3;                 // Vegas：排队估计低于alpha*log10(limit)时增大
+    double vegas_beta = 6;                  // Vegas：排队估计高于beta*log10(limit)时减小
+    double gradient_tolerance = 1.5;        // Gradient：平滑RTT在最小RTT的该倍数以内视为没有排队
+    double gradient_smoothing = 0.2;        // Gradient：新旧上限的平滑系数
+    double rtt_window = 10;                 // Gradient：平滑RTT的平均样本数
+};
+
+/**
+ * @struct ConcurrencyLimiterStats
+ * @brief 并发限制运行统计快照
+ */
+struct ConcurrencyLimiterStats {
+    size_t limit = 0;                       // 当前并发上限
+    size_t in_flight = 0;                   // 在途请求数量
+    uint64_t samples = 0;                   // 收到的RTT样本数
+    uint64_t drops = 0;                     // 失败的样本数
+    std::chrono::nanoseconds min_rtt{0};    // 当前的最小RTT（无排队延迟的估计）
+    std::chrono::nanoseconds rtt{0};        // Gradient：平滑后的RTT
+};
+
+/**
+ * @class ConcurrencyLimiter
+ * @brief 线程安全的自适应并发限制器
+ *
+ * 槽位池是一个普通的TokenManager（Slots()），可以直接交给TokenCustomer、TokenEventFd等现有组件：
+ * 它们消费一个token就是占用一个槽位，之后必须通过Release(rtt, ok)归还。
+ * 上限变化通过增减槽位池中的token生效：增大时立即补充；减小时先取走空闲槽位，
+ * 不够的部分记为欠账，由之后归还的槽位抵扣，在途请求不受影响。
+ */
+class ConcurrencyLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @class Lease
+     * @brief 一个占用中的槽位
+     *
+     * 只可移动。请求完成后调用Release(ok)，按获取至今的时间报告RTT并归还槽位；
+     * 未调用Release就析构时只归还槽位，不产生样本（例如请求被取消）。
+     */
+    class Lease {
+    private:
+        ConcurrencyLimiter* limiter_ = nullptr;
+        Clock::time_point start_;
+
+    public:
+        Lease() = default;
+        Lease(ConcurrencyLimiter* limiter, Clock::time_point start) : limiter_(limiter), start_(start) {}
+        Lease(Lease&& other) noexcept : limiter_(other.limiter_), start_(other.start_) { other.limiter_ = nullptr; }
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                Drop();
+                limiter_ = other.limiter_;
+                start_ = other.start_;
+                other.limiter_ = nullptr;
+            }
+            return *this;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { Drop(); }
+
+        /**
+         * @brief 是否持有槽位（TryAcquire失败或被中断时为false）
+         */
+        explicit operator bool () const { return limiter_ != nullptr; }
+
+        /**
+         * @brief 请求完成：报告RTT和结果，归还槽位
+         * @param ok 成功返回true，过载/超时/被拒绝等返回false
+         */
+        void Release (bool ok = true) {
+            if (limiter_) {
+                limiter_->Release(Clock::now() - start_, ok);
+                limiter_ = nullptr;
+            }
+        }
+
+        /**
+         * @brief 归还槽位，不产生样本
+         */
+        void Drop () {
+            if (limiter_) {
+                limiter_->ReturnSlot();
+                limiter_ = nullptr;
+            }
+        }
+    };
+
+private:
+    const ConcurrencyLimiterConfig config_;    // 控制参数
+    std::shared_ptr<TokenManager> slots_;      // 槽位池：空闲槽位数量，最大值为max_limit
+    mutable std::mutex mtx_;                   // 保护以下成员
+    double limit_;                             // 当前上限（小数部分用于平滑调整）
+    size_t slots_limit_;                       // 已经反映到槽位池中的上限（limit_取整）
+    size_t debt_ = 0;                          // 上限减小时尚未收回的槽位
+    uint64_t samples_ = 0;                     // 样本数
+    uint64_t drops_ = 0;                       // 失败样本数
+    double min_rtt_ = 0;                       // 最小RTT（秒，0表示尚未测量）
+    uint64_t probe_countdown_;                 // 距离下次重新测量最小RTT的样本数
+    double smoothed_rtt_ = 0;                  // Gradient：平滑后的RTT（秒）
+    size_t window_samples_ = 0;                // 当前窗口的成功样本数
+    double window_rtt_ = 0;                    // 当前窗口的RTT之和（秒）
+    size_t window_in_flight_ = 0;              // 当前窗口内观测到的最大在途请求数
+
+public:
+    /**
+     * @brief 构造函数
+     * @param config 控制参数
+     */
+    explicit ConcurrencyLimiter(ConcurrencyLimiterConfig config = ConcurrencyLimiterConfig())
+        : config_(config),
+          slots_(std::make_shared<TokenManager>(config.max_limit)),
+          limit_(static_cast<double>(ClampLimit(config.initial_limit))),
+          slots_limit_(ClampLimit(config.initial_limit)),
+          probe_countdown_(config.probe_samples) {
+        slots_->AddTokens(slots_limit_);
+    }
+
+    /**
+     * @brief 阻塞获取一个槽位
+     * @param stop_flag 停止标志（可选），为true时中断等待
+     * @return 槽位；被中断时返回空的Lease
+     */
+    Lease Acquire (std::atomic<bool>* stop_flag = nullptr) {
+        if (!slots_->ConsumeTokensWithStopCheck(1, stop_flag)) {
+            return Lease();
+        }
+        return Lease(this, Clock::now());
+    }
+
+    /**
+     * @brief 尝试获取一个槽位（非阻塞）
+     * @return 槽位；已达到上限时返回空的Lease
+     */
+    Lease TryAcquire () {
+        if (!slots_->TryConsumeTokens(1)) {
+            return Lease();
+        }
+        return Lease(this, Clock::now());
+    }
+
+    /**
+     * @brief 归还一个直接从Slots()获取的槽位并报告样本
+     * @param rtt 本次请求的往返时间
+     * @param ok 成功返回true，过载/超时/被拒绝等返回false
+     */
+    void Release (Clock::duration rtt, bool ok = true) {
+        std::chrono::duration<double> seconds = rtt;
+        size_t grow;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            grow = OnSampleLocked(seconds.count(), ok) + ReturnSlotLocked();
+        }
+        // 在锁外补充：AddTokens会直接调用已满足的异步回调，回调中可能再次归还槽位
+        if (grow > 0) {
+            slots_->AddTokens(grow);
+        }
+    }
+
+    /**
+     * @brief 包装一个下游任务：测量耗时，完成后报告样本并归还槽位
+     * @param task 下游任务，返回true表示成功
+     * @return 可以交给TokenCustomer::SetTask的任务（该消费者须从Slots()每次获取1个token）
+     */
+    std::function<bool()> Measure (std::function<bool()> task) {
+        return [this, task = std::move(task)]() {
+            auto begin = Clock::now();
+            bool ok = task();
+            Release(Clock::now() - begin, ok);
+            return ok;
+        };
+    }
+
+    /**
+     * @brief 获取槽位池，供TokenCustomer、TokenEventFd等按token获取槽位
+     */
+    std::shared_ptr<TokenManager> Slots () const { return slots_; }
+
+    /**
+     * @brief 获取当前并发上限
+     */
+    size_t Limit () const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return slots_limit_;
+    }
+
+    /**
+     * @brief 获取运行统计
+     */
+    ConcurrencyLimiterStats GetStats () const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ConcurrencyLimiterStats stats;
+        stats.limit = slots_limit_;
+        stats.in_flight = InFlightLocked();
+        stats.samples = samples_;
+        stats.drops = drops_;
+        stats.min_rtt = ToNs(min_rtt_);
+        stats.rtt = ToNs(smoothed_rtt_);
+        return stats;
+    }
+
+private:
+    static std::chrono::nanoseconds ToNs (double seconds) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(seconds));
+    }
+
+    size_t ClampLimit (size_t limit) const {
+        return std::max(config_.min_limit, std::min(config_.max_limit, limit));
+    }
+
+    // 在途请求数量 = 上限 + 欠账 - 空闲槽位（调用时已持有mtx_，仅作估计）
+    size_t InFlightLocked () const {
+        size_t free = slots_->GetTokens();
+        return slots_limit_ + debt_ > free ? slots_limit_ + debt_ - free : 0;
+    }
+
+    // 归还一个槽位，不产生样本
+    void ReturnSlot () {
+        bool grow;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            grow = ReturnSlotLocked() > 0;
+        }
+        if (grow) {
+            slots_->AddToken();
+        }
+    }
+
+    // 归还一个槽位：有欠账时抵扣欠账并返回0，否则返回需要放回槽位池的数量1（调用时已持有mtx_）
+    size_t ReturnSlotLocked () {
+        if (debt_ > 0) {
+            debt_--;
+            return 0;
+        }
+        return 1;
+    }
+
+    // 处理一个样本并调整上限，返回需要补充到槽位池的数量（调用时已持有mtx_）
+    size_t OnSampleLocked (double rtt, bool ok) {
+        samples_++;
+        size_t in_flight = InFlightLocked() + 1;  // 包括正在归还的这个请求
+        if (--probe_countdown_ == 0) {
+            probe_countdown_ = config_.probe_samples;
+            min_rtt_ = 0;  // 重新测量无排队延迟
+        }
+        if (min_rtt_ == 0 || rtt < min_rtt_) {
+            min_rtt_ = rtt;
+        }
+        if (config_.mode == ConcurrencyLimiterConfig::Mode::kGradient) {
+            smoothed_rtt_ = smoothed_rtt_ == 0 ? rtt : smoothed_rtt_ + (rtt - smoothed_rtt_) / config_.rtt_window;
+        }
+        double limit;
+        if (!ok) {
+            drops_++;
+            limit = limit_ * config_.backoff;  // 后端已经过载，快速后退
+        } else {
+            window_rtt_ += rtt;
+            window_in_flight_ = std::max(window_in_flight_, in_flight);
+            if (++window_samples_ < std::max<size_t>(1, slots_limit_)) {
+                return 0;  // 窗口未满，上限不变
+            }
+            if (config_.mode == ConcurrencyLimiterConfig::Mode::kVegas) {
+                limit = VegasLocked(window_rtt_ / window_samples_, window_in_flight_);
+            } else {
+                limit = GradientLocked(window_in_flight_);
+            }
+        }
+        window_samples_ = 0;
+        window_rtt_ = 0;
+        window_in_flight_ = 0;
+        limit_ = std::max<double>(config_.min_limit, std::min<double>(config_.max_limit, limit));
+        return ResizeLocked(static_cast<size_t>(limit_));
+    }
+
+    // rtt为窗口内的平均RTT，in_flight为窗口内的最大在途请求数
+    double VegasLocked (double rtt, size_t in_flight) {
+        double limit = limit_;
+        double step = std::max(1.0, std::log10(limit));
+        double queue = limit * (1 - min_rtt_ / rtt);  // 估计正在排队的请求数
+        if (queue < config_.vegas_alpha * step) {
+            // 请求数远低于上限时（应用本身的需求不足）不增大，避免上限无意义地膨胀
+            if (in_flight * 2 >= limit) {
+                limit += step;
+            }
+        } else if (queue > config_.vegas_beta * step) {
+            limit -= step;
+        }
+        return limit;
+    }
+
+    double GradientLocked (size_t in_flight) {
+        double limit = limit_;
+        if (in_flight * 2 < limit) {
+            return limit;  // 需求不足，样本不能说明上限是否合适
+        }
+        double gradient = std::max(0.5, std::min(1.0, config_.gradient_tolerance * min_rtt_ / smoothed_rtt_));
+        double target = limit * gradient + std::sqrt(limit);
+        return limit * (1 - config_.gradient_smoothing) + target * config_.gradient_smoothing;
+    }
+
+    // 把新的整数上限反映到槽位池，返回需要补充的槽位数量（调用时已持有mtx_）
+    size_t ResizeLocked (size_t limit) {
+        size_t grow = 0;
+        if (limit > slots_limit_) {
+            grow = limit - slots_limit_;
+            size_t repaid = std::min(grow, debt_);  // 先免除欠账
+            debt_ -= repaid;
+            grow -= repaid;
+        } else if (limit < slots_limit_) {
+            size_t shrink = slots_limit_ - limit;
+            size_t taken = slots_->TryConsumeUpTo(shrink);  // 先收回空闲槽位
+            debt_ += shrink - taken;
+        }
+        slots_limit_ = limit;
+        return grow;
+    }
+};
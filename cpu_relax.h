@@ -0,0 +1,24 @@
+/**
+ * @file cpu_relax.h
+ * @brief 自旋等待时的CPU提示
+ *
+ * 在忙等循环中调用CpuRelax()，让CPU知道当前处于自旋状态：
+ * 降低功耗、减少对同核超线程的干扰，并避免退出循环时的内存序流水线冲刷。
+ */
+
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief 自旋等待提示（x86为pause，ARM为yield，其他平台为空操作）
+ */
+inline void CpuRelax () {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
@@ -0,0 +1,106 @@
+/**
+ * @file false_sharing_benchmark.cpp
+ * @brief 伪共享基准测试
+ *
+ * 每个线程只操作属于自己的一个桶（AddToken + TryConsumeTokens），线程之间没有共享数据。
+ * - PackedBucket：原来的TokenManager布局（最大值、计数、锁、条件变量紧挨着，大小不是缓存行的整数倍），
+ *   连续存放时相邻的桶落在同一条缓存行上
+ * - TokenManagerArray：按缓存行对齐的TokenManager
+ * 多核机器上前者的每次操作明显更慢，后者随线程数线性扩展。
+ *
+ * 编译：g++ -std=c++17 -O2 -pthread false_sharing_benchmark.cpp -o false_sharing_benchmark
+ * 运行：./false_sharing_benchmark [线程数] [每线程操作次数]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#include "token_manager_array.h"
+
+// 对齐前的TokenManager布局，只保留基准测试用到的操作
+class PackedBucket {
+public:
+    explicit PackedBucket(size_t max_tokens) : max_tokens_(max_tokens), current_tokens_(0) {}
+
+    bool AddToken () {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (current_tokens_ >= max_tokens_) {
+            return false;
+        }
+        current_tokens_++;
+        cond_.notify_all();
+        return true;
+    }
+
+    bool TryConsumeTokens (size_t n) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (current_tokens_ >= n) {
+            current_tokens_ -= n;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    const size_t max_tokens_;
+    size_t current_tokens_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+};
+
+// 每个线程反复操作buckets[i]，返回每次操作的平均纳秒数
+template <typename GetBucket>
+double Run (size_t threads, size_t ops, GetBucket get_bucket) {
+    std::vector<std::thread> workers;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([t, ops, &get_bucket]() {
+            auto& bucket = get_bucket(t);
+            for (size_t i = 0; i < ops; i++) {
+                bucket.AddToken();
+                bucket.TryConsumeTokens(1);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+    return ns / (ops * 2);
+}
+
+int main (int argc, char* argv[]) {
+    size_t threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                              : std::max<unsigned>(2, std::thread::hardware_concurrency());
+    size_t ops = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5000000;
+    std::cout << "threads: " << threads << ", ops per thread: " << ops * 2 << std::endl;
+    std::cout << "sizeof(PackedBucket) = " << sizeof(PackedBucket)
+              << ", sizeof(TokenManager) = " << sizeof(TokenManager) << std::endl;
+
+    // 连续存放的未对齐桶
+    std::allocator<PackedBucket> allocator;
+    PackedBucket* packed = allocator.allocate(threads);
+    for (size_t t = 0; t < threads; t++) {
+        new (&packed[t]) PackedBucket(10);
+    }
+    double packed_ns = Run(threads, ops, [packed](size_t t) -> PackedBucket& { return packed[t]; });
+    for (size_t t = 0; t < threads; t++) {
+        packed[t].~PackedBucket();
+    }
+    allocator.deallocate(packed, threads);
+
+    // 按缓存行对齐的桶
+    TokenManagerArray aligned(threads, 10);
+    double aligned_ns = Run(threads, ops, [&aligned](size_t t) -> TokenManager& { return aligned[t]; });
+
+    std::cout << "packed buckets : " << packed_ns << " ns/op" << std::endl;
+    std::cout << "aligned buckets: " << aligned_ns << " ns/op" << std::endl;
+    return 0;
+}
@@ -6,15 +6,23 @@
  * - TokenProducer: 定期生产token并添加到TokenManager
  * - TokenCustomer: 从TokenManager消费指定数量的token
  * - TokenManager: 管理token的存储和线程安全的访问
+ *
+ * 运行：./main [--virtual] [运行秒数]
+ * --virtual 使用虚拟时钟：生产者和消费者在虚拟时间中运行，几小时的过程几毫秒跑完，结果可重复。
  */
 
 #include "token_manager.h"
 #include "token_customer.h"
 #include "token_producer.h"
+#include "async_logger.h"
+#include "clock_source.h"
 #include <vector>
 #include <memory>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
 #include <thread>
 
 /**
@@ -28,9 +36,31 @@
  * 5. 停止所有消费者和生产者
  * 6. 输出统计信息
  */
-int main () {
+int main (int argc, char* argv[]) {
     std::cout << "token manager show case" << std::endl;
 
+    // 解析参数：是否使用虚拟时钟、运行时长
+    bool use_virtual = false;
+    long run_seconds = 10;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--virtual") == 0) {
+            use_virtual = true;
+        } else {
+            run_seconds = std::strtol(argv[i], nullptr, 10);
+        }
+    }
+    // 虚拟时钟注入给生产者和消费者；主线程也登记为参与线程，睡眠期间时间才会推进
+    std::shared_ptr<VirtualClock> virtual_clock;
+    std::shared_ptr<ClockSource> clock;
+    if (use_virtual) {
+        virtual_clock = std::make_shared<VirtualClock>();
+        virtual_clock->Attach();
+        virtual_clock->Bind();
+        clock = virtual_clock;
+    } else {
+        clock = std::make_shared<SystemClock>();
+    }
+
     // 初始化Token管理器，设置最大token数量为10
     const size_t max_tokens = 10;
     auto token_manager = std::make_shared<TokenManager>(max_tokens);
@@ -41,6 +71,9 @@ int main () {
     std::vector<std::unique_ptr<TokenProducer>> producers;
     for (size_t i = 0; i < produced_count; i++) {
         auto producer = std::make_unique<TokenProducer>(token_manager);
+        if (virtual_clock) {
+            producer->SetClock(virtual_clock);
+        }
         producer->start();  // 启动生产者线程，每500ms生产一个token
         producers.emplace_back(std::move(producer));
         std::cout << "active the token manager" << std::endl;
@@ -50,16 +83,23 @@ int main () {
     const size_t cons_count = 5;      // 消费者数量
     const size_t cons_per = 3;        // 每个消费者每次消费的token数量
 
+    // 消费回调在消费者线程上执行，通过异步日志输出，不让std::cout拖慢消费
+    AsyncLogger logger;
+    logger.start();
+
     std::cout << "initial the consumer, per 3: " << std::endl;
     std::vector<std::unique_ptr<TokenCustomer>> consumers;
-    auto start_time = std::chrono::steady_clock::now();  // 记录开始时间
+    auto start_time = clock->Now();  // 记录开始时间
 
     // 创建并启动所有消费者线程
     for (size_t i = 0; i < cons_count; i++) {
         // 创建消费者，并设置回调函数用于输出消费成功的信息
-        auto consumer = std::make_unique<TokenCustomer>(token_manager, cons_per, [i](bool success) {
-            std::cout << "consumer " << i + 1 << " success consume: " << cons_per << " tokens" << std::endl;
+        auto consumer = std::make_unique<TokenCustomer>(token_manager, cons_per, [i, &logger](bool) {
+            logger.Log("consumer " + std::to_string(i + 1) + " success consume: " + std::to_string(cons_per) + " tokens");
         });
+        if (virtual_clock) {
+            consumer->SetClock(virtual_clock);
+        }
         consumer->start();  // 启动消费者线程
         consumers.emplace_back(std::move(consumer));
         std::cout << i + 1 << std::endl;
@@ -67,16 +107,17 @@ int main () {
 
     // 等待一段时间让消费者和生产者运行
     // 这样可以让系统有时间产生和消费token，观察实际运行效果
-    std::cout << "Waiting for consumers and producers to run..." << std::endl;
-    std::this_thread::sleep_for(std::chrono::seconds(10));
+    logger.Log("Waiting for consumers and producers to run...");
+    clock->SleepFor(std::chrono::seconds(run_seconds));
 
     // 停止所有消费者线程
     for (const auto& consumer : consumers) {
         consumer->stop();
     }
+    logger.Flush();  // 先写出所有消费日志，再输出统计
     
     // 计算并输出运行时间
-    auto end_time = std::chrono::steady_clock::now();
+    auto end_time = clock->Now();
     auto total_time = std::chrono::duration_cast<std::chrono::milliseconds>(
         end_time - start_time).count();
     std::cout << "info" << std::endl;
@@ -84,7 +125,16 @@ int main () {
     
     // 输出每个消费者的信息
     for (size_t i = 0; i < cons_count; i++) {
-        std::cout << "consumer[" << i + 1 << "] " << std::endl;
+        CustomerStats stats = consumers[i]->GetStats();
+        auto to_ms = [](std::chrono::nanoseconds d) {
+            return std::chrono::duration<double, std::milli>(d).count();
+        };
+        std::cout << "consumer[" << i + 1 << "] grants: " << stats.grants
+                  << " tokens: " << stats.tokens
+                  << " avg wait: " << to_ms(stats.avg_wait) << " ms"
+                  << " max wait: " << to_ms(stats.max_wait) << " ms"
+                  << " callback: " << to_ms(stats.callback_time) << " ms"
+                  << " rate: " << stats.rate << " tokens/s" << std::endl;
     }
     
     // 输出剩余token数量
@@ -94,5 +144,8 @@ int main () {
     for (auto& producer : producers) {
         producer->stop();
     }
+    if (virtual_clock) {
+        virtual_clock->Detach();
+    }
     std::cout << "case finish" << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,235 @@
+/**
+ * @file mpmc_queue.h
+ * @brief 无锁有界多生产者多消费者环形队列
+ *
+ * 基于Dmitry Vyukov的有界MPMC队列：每个槽带一个序号，生产者和消费者各自用CAS抢占位置，
+ * 通过槽序号判断该槽是否可写/可读，正常路径上没有锁。
+ * - 槽、入队位置、出队位置都按缓存行对齐，避免相邻槽和两端计数器之间的伪共享
+ * - 提供非阻塞的try_put/try_get和阻塞的put/get
+ * - 阻塞操作先短暂自旋，只有队列确实满（或空）时才在条件变量上休眠；
+ *   另一端只在有休眠者时才去加锁唤醒
+ */
+
+#pragma once
+
+#include "cache_line.h"
+#include "cpu_relax.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+/**
+ * @class MpmcQueue
+ * @brief 无锁有界MPMC环形队列
+ * @tparam T 元素类型
+ */
+template <typename T>
+class MpmcQueue {
+private:
+    // 一个槽：seq == pos 表示可写，seq == pos + 1 表示可读
+    struct alignas(kCacheLineSize) Slot {
+        std::atomic<size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* Item () { return reinterpret_cast<T*>(storage); }
+    };
+
+    static constexpr int kSpinCount = 64;          // 休眠前的自旋次数
+
+    const size_t mask_;                             // 容量-1（容量为2的幂）
+    std::unique_ptr<Slot[]> slots_;                 // 槽数组
+    alignas(kCacheLineSize) std::atomic<size_t> enqueue_pos_{0};  // 下一个入队位置
+    alignas(kCacheLineSize) std::atomic<size_t> dequeue_pos_{0};  // 下一个出队位置
+    alignas(kCacheLineSize) std::atomic<size_t> put_waiters_{0};  // 因队列满而休眠的生产者数
+    std::atomic<size_t> get_waiters_{0};                           // 因队列空而休眠的消费者数
+    std::mutex mtx_;                                // 仅用于休眠
+    std::condition_variable not_full_;              // 队列不满
+    std::condition_variable not_empty_;             // 队列非空
+
+public:
+    /**
+     * @brief 构造函数
+     * @param capacity 容量，向上取整到2的幂（至少为2）
+     */
+    explicit MpmcQueue(size_t capacity) : mask_(RoundUp(capacity) - 1), slots_(new Slot[mask_ + 1]) {
+        for (size_t i = 0; i <= mask_; i++) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    /**
+     * @brief 析构函数，销毁队列中剩余的元素
+     */
+    ~MpmcQueue() {
+        size_t end = enqueue_pos_.load(std::memory_order_relaxed);
+        for (size_t pos = dequeue_pos_.load(std::memory_order_relaxed); pos != end; pos++) {
+            slots_[pos & mask_].Item()->~T();
+        }
+    }
+
+    /**
+     * @brief 尝试入队（非阻塞）
+     * @param val 要入队的元素
+     * @return 成功返回true，队列满返回false
+     */
+    bool try_put (const T& val) { return EnqueueAndWake(val); }
+    bool try_put (T&& val) { return EnqueueAndWake(std::move(val)); }
+
+    /**
+     * @brief 尝试出队（非阻塞）
+     * @param out 出队的元素
+     * @return 成功返回true，队列空返回false
+     */
+    bool try_get (T& out) {
+        if (!TryDequeue(out)) {
+            return false;
+        }
+        WakeOne(put_waiters_, not_full_);
+        return true;
+    }
+
+    /**
+     * @brief 阻塞入队
+     * @param val 要入队的元素
+     *
+     * 队列满时先自旋，仍然满才休眠，直到有消费者取走元素。
+     */
+    void put (T val) {
+        for (int i = 0; i < kSpinCount; i++) {
+            if (EnqueueAndWake(std::move(val))) {
+                return;
+            }
+            CpuRelax();
+        }
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            put_waiters_.fetch_add(1);
+            while (!TryEnqueue(std::move(val))) {
+                not_full_.wait(lock);
+            }
+            put_waiters_.fetch_sub(1);
+        }
+        WakeOne(get_waiters_, not_empty_);
+    }
+
+    /**
+     * @brief 阻塞出队
+     * @return 出队的元素
+     *
+     * 队列空时先自旋，仍然空才休眠，直到有生产者放入元素。
+     */
+    T get () {
+        T val;
+        for (int i = 0; i < kSpinCount; i++) {
+            if (try_get(val)) {
+                return val;
+            }
+            CpuRelax();
+        }
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            get_waiters_.fetch_add(1);
+            while (!TryDequeue(val)) {
+                not_empty_.wait(lock);
+            }
+            get_waiters_.fetch_sub(1);
+        }
+        WakeOne(put_waiters_, not_full_);
+        return val;
+    }
+
+    /**
+     * @brief 获取容量
+     */
+    size_t capacity () const { return mask_ + 1; }
+
+    /**
+     * @brief 获取当前元素数量（并发修改时为近似值）
+     */
+    size_t size () const {
+        size_t enq = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t deq = dequeue_pos_.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+private:
+    // 入队成功后唤醒一个休眠的消费者
+    template <typename U>
+    bool EnqueueAndWake (U&& val) {
+        if (!TryEnqueue(std::forward<U>(val))) {
+            return false;
+        }
+        WakeOne(get_waiters_, not_empty_);
+        return true;
+    }
+
+    static size_t RoundUp (size_t n) {
+        size_t cap = 2;
+        while (cap < n) {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    // 出队成功返回true（不唤醒生产者）
+    bool TryDequeue (T& out) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[pos & mask_];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = std::move(*slot.Item());
+                    slot.Item()->~T();
+                    slot.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // 队列空
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 入队成功时才从val移动，失败时val保持不变（不唤醒消费者）
+    template <typename U>
+    bool TryEnqueue (U&& val) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[pos & mask_];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new (slot.storage) T(std::forward<U>(val));
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // 队列满
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 有休眠者时才加锁唤醒一个。
+    // 全序栅栏与休眠方"先登记再检查队列"配对：要么休眠方看到新状态，要么这里看到休眠方。
+    void WakeOne (std::atomic<size_t>& waiters, std::condition_variable& cond) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            cond.notify_one();
+        }
+    }
+};
@@ -0,0 +1,205 @@
+/**
+ * @file multi_acquire.h
+ * @brief 跨多个TokenManager的原子获取 - 一次请求同时扣除多个配额（每用户、每接口、全局）
+ *
+ * 依次对每个桶调用TryConsumeTokens可能只成功一部分，需要手动退回；
+ * 依次阻塞获取则会在等待后面的桶时占着前面桶的token，多个请求按不同顺序获取时还可能互相等待。
+ * BasicMultiAcquire按桶的地址顺序同时锁住所有桶，全部足够时一起扣除，否则一个都不扣：
+ * - 加锁顺序全局一致，不会死锁；持有锁的时间只有一次检查和扣除
+ * - 阻塞获取在每个桶上注册变化通知（TokenManager::Watch），不在任何桶上等待，也不占用token；
+ *   通知到来时由修改者的线程重新尝试，全部满足并扣除之后才唤醒等待线程一次
+ *
+ * 通知的开销：桶的每次变化按登记顺序通知该桶上的所有N个阻塞获取。每个通知先逐个桶检查（每次只锁一个桶，
+ * 从发出通知的桶之后的桶开始，通常一次就发现仍不够而返回），只有全部看起来足够时才同时锁住M个桶扣除，
+ * 因此每次变化的加锁次数约为N，而不是N×M。同一个桶上阻塞的多桶请求很多时，应让它们共用一个补充节拍
+ * （RefillScheduler会把同一轮的补充合并为一次AddTokens）。
+ * 顺序：每次变化按登记顺序尝试，先登记、且此时可以满足的请求先得到token；
+ * 被其他桶卡住的请求不会阻止后面的请求（不是严格的FIFO）。
+ */
+
+#pragma once
+
+#include "token_manager.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * @class BasicMultiAcquire
+ * @brief 对一组桶的原子获取
+ * @tparam Manager 桶的类型（使用FifoQueue排队策略的BasicTokenManager）
+ *
+ * 构造时指定每个桶要扣除的数量，之后可以反复获取。同一个桶出现多次时数量合并。
+ * 和TryConsumeTokens一样遵守桶的FIFO规则：任何一个桶上有排队的请求时不插队，
+ * 因此在各桶都很紧张时，多桶请求可能要等到所有桶的队列都清空之后才能满足。
+ */
+template <typename Manager>
+class BasicMultiAcquire {
+    static_assert(Manager::kQueue, "BasicMultiAcquire requires the FifoQueue policy");
+
+public:
+    /**
+     * @brief 一个桶和要从中扣除的数量
+     */
+    struct Charge {
+        std::shared_ptr<Manager> bucket;
+        size_t n;
+    };
+
+private:
+    // 阻塞获取的状态，由等待线程和各个桶上的变化通知共同持有
+    struct Waiter {
+        std::mutex mtx;
+        std::condition_variable cv;
+        const std::vector<Charge>* charges;  // closed之后不再访问
+        bool done = false;                   // 已经由通知扣除成功
+        bool closed = false;                 // 等待线程已经返回
+    };
+
+    std::vector<Charge> charges_;   // 按桶地址排序，无重复
+
+public:
+    /**
+     * @brief 构造函数
+     * @param charges 每个桶要扣除的数量
+     */
+    explicit BasicMultiAcquire(std::vector<Charge> charges) : charges_(std::move(charges)) {
+        std::sort(charges_.begin(), charges_.end(), [] (const Charge& a, const Charge& b) {
+            return std::less<Manager*>()(a.bucket.get(), b.bucket.get());
+        });
+        // 合并同一个桶，否则会对同一把锁加锁两次
+        size_t out = 0;
+        for (size_t i = 0; i < charges_.size(); i++) {
+            if (out > 0 && charges_[out - 1].bucket == charges_[i].bucket) {
+                charges_[out - 1].n += charges_[i].n;
+            } else {
+                charges_[out++] = std::move(charges_[i]);
+            }
+        }
+        charges_.resize(out);
+    }
+
+    /**
+     * @brief 尝试从所有桶扣除（非阻塞，全部成功或全部不扣）
+     * @return 所有桶都足够并已扣除返回true
+     */
+    bool TryAcquire () {
+        return TryAcquireAll(charges_);
+    }
+
+    /**
+     * @brief 阻塞等待直到可以从所有桶扣除
+     * @param stop_flag 停止标志（可选），为true时中断等待
+     * @return 已从所有桶扣除返回true；被停止信号中断或请求永远无法满足返回false（都不扣除）
+     *
+     * 等待期间不持有任何桶的锁和token。每100ms检查一次停止标志和是否仍然可能满足。
+     */
+    bool Acquire (std::atomic<bool>* stop_flag = nullptr) {
+        if (TryAcquire()) {
+            return true;
+        }
+        if (!Feasible()) {
+            return false;
+        }
+        auto waiter = std::make_shared<Waiter>();
+        waiter->charges = &charges_;
+        std::vector<uint64_t> ids;
+        ids.reserve(charges_.size());
+        for (size_t i = 0; i < charges_.size(); i++) {
+            ids.push_back(charges_[i].bucket->Watch([waiter, i] () { Complete(*waiter, i + 1); }));
+        }
+        Complete(*waiter, 0);  // 注册之前到达的token不会触发通知，这里补一次
+        bool acquired;
+        {
+            std::unique_lock<std::mutex> lock(waiter->mtx);
+            while (!waiter->done) {
+                if ((stop_flag && stop_flag->load()) || !Feasible()) {
+                    break;
+                }
+                waiter->cv.wait_for(lock, std::chrono::milliseconds(100));
+            }
+            acquired = waiter->done;
+            waiter->closed = true;  // 之后的通知不再扣除
+        }
+        for (size_t i = 0; i < charges_.size(); i++) {
+            charges_[i].bucket->Unwatch(ids[i]);
+        }
+        return acquired;
+    }
+
+    /**
+     * @brief 请求是否有可能被满足（每个桶都满足Feasible）
+     */
+    bool Feasible () const {
+        for (const Charge& charge : charges_) {
+            if (!charge.bucket->Feasible(charge.n)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief 合并、排序之后的扣除列表
+     */
+    const std::vector<Charge>& Charges () const { return charges_; }
+
+private:
+    // 按地址顺序锁住所有桶，全部足够时一起扣除
+    static bool TryAcquireAll (const std::vector<Charge>& charges) {
+        for (const Charge& charge : charges) {
+            charge.bucket->mtx_.lock();
+        }
+        bool ok = std::all_of(charges.begin(), charges.end(), [] (const Charge& charge) {
+            return charge.bucket->ReadyLocked(charge.n);
+        });
+        if (ok) {
+            for (const Charge& charge : charges) {
+                charge.bucket->TakeLocked(charge.n);
+            }
+        }
+        for (size_t i = charges.size(); i > 0; i--) {
+            charges[i - 1].bucket->mtx_.unlock();
+        }
+        return ok;
+    }
+
+    // 逐个桶检查是否都足够，每次只锁一个桶；从first开始循环检查，发现不够时立即返回
+    static bool AllReady (const std::vector<Charge>& charges, size_t first) {
+        for (size_t k = 0; k < charges.size(); k++) {
+            const Charge& charge = charges[(first + k) % charges.size()];
+            charge.bucket->mtx_.lock();
+            bool ready = charge.bucket->ReadyLocked(charge.n);
+            charge.bucket->mtx_.unlock();
+            if (!ready) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 桶发生变化时（在修改者的线程上，不持有桶的锁）替等待线程尝试获取，成功后唤醒一次。
+    // first是最先检查的桶：发出通知的桶刚刚变化，瓶颈通常在其他桶上
+    static void Complete (Waiter& waiter, size_t first) {
+        std::lock_guard<std::mutex> lock(waiter.mtx);
+        if (waiter.done || waiter.closed) {
+            return;
+        }
+        if (AllReady(*waiter.charges, first) && TryAcquireAll(*waiter.charges)) {
+            waiter.done = true;
+            waiter.cv.notify_one();
+        }
+    }
+};
+
+/**
+ * @brief 默认TokenManager的多桶原子获取
+ */
+using MultiAcquire = BasicMultiAcquire<TokenManager>;
@@ -0,0 +1,325 @@
+/**
+ * @file numa_bucket.h
+ * @brief 按NUMA节点分片的令牌桶
+ *
+ * 一个逻辑上的桶被拆成每个NUMA节点一个分片（TokenManager），分片的内存分配在所属节点上。
+ * 消费者优先从本节点的分片获取token，只有本地不足时才跨节点借用，
+ * 正常情况下每次获取只访问本地内存，不会跨插槽传输缓存行。
+ * 统计本地命中和跨节点借用的次数（GetStats），用于判断分片和补充方式是否合适。
+ */
+
+#pragma once
+
+#include "cache_line.h"
+#include "numa.h"
+#include "token_manager.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct NumaBucketStats
+ * @brief 分片桶的获取统计
+ */
+struct NumaBucketStats {
+    uint64_t local = 0;         // 从本节点分片获取成功的次数
+    uint64_t remote = 0;        // 本地不足、从其他节点分片借用成功的次数
+    uint64_t misses = 0;        // 所有分片都不足的非阻塞获取次数
+    double local_ratio = 0.0;   // 本地命中率 = local / (local + remote)
+};
+
+/**
+ * @class NumaShardedBucket
+ * @brief 按NUMA节点分片的令牌桶
+ *
+ * 总容量平均分给各个分片，单次获取只从一个分片扣除，因此n不能超过单个分片的容量。
+ * 补充有两种方式：
+ * - AddTokens：按需求分配，优先补给有需求的分片（阻塞等待者，以及上次补充以来非阻塞获取失败的次数），
+ *   按需求比例分配，其次是最空的分片，token流向需求所在的节点
+ * - Share(bucket, node)：每个节点一个TokenProducer（速率为总速率/节点数），补充也只写本地内存
+ * 阻塞获取在本地分片上排队，同时监视其他分片，其他节点补充的token也可以借用，
+ * 因此按第二种方式补充时各节点的速率不必与需求完全匹配（但跨节点借用会降低本地命中率）。
+ */
+class NumaShardedBucket {
+private:
+    // 一个分片，单独分配在所属节点上；统计由本节点的消费者写入，同样只写本地内存
+    struct Shard {
+        TokenManager manager;                                    // 本节点的token
+        alignas(kCacheLineSize) std::atomic<uint64_t> local{0};  // 本节点消费者的本地命中
+        std::atomic<uint64_t> remote{0};                         // 本节点消费者的跨节点借用
+        std::atomic<uint64_t> misses{0};                         // 本节点消费者的获取失败
+        std::atomic<uint64_t> unmet{0};                          // 上次AddTokens以来的获取失败（需求信号）
+
+        explicit Shard(size_t max_tokens) : manager(max_tokens) {}
+    };
+
+    static constexpr size_t kShardBytes = (sizeof(Shard) + 4095) / 4096 * 4096;  // 按页分配
+
+    std::vector<Shard*> shards_;       // 下标即节点编号
+    std::atomic<size_t> next_{0};      // AddTokens的轮转起点
+
+public:
+    /**
+     * @brief 构造函数
+     * @param max_tokens 总容量，平均分给各个分片
+     * @param nodes 分片数量，默认为系统的NUMA节点数量
+     */
+    explicit NumaShardedBucket(size_t max_tokens, int nodes = NumaNodeCount()) {
+        size_t count = static_cast<size_t>(std::max(nodes, 1));
+        for (size_t node = 0; node < count; node++) {
+            size_t share = max_tokens / count + (node < max_tokens % count ? 1 : 0);
+            void* memory = NumaAllocate(kShardBytes, static_cast<int>(node));
+            shards_.push_back(new (memory) Shard(share));  // 首次写入发生在mbind之后，页面落在所属节点上
+        }
+    }
+
+    NumaShardedBucket(const NumaShardedBucket&) = delete;
+    NumaShardedBucket& operator=(const NumaShardedBucket&) = delete;
+
+    /**
+     * @brief 析构函数
+     */
+    ~NumaShardedBucket() {
+        for (Shard* shard : shards_) {
+            shard->~Shard();
+            NumaFree(shard, kShardBytes);
+        }
+    }
+
+    /**
+     * @brief 按需求添加token
+     * @param n 要添加的数量
+     * @return 实际添加的数量（所有分片都满时少于n）
+     *
+     * 先按需求比例分给有需求的分片：需求是阻塞等待者和排队请求的数量（GetWaiters），
+     * 加上上次补充以来非阻塞获取失败的次数，因此只用TryConsumeTokens的节点也能得到token
+     * （起点轮转，需求相同时不总是偏向同一个节点）；
+     * 剩余的按空余容量从多到少补给其他分片，一个分片满了再补给下一个。
+     */
+    size_t AddTokens (size_t n) {
+        std::vector<std::pair<size_t, uint64_t>> hungry;  // (节点, 需求)
+        std::vector<std::pair<size_t, size_t>> idle;      // (空余容量, 节点)
+        uint64_t demand = 0;
+        size_t start = next_.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < shards_.size(); i++) {
+            size_t node = (start + i) % shards_.size();
+            Shard& shard = *shards_[node];
+            uint64_t want = shard.manager.GetWaiters() + shard.unmet.exchange(0, std::memory_order_relaxed);
+            if (want > 0) {
+                hungry.emplace_back(node, want);
+                demand += want;
+            } else {
+                size_t max_tokens = shard.manager.GetMaxTokens();
+                idle.emplace_back(max_tokens - std::min(shard.manager.GetTokens(), max_tokens), node);
+            }
+        }
+        std::sort(idle.begin(), idle.end(), std::greater<std::pair<size_t, size_t>>());
+        size_t added = 0;
+        for (size_t i = 0; i < hungry.size() && added < n; i++) {
+            // 按剩余需求中的比例向上取整，最后一个分片拿走剩下的全部
+            uint64_t want = hungry[i].second;
+            size_t share = static_cast<size_t>(((n - added) * static_cast<double>(want) + demand - 1) / demand);
+            demand -= want;
+            added += shards_[hungry[i].first]->manager.AddTokens(std::max<size_t>(share, 1));
+        }
+        for (size_t i = 0; i < idle.size() && added < n; i++) {
+            added += shards_[idle[i].second]->manager.AddTokens(n - added);
+        }
+        return added;
+    }
+
+    /**
+     * @brief 尝试获取n个token（非阻塞）：先本地，本地不足时借用其他节点
+     * @param n 数量（不超过单个分片的容量）
+     * @param node 消费者所在节点，小于0时自动检测
+     * @return 获取成功返回true
+     */
+    bool TryConsumeTokens (size_t n, int node = -1) {
+        Shard& local = LocalShard(node);
+        if (TryLocalOrBorrow(local, n, node)) {
+            return true;
+        }
+        local.misses.fetch_add(1, std::memory_order_relaxed);
+        local.unmet.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /**
+     * @brief 阻塞获取n个token：先本地，再借用，都不足时在本地分片上排队等待
+     * @param n 数量（不超过单个分片的容量）
+     * @param stop_flag 停止标志（可选），为true时中断等待
+     * @param node 消费者所在节点，小于0时自动检测
+     * @return 获取成功返回true，被停止信号中断或n超过分片容量返回false
+     *
+     * 在本地分片上挂一个异步请求（保持FIFO位置，并计入本地的需求），同时监视其他分片：
+     * 其他分片有变化时重新尝试借用，借用成功后撤销本地请求，因此其他节点补充的token不会被错过。
+     * 每100ms检查一次停止标志。
+     */
+    bool ConsumeTokens (size_t n, std::atomic<bool>* stop_flag = nullptr, int node = -1) {
+        Shard& local = LocalShard(node);
+        if (TryLocalOrBorrow(local, n, node)) {
+            return true;
+        }
+        auto wait = std::make_shared<BlockingWait>();
+        uint64_t id = local.manager.ConsumeTokensAsync(n, [wait] () { wait->Signal(&BlockingWait::granted); });
+        if (id == TokenManager::kRejected) {
+            return false;
+        }
+        if (id == 0) {
+            local.local.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        std::vector<std::pair<Shard*, uint64_t>> watches;
+        for (size_t i = 1; i < shards_.size(); i++) {
+            Shard* remote = shards_[(node + i) % shards_.size()];
+            watches.emplace_back(remote, remote->manager.Watch([wait] () { wait->Signal(&BlockingWait::changed); }));
+        }
+        bool acquired = WaitLocalOrBorrow(local, n, node, id, *wait, stop_flag);
+        for (auto& watch : watches) {
+            watch.first->manager.Unwatch(watch.second);
+        }
+        return acquired;
+    }
+
+    /**
+     * @brief 获取所有分片的token总数
+     */
+    size_t GetTokens () const {
+        size_t total = 0;
+        for (const Shard* shard : shards_) {
+            total += shard->manager.GetTokens();
+        }
+        return total;
+    }
+
+    /**
+     * @brief 获取分片数量
+     */
+    size_t Nodes () const { return shards_.size(); }
+
+    /**
+     * @brief 访问某个节点的分片
+     */
+    TokenManager& At (size_t node) { return shards_[node]->manager; }
+
+    /**
+     * @brief 获取指向某个节点分片的shared_ptr
+     * @param bucket 由shared_ptr管理的分片桶
+     * @param node 节点编号
+     * @return 与分片桶共享所有权的指针，可以交给该节点上的TokenProducer/TokenCustomer
+     */
+    static std::shared_ptr<TokenManager> Share (const std::shared_ptr<NumaShardedBucket>& bucket, size_t node) {
+        return std::shared_ptr<TokenManager>(bucket, &bucket->At(node));
+    }
+
+    /**
+     * @brief 获取本地命中/跨节点借用统计（所有节点的消费者合计）
+     */
+    NumaBucketStats GetStats () const {
+        NumaBucketStats stats;
+        for (const Shard* shard : shards_) {
+            stats.local += shard->local.load(std::memory_order_relaxed);
+            stats.remote += shard->remote.load(std::memory_order_relaxed);
+            stats.misses += shard->misses.load(std::memory_order_relaxed);
+        }
+        if (stats.local + stats.remote > 0) {
+            stats.local_ratio = static_cast<double>(stats.local) / (stats.local + stats.remote);
+        }
+        return stats;
+    }
+
+private:
+    // 阻塞获取的等待状态，由等待线程和本地请求、远端监视的回调共同持有
+    struct BlockingWait {
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool granted = false;   // 本地请求已满足
+        bool changed = false;   // 其他分片有变化，可以重新尝试借用
+
+        void Signal (bool BlockingWait::* flag) {
+            std::lock_guard<std::mutex> lock(mtx);
+            this->*flag = true;
+            cv.notify_one();
+        }
+    };
+
+    // 等待本地请求满足，或在其他分片变化时借用（借用成功后撤销本地请求）；返回是否获得token，统计记在本地分片上
+    bool WaitLocalOrBorrow (Shard& local, size_t n, int node, uint64_t id, BlockingWait& wait,
+                            std::atomic<bool>* stop_flag) {
+        std::unique_lock<std::mutex> lock(wait.mtx);
+        wait.changed = true;  // 监视注册之前的变化不会通知，先尝试一次
+        for (;;) {
+            if (wait.granted) {
+                local.local.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            if (stop_flag && stop_flag->load()) {
+                break;
+            }
+            if (wait.changed) {
+                wait.changed = false;
+                lock.unlock();
+                Shard* lender = TryBorrow(n, node);
+                if (lender && local.manager.CancelAsync(id)) {
+                    local.remote.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                if (lender) {
+                    lender->manager.AddTokens(n);  // 本地请求同时被满足，退还借来的token
+                }
+                lock.lock();
+                continue;
+            }
+            wait.cv.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        lock.unlock();
+        if (local.manager.CancelAsync(id)) {
+            return false;
+        }
+        // 取消时本地请求恰好已被满足：等回调执行完，按获取成功处理
+        lock.lock();
+        wait.cv.wait(lock, [&wait] () { return wait.granted; });
+        local.local.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 按节点编号依次从其他分片借用，返回借出token的分片
+    Shard* TryBorrow (size_t n, int node) {
+        for (size_t i = 1; i < shards_.size(); i++) {
+            Shard* remote = shards_[(node + i) % shards_.size()];
+            if (remote->manager.TryConsumeTokens(n)) {
+                return remote;
+            }
+        }
+        return nullptr;
+    }
+
+    Shard& LocalShard (int& node) {
+        if (node < 0) {
+            node = CurrentNumaNode();
+        }
+        node = static_cast<int>(static_cast<size_t>(node) % shards_.size());
+        return *shards_[node];
+    }
+
+    // 先从本地分片获取，不足时按节点编号依次借用，统计记在本地分片上
+    bool TryLocalOrBorrow (Shard& local, size_t n, int node) {
+        if (local.manager.TryConsumeTokens(n)) {
+            local.local.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        if (TryBorrow(n, node)) {
+            local.remote.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+};
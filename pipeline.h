@@ -0,0 +1,279 @@
+/**
+ * @file pipeline.h
+ * @brief 多级限速流水线 - 由有界队列串联、每级独立限速的处理阶段
+ *
+ * 典型场景：抓取 → 转换 → 写入，每一级有自己的速率和并发度。
+ * - 每一级有一个有界输入队列（MpmcQueue）和若干工作线程
+ * - 设置了速率的阶段拥有自己的TokenManager和TokenProducer，处理每个元素前先消费token
+ * - 下游队列满时上游工作线程阻塞在put上，上游队列随之填满，最终Submit阻塞：背压逐级向上传递
+ * - 内置每级统计：吞吐量、队列深度、token等待时间、处理耗时、被下游阻塞的时间
+ */
+
+#pragma once
+
+#include "mpmc_queue.h"
+#include "token_manager.h"
+#include "token_producer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct StageConfig
+ * @brief 流水线阶段配置
+ */
+struct StageConfig {
+    std::string name;                  // 阶段名称（用于统计输出）
+    size_t workers = 1;                // 工作线程数量
+    size_t queue_capacity = 64;        // 输入队列容量（向上取整到2的幂）
+    double rate = 0.0;                 // 每秒token数，0表示不限速
+    size_t burst = 1;                  // 桶容量（允许的突发量）
+    size_t cost = 1;                   // 处理一个元素消耗的token数
+};
+
+/**
+ * @struct StageStats
+ * @brief 流水线阶段统计快照
+ */
+struct StageStats {
+    std::string name;                             // 阶段名称
+    uint64_t processed = 0;                       // 处理并传给下游的元素数
+    uint64_t dropped = 0;                         // 被处理函数丢弃的元素数
+    size_t queue_depth = 0;                       // 输入队列当前深度
+    std::chrono::nanoseconds token_wait{0};       // 等待token的总时间
+    std::chrono::nanoseconds max_token_wait{0};   // 单次等待token的最长时间
+    std::chrono::nanoseconds busy_time{0};        // 处理函数的总耗时
+    std::chrono::nanoseconds blocked_time{0};     // 因下游队列满而阻塞的总时间（背压）
+    double throughput = 0.0;                      // 吞吐量（每秒处理元素数）
+};
+
+/**
+ * @class Pipeline
+ * @brief 多级限速流水线
+ * @tparam T 在各阶段间传递的元素类型，只需可移动
+ *
+ * 处理函数原地修改元素，返回false表示丢弃该元素（不再传给下游）。
+ */
+template <typename T>
+class Pipeline {
+public:
+    using Handler = std::function<bool(T&)>;
+
+private:
+    using Slot = std::optional<T>;  // 空值作为工作线程的终止标记
+
+    struct Stage {
+        StageConfig config;
+        Handler handler;
+        std::unique_ptr<MpmcQueue<Slot>> input;
+        std::shared_ptr<TokenManager> manager;      // 不限速时为空
+        std::unique_ptr<TokenProducer> producer;
+        std::vector<std::thread> workers;
+        std::atomic<uint64_t> processed{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<int64_t> token_wait_ns{0};
+        std::atomic<int64_t> max_token_wait_ns{0};
+        std::atomic<int64_t> busy_ns{0};
+        std::atomic<int64_t> blocked_ns{0};
+    };
+
+    std::vector<std::unique_ptr<Stage>> stages_;    // 各阶段，按处理顺序
+    std::atomic<bool> running_{false};              // 是否接受新元素
+    std::atomic<int64_t> start_ns_{0};              // start()的时间（steady_clock纳秒），GetStats可能并发读取
+    std::atomic<int64_t> stop_ns_{0};               // stop()完成的时间，运行中为0
+
+public:
+    Pipeline() = default;
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    /**
+     * @brief 析构函数
+     *
+     * 自动停止流水线（处理完已提交的元素）。
+     */
+    ~Pipeline() { stop(); }
+
+    /**
+     * @brief 追加一个阶段（必须在start()之前调用）
+     * @param config 阶段配置
+     * @param handler 处理函数
+     * @return *this，便于链式调用
+     */
+    Pipeline& AddStage (StageConfig config, Handler handler) {
+        auto stage = std::make_unique<Stage>();
+        stage->config = std::move(config);
+        stage->config.workers = std::max<size_t>(1, stage->config.workers);
+        stage->handler = std::move(handler);
+        stage->input = std::make_unique<MpmcQueue<Slot>>(stage->config.queue_capacity);
+        if (stage->config.rate > 0) {
+            ProducerConfig producer_config;
+            producer_config.rate = stage->config.rate;
+            producer_config.burst = std::max(stage->config.burst, stage->config.cost);
+            stage->manager = std::make_shared<TokenManager>(producer_config.burst);
+            stage->producer = std::make_unique<TokenProducer>(stage->manager, producer_config);
+        }
+        stages_.push_back(std::move(stage));
+        return *this;
+    }
+
+    /**
+     * @brief 启动所有阶段的生产者和工作线程
+     */
+    void start () {
+        if (stages_.empty() || running_.exchange(true)) {
+            return;
+        }
+        stop_ns_.store(0);
+        start_ns_.store(NowNs());
+        for (size_t i = 0; i < stages_.size(); i++) {
+            Stage& stage = *stages_[i];
+            if (stage.producer) {
+                stage.producer->start();
+            }
+            Stage* next = i + 1 < stages_.size() ? stages_[i + 1].get() : nullptr;
+            for (size_t w = 0; w < stage.config.workers; w++) {
+                stage.workers.emplace_back([this, &stage, next]() { RunWorker(stage, next); });
+            }
+        }
+    }
+
+    /**
+     * @brief 提交一个元素到第一个阶段
+     * @param item 元素
+     * @return 成功返回true，流水线未运行返回false
+     *
+     * 第一个阶段的队列满时阻塞（背压）。
+     */
+    bool Submit (T item) {
+        if (!running_.load()) {
+            return false;
+        }
+        stages_.front()->input->put(Slot(std::move(item)));
+        return true;
+    }
+
+    /**
+     * @brief 尝试提交一个元素（非阻塞）
+     * @param item 元素，失败时保持不变
+     * @return 成功返回true，队列满或流水线未运行返回false
+     */
+    bool TrySubmit (T& item) {
+        if (!running_.load()) {
+            return false;
+        }
+        Slot slot(std::move(item));
+        if (stages_.front()->input->try_put(std::move(slot))) {
+            return true;
+        }
+        item = std::move(*slot);
+        return false;
+    }
+
+    /**
+     * @brief 停止流水线
+     *
+     * 不再接受新元素；按阶段顺序处理完已提交的元素后停止工作线程和生产者。
+     * 调用方应先停止调用Submit。
+     */
+    void stop () {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        for (auto& stage : stages_) {
+            // 上一阶段已全部退出，终止标记一定排在所有已转发的元素之后
+            for (size_t w = 0; w < stage->workers.size(); w++) {
+                stage->input->put(Slot());
+            }
+            for (auto& worker : stage->workers) {
+                worker.join();
+            }
+            stage->workers.clear();
+            if (stage->producer) {
+                stage->producer->stop();
+            }
+        }
+        stop_ns_.store(NowNs());
+    }
+
+    /**
+     * @brief 获取各阶段的统计快照
+     */
+    std::vector<StageStats> GetStats () const {
+        int64_t start = start_ns_.load();
+        int64_t stop = stop_ns_.load();
+        int64_t end = stop != 0 ? stop : NowNs();  // 运行中或正在停止时按当前时间计算
+        double seconds = start != 0 ? (end - start) / 1e9 : 0.0;
+        std::vector<StageStats> result;
+        for (const auto& stage : stages_) {
+            StageStats stats;
+            stats.name = stage->config.name;
+            stats.processed = stage->processed.load(std::memory_order_relaxed);
+            stats.dropped = stage->dropped.load(std::memory_order_relaxed);
+            stats.queue_depth = stage->input->size();
+            stats.token_wait = std::chrono::nanoseconds(stage->token_wait_ns.load(std::memory_order_relaxed));
+            stats.max_token_wait = std::chrono::nanoseconds(stage->max_token_wait_ns.load(std::memory_order_relaxed));
+            stats.busy_time = std::chrono::nanoseconds(stage->busy_ns.load(std::memory_order_relaxed));
+            stats.blocked_time = std::chrono::nanoseconds(stage->blocked_ns.load(std::memory_order_relaxed));
+            stats.throughput = seconds > 0 ? stats.processed / seconds : 0.0;
+            result.push_back(std::move(stats));
+        }
+        return result;
+    }
+
+    /**
+     * @brief 获取阶段数量
+     */
+    size_t StageCount () const { return stages_.size(); }
+
+private:
+    static int64_t NowNs () {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static int64_t Since (std::chrono::steady_clock::time_point begin) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    // 工作线程：取元素 → 消费token → 处理 → 交给下一阶段（队列满时阻塞）
+    void RunWorker (Stage& stage, Stage* next) {
+        for (;;) {
+            Slot slot = stage.input->get();
+            if (!slot) {
+                return;  // 终止标记
+            }
+            if (stage.manager) {
+                auto begin = std::chrono::steady_clock::now();
+                stage.manager->ConsumeTokens(stage.config.cost);
+                int64_t wait = Since(begin);
+                stage.token_wait_ns.fetch_add(wait, std::memory_order_relaxed);
+                int64_t max_wait = stage.max_token_wait_ns.load(std::memory_order_relaxed);
+                while (wait > max_wait && !stage.max_token_wait_ns.compare_exchange_weak(max_wait, wait, std::memory_order_relaxed)) {
+                }
+            }
+            auto begin = std::chrono::steady_clock::now();
+            bool keep = stage.handler(*slot);
+            stage.busy_ns.fetch_add(Since(begin), std::memory_order_relaxed);
+            if (!keep) {
+                stage.dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            stage.processed.fetch_add(1, std::memory_order_relaxed);
+            if (next) {
+                begin = std::chrono::steady_clock::now();
+                next->input->put(std::move(slot));
+                stage.blocked_ns.fetch_add(Since(begin), std::memory_order_relaxed);
+            }
+        }
+    }
+};
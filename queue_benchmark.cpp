@@ -0,0 +1,90 @@
+/**
+ * @file queue_benchmark.cpp
+ * @brief 队列吞吐量基准测试
+ *
+ * 一个生产者线程、一个消费者线程，分别测量SpscQueue、MpmcQueue以及
+ * thread.cpp原来的互斥锁+条件变量队列每秒能传递多少个元素。
+ *
+ * 编译：g++ -std=c++17 -O2 -pthread queue_benchmark.cpp -o queue_benchmark
+ * 运行：./queue_benchmark [元素数量]
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include "mpmc_queue.h"
+#include "spsc_queue.h"
+
+const size_t kCapacity = 65536;  // 队列容量，足够大以减少满/空时的休眠
+
+// thread.cpp原来的实现，作为对照
+class LockedQueue {
+public:
+    explicit LockedQueue(size_t capacity) : capacity_(capacity) {}
+
+    void put (uint64_t val) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [&]() -> bool { return q_.size() < capacity_; });
+        q_.push(val);
+        cv_.notify_all();
+    }
+
+    uint64_t get () {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [&]() -> bool { return !q_.empty(); });
+        uint64_t val = q_.front();
+        q_.pop();
+        cv_.notify_all();
+        return val;
+    }
+
+private:
+    const size_t capacity_;
+    std::queue<uint64_t> q_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+};
+
+// 生产者和消费者各一个线程，传递count个元素，返回每秒元素数
+template <typename Queue>
+double Run (Queue& q, uint64_t count) {
+    uint64_t sum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    std::thread consumer([&]() {
+        for (uint64_t i = 0; i < count; i++) {
+            sum += q.get();
+        }
+    });
+    for (uint64_t i = 1; i <= count; i++) {
+        q.put(i);
+    }
+    consumer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    if (sum != count * (count + 1) / 2) {
+        std::cerr << "checksum mismatch" << std::endl;
+        std::exit(1);
+    }
+    return count / seconds;
+}
+
+template <typename Queue>
+void Report (const std::string& name, uint64_t count) {
+    Queue q(kCapacity);
+    double rate = Run(q, count);
+    std::cout << name << ": " << static_cast<uint64_t>(rate / 1e6) << " M items/s" << std::endl;
+}
+
+int main (int argc, char* argv[]) {
+    uint64_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000000;
+    std::cout << "items: " << count << std::endl;
+    Report<SpscQueue<uint64_t>>("SpscQueue  ", count);
+    Report<MpmcQueue<uint64_t>>("MpmcQueue  ", count);
+    Report<LockedQueue>("LockedQueue", count / 100);
+    return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file rate_controller.h
+ * @brief 自适应速率控制器 - 根据下游反馈和消费者积压调整补充速率
+ *
+ * 固定的补充速率要么浪费下游容量，要么把下游压垮。RateController根据两类信号调整速率：
+ * - 下游反馈：消费者每完成一次任务报告成功或失败（OnResult）
+ * - 消费者积压：TokenManager中阻塞等待token的消费者和排队的异步请求数量（GetWaiters，不含变化通知）
+ * 支持两种控制算法：
+ * - AIMD：有失败时乘性减小，无失败且有积压时加性增大（类似TCP拥塞控制）
+ * - Gradient：按成功率与目标成功率的比值平滑缩放速率，有积压时额外增加一定余量
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @struct RateControllerConfig
+ * @brief 自适应速率控制器配置
+ */
+struct RateControllerConfig {
+    enum class Mode { kAimd, kGradient };
+
+    Mode mode = Mode::kAimd;                              // 控制算法
+    double initial_rate = 2.0;                            // 初始速率（每秒token数）
+    double min_rate = 0.1;                                // 速率下限
+    double max_rate = 1e7;                                // 速率上限
+    double additive_increase = 1.0;                       // AIMD：每个调整周期增加的速率
+    double multiplicative_decrease = 0.5;                 // AIMD：出现失败时速率乘以该系数
+    double target_success = 0.99;                         // Gradient：期望的成功率
+    double smoothing = 0.2;                               // Gradient：新旧速率的平滑系数
+    double backlog_headroom = 0.5;                        // Gradient：有积压时额外增加的比例
+    std::chrono::milliseconds adjust_interval{100};       // 调整周期
+};
+
+/**
+ * @class RateController
+ * @brief 线程安全的自适应速率控制器
+ *
+ * OnResult可以被任意多个消费者线程并发调用（只做原子计数）；
+ * Adjust由驱动补充的那个线程（TokenProducer线程或RefillScheduler线程）周期性调用。
+ */
+class RateController {
+private:
+    const RateControllerConfig config_;          // 控制参数
+    std::atomic<double> rate_;                   // 当前速率
+    std::atomic<uint64_t> successes_{0};         // 本周期内的成功次数
+    std::atomic<uint64_t> failures_{0};          // 本周期内的失败次数
+    double last_adjust_ = 0.0;                   // 上次调整的时间（秒，仅Adjust线程访问）
+
+public:
+    /**
+     * @brief 构造函数
+     * @param config 控制参数
+     */
+    explicit RateController(RateControllerConfig config = RateControllerConfig())
+        : config_(config), rate_(Clamp(config.initial_rate)) {}
+
+    /**
+     * @brief 报告一次下游处理结果
+     * @param ok 下游处理成功返回true，过载/超时/拒绝等返回false
+     */
+    void OnResult (bool ok) {
+        if (ok) {
+            successes_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            failures_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief 周期性调整速率
+     * @param now 当前时间（秒，与调用方的计时起点一致）
+     * @param waiters TokenManager中正在等待token的消费者数量
+     * @return 如果本次发生了调整返回true
+     *
+     * 距离上次调整不足adjust_interval时直接返回false。比较时留出浮点误差：
+     * 调用方按周期的整数倍驱动时（例如0.3 - 0.2略小于0.1），不应推迟一整个周期。
+     */
+    bool Adjust (double now, size_t waiters) {
+        double interval = std::chrono::duration<double>(config_.adjust_interval).count();
+        if (now - last_adjust_ < interval * (1 - 1e-9)) {
+            return false;
+        }
+        last_adjust_ = now;
+        uint64_t ok = successes_.exchange(0, std::memory_order_relaxed);
+        uint64_t failed = failures_.exchange(0, std::memory_order_relaxed);
+        double rate = rate_.load(std::memory_order_relaxed);
+        double next = rate;
+        if (config_.mode == RateControllerConfig::Mode::kAimd) {
+            if (failed > 0) {
+                next = rate * config_.multiplicative_decrease;  // 下游已过载，快速后退
+            } else if (waiters > 0) {
+                next = rate + config_.additive_increase;        // 有需求且下游健康，缓慢试探
+            }
+        } else if (ok + failed > 0 || waiters > 0) {
+            double success = (ok + failed > 0) ? static_cast<double>(ok) / (ok + failed) : 1.0;
+            double gradient = std::max(0.5, std::min(1.0, success / config_.target_success));
+            double target = rate * gradient;
+            if (gradient >= 1.0 && waiters > 0) {
+                target += rate * config_.backlog_headroom;
+            }
+            next = rate * (1 - config_.smoothing) + target * config_.smoothing;
+        }
+        rate_.store(Clamp(next), std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief 获取当前速率（每秒token数）
+     */
+    double Rate () const { return rate_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 获取调整周期
+     *
+     * 驱动方的唤醒间隔不应超过该值，否则低速率时调整会被推迟。
+     */
+    std::chrono::nanoseconds AdjustInterval () const { return config_.adjust_interval; }
+
+private:
+    double Clamp (double rate) const {
+        return std::max(config_.min_rate, std::min(config_.max_rate, rate));
+    }
+};
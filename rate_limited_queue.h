@@ -0,0 +1,394 @@
+/**
+ * @file rate_limited_queue.h
+ * @brief 限速工作队列 - 只有"有任务且token足够"时才分发任务
+ *
+ * 先从队列取任务再向TokenManager申请token，会让任务在消费者手里干等token，
+ * 其他消费者也拿不到它。RateLimitedQueue把两者合成一个组件：
+ * - 每个任务带一个token成本
+ * - 队列为队首任务向TokenManager挂一个异步预约（ConsumeTokensAsync），不占用任何线程
+ * - 预约满足后队首才可被取走；消费者只在队列上等待，不会持有任务等待token
+ * - 可选：允许成本较低的任务越过仍在等待token的队首（有次数上限，避免队首饿死）。
+ *   队首的预约排在TokenManager的FIFO队列中，普通的TryConsumeTokens不会越过它，
+ *   因此越过使用TryConsumeTokensAhead，只越过本队列自己的预约；等待的消费者由token变化通知（Watch）唤醒
+ */
+
+#pragma once
+
+#include "token_manager.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/**
+ * @struct RateLimitedQueueConfig
+ * @brief 限速工作队列配置
+ */
+struct RateLimitedQueueConfig {
+    bool allow_bypass = false;                      // 允许低成本任务越过等待token的队首
+    size_t bypass_window = 16;                      // 越过时最多向后查看的任务数
+    size_t max_bypass = 8;                          // 同一个队首最多被越过的次数
+};
+
+/**
+ * @class RateLimitedQueue
+ * @brief 按token成本分发任务的有界队列
+ * @tparam T 任务类型，只需可移动
+ *
+ * 多个生产者、多个消费者均可并发使用。销毁前其他线程应已停止调用。
+ * 成本超过TokenManager最大数量的任务永远无法获得token，入队时直接拒绝；
+ * 入队后最大数量被调小（SetMaxTokens）时，为队首发出预约时已无法满足的任务被丢弃；
+ * 已经在排队的预约留在TokenManager的队列中，直到最大数量恢复（close()照常取消它）。
+ * 越过只在队首的预约位于TokenManager队列最前面时发生：TokenManager被其他调用方共享、
+ * 他们的请求排在前面时，低成本任务同样要等待，不会越过其他调用方。
+ */
+template <typename T>
+class RateLimitedQueue {
+private:
+    struct Entry {
+        T item;
+        size_t cost;
+        size_t bypassed;       // 作为队首时已被越过的次数
+    };
+
+    // token变化通知的共享状态：通知可能在Unwatch返回之后仍在进行，不能直接引用已关闭的队列
+    struct WatchState {
+        std::mutex mtx;
+        RateLimitedQueue* queue;   // 队列关闭后为空
+    };
+
+    const std::shared_ptr<TokenManager> manager_;   // token来源
+    const size_t capacity_;                         // 容量
+    const RateLimitedQueueConfig config_;           // 配置
+    std::deque<Entry> items_;                       // 排队中的任务
+    bool arming_ = false;                           // 队首的预约是否已发出但尚未满足
+    uint64_t pending_id_ = 0;                       // 预约ID（用于取消）
+    uint64_t arm_seq_ = 0;                          // 预约序号，区分前后两次预约
+    bool head_funded_ = false;                      // 队首的token是否已扣除
+    size_t funded_cost_ = 0;                        // 已为队首扣除的token数
+    bool closed_ = false;                           // 是否已关闭
+    std::mutex mtx_;                                // 保护以上成员
+    std::condition_variable not_full_;              // 队列不满
+    std::condition_variable ready_;                 // 有可分发的任务，或预约状态变化
+    std::shared_ptr<WatchState> watch_;             // 允许越过时的token变化通知
+    uint64_t watch_id_ = 0;                         // 通知ID（用于Unwatch）
+
+public:
+    /**
+     * @brief 构造函数
+     * @param manager token管理器
+     * @param capacity 队列容量（至少为1）
+     * @param config 配置
+     */
+    RateLimitedQueue(std::shared_ptr<TokenManager> manager, size_t capacity,
+                     RateLimitedQueueConfig config = RateLimitedQueueConfig())
+        : manager_(std::move(manager)), capacity_(std::max<size_t>(1, capacity)), config_(config) {
+        if (config_.allow_bypass) {
+            // token增加时唤醒等待的消费者检查能否越过队首
+            watch_ = std::make_shared<WatchState>();
+            watch_->queue = this;
+            watch_id_ = manager_->Watch([state = watch_] () {
+                std::lock_guard<std::mutex> lock(state->mtx);
+                if (state->queue) {
+                    state->queue->OnTokensChanged();
+                }
+            });
+        }
+    }
+
+    RateLimitedQueue(const RateLimitedQueue&) = delete;
+    RateLimitedQueue& operator=(const RateLimitedQueue&) = delete;
+
+    /**
+     * @brief 析构函数
+     *
+     * 关闭队列，取消未满足的预约并退还已扣除的token。
+     */
+    ~RateLimitedQueue() { close(); }
+
+    /**
+     * @brief 阻塞入队
+     * @param item 任务
+     * @param cost 分发该任务需要的token数
+     * @return 成功返回true，队列已关闭或cost永远无法满足（超过最大数量）返回false
+     */
+    bool put (T item, size_t cost) {
+        if (!manager_->Feasible(cost)) {
+            return false;
+        }
+        size_t arm_cost = 0;
+        uint64_t arm_seq = 0;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            not_full_.wait(lock, [this]() { return closed_ || items_.size() < capacity_; });
+            if (closed_) {
+                return false;
+            }
+            items_.push_back(Entry{std::move(item), cost, 0});
+            if (!PrepareArmLocked(arm_cost, arm_seq)) {
+                NotifyBypassLocked();
+                return true;
+            }
+        }
+        Arm(arm_cost, arm_seq);
+        return true;
+    }
+
+    /**
+     * @brief 尝试入队（非阻塞）
+     * @param item 任务，失败时保持不变
+     * @param cost 分发该任务需要的token数
+     * @return 成功返回true，队列满、已关闭或cost永远无法满足（超过最大数量）返回false
+     */
+    bool try_put (T&& item, size_t cost) {
+        if (!manager_->Feasible(cost)) {
+            return false;
+        }
+        size_t arm_cost = 0;
+        uint64_t arm_seq = 0;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (closed_ || items_.size() >= capacity_) {
+                return false;
+            }
+            items_.push_back(Entry{std::move(item), cost, 0});
+            if (!PrepareArmLocked(arm_cost, arm_seq)) {
+                NotifyBypassLocked();
+                return true;
+            }
+        }
+        Arm(arm_cost, arm_seq);
+        return true;
+    }
+
+    /**
+     * @brief 阻塞取出一个已获得token的任务
+     * @param out 取出的任务
+     * @return 成功返回true，队列已关闭返回false
+     */
+    bool get (T& out) {
+        size_t arm_cost = 0;
+        uint64_t arm_seq = 0;
+        bool arm;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            while (!TakeLocked(out)) {
+                if (closed_) {
+                    return false;
+                }
+                ready_.wait(lock);  // 队首获得token、token增加（允许越过时）或有新任务时被唤醒
+            }
+            arm = PrepareArmLocked(arm_cost, arm_seq);
+        }
+        if (arm) {
+            Arm(arm_cost, arm_seq);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 尝试取出一个已获得token的任务（非阻塞）
+     * @param out 取出的任务
+     * @return 成功返回true，没有可分发的任务返回false
+     */
+    bool try_get (T& out) {
+        size_t arm_cost = 0;
+        uint64_t arm_seq = 0;
+        bool arm;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (!TakeLocked(out)) {
+                return false;
+            }
+            arm = PrepareArmLocked(arm_cost, arm_seq);
+        }
+        if (arm) {
+            Arm(arm_cost, arm_seq);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 关闭队列
+     *
+     * 唤醒所有阻塞的put/get（返回false），丢弃排队中的任务，
+     * 取消队首的预约；已为队首扣除的token退还给TokenManager。
+     */
+    void close () {
+        size_t refund = 0;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (closed_) {
+                return;
+            }
+            closed_ = true;
+            if (head_funded_) {
+                refund = funded_cost_;
+                head_funded_ = false;
+                funded_cost_ = 0;
+            }
+            items_.clear();
+        }
+        not_full_.notify_all();
+        ready_.notify_all();
+        if (watch_) {
+            manager_->Unwatch(watch_id_);
+            std::lock_guard<std::mutex> lock(watch_->mtx);
+            watch_->queue = nullptr;  // 等待正在进行的通知结束，之后的通知不再访问this
+        }
+        if (refund > 0) {
+            manager_->AddTokens(refund);
+        }
+        CancelPending();
+        // 等待预约回调结束，之后它不会再访问this
+        std::unique_lock<std::mutex> lock(mtx_);
+        ready_.wait(lock, [this]() { return !arming_; });
+    }
+
+    /**
+     * @brief 获取排队中的任务数量
+     */
+    size_t size () {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return items_.size();
+    }
+
+    /**
+     * @brief 获取容量
+     */
+    size_t capacity () const { return capacity_; }
+
+private:
+    // 取出可分发的任务：已获得token的队首，或（允许时）越过队首的预约、当前token足够的低成本任务
+    bool TakeLocked (T& out) {
+        if (head_funded_) {
+            out = std::move(items_.front().item);
+            items_.pop_front();
+            head_funded_ = false;
+            funded_cost_ = 0;
+            not_full_.notify_one();
+            return true;
+        }
+        if (!config_.allow_bypass || pending_id_ == 0 || items_.size() < 2 ||
+            items_.front().bypassed >= config_.max_bypass) {
+            return false;
+        }
+        size_t head_cost = items_.front().cost;
+        size_t end = std::min(items_.size(), config_.bypass_window + 1);
+        for (size_t i = 1; i < end; i++) {
+            if (items_[i].cost < head_cost && manager_->TryConsumeTokensAhead(items_[i].cost, pending_id_)) {
+                out = std::move(items_[i].item);
+                items_.erase(items_.begin() + i);
+                items_.front().bypassed++;
+                not_full_.notify_one();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 队首存在且尚无预约时，标记为预约中并返回其成本，由调用方在锁外发出预约
+    bool PrepareArmLocked (size_t& cost, uint64_t& seq) {
+        if (closed_ || items_.empty() || head_funded_ || arming_) {
+            return false;
+        }
+        arming_ = true;
+        cost = items_.front().cost;
+        seq = ++arm_seq_;
+        return true;
+    }
+
+    // 为队首发出异步预约。token足够时回调会在ConsumeTokensAsync内立即执行，因此不能持锁调用
+    void Arm (size_t cost, uint64_t seq) {
+        for (;;) {
+            uint64_t id = manager_->ConsumeTokensAsync(cost, [this, cost]() { OnFunded(cost); });
+            if (id == 0) {
+                return;
+            }
+            bool cancel;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if (id == TokenManager::kRejected) {
+                    // 队首的成本已超过最大数量，永远无法分发：丢弃它，为新的队首预约
+                    arming_ = false;
+                    if (!closed_) {
+                        items_.pop_front();
+                        not_full_.notify_one();
+                    }
+                    ready_.notify_all();  // 唤醒等待预约结束的close()
+                    if (!PrepareArmLocked(cost, seq)) {
+                        return;
+                    }
+                    continue;
+                }
+                if (!arming_ || arm_seq_ != seq) {
+                    return;  // 回调已经在其他线程执行完（之后可能已开始下一次预约）
+                }
+                pending_id_ = id;
+                cancel = closed_;
+                NotifyBypassLocked();  // 有了预约ID才能越过队首
+            }
+            if (cancel) {
+                CancelPending();  // 发出预约期间队列被关闭
+            }
+            return;
+        }
+    }
+
+    // 预约满足（在添加token的线程上执行）
+    void OnFunded (size_t cost) {
+        std::shared_ptr<TokenManager> manager = manager_;
+        bool refund;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            arming_ = false;
+            pending_id_ = 0;
+            refund = closed_;
+            if (refund) {
+                ready_.notify_all();  // 唤醒等待回调结束的close()
+            } else {
+                head_funded_ = true;
+                funded_cost_ = cost;
+                ready_.notify_one();
+            }
+        }
+        if (refund) {
+            manager->AddTokens(cost);
+        }
+    }
+
+    // token变化（在修改者的线程上，不持有TokenManager的锁）：唤醒等待的消费者检查能否越过队首
+    void OnTokensChanged () {
+        std::lock_guard<std::mutex> lock(mtx_);
+        NotifyBypassLocked();
+    }
+
+    // 允许越过且队首仍在等待token时，唤醒等待的消费者（调用时已持有mtx_）
+    void NotifyBypassLocked () {
+        if (config_.allow_bypass && pending_id_ != 0 && items_.size() >= 2) {
+            ready_.notify_all();
+        }
+    }
+
+    // 取消尚未满足的预约；取消失败说明回调正在执行，由回调负责收尾
+    void CancelPending () {
+        uint64_t id;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            id = pending_id_;
+        }
+        if (id == 0 || !manager_->CancelAsync(id)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (pending_id_ == id) {
+            pending_id_ = 0;
+            arming_ = false;
+            ready_.notify_all();
+        }
+    }
+};
@@ -0,0 +1,133 @@
+/**
+ * @file refill_pacer.h
+ * @brief 补充节拍计算 - 按绝对时间计算应补充的token数量
+ *
+ * RefillPacer不关心线程和睡眠，只回答"从起点到现在一共应该产生多少token、这次该补多少"。
+ * 由于按起点的绝对时间累计计算，调度延迟和加锁耗时不会造成速率漂移：
+ * 晚醒来的一次会把错过的节拍一并补上（受burst限制）。
+ * TokenProducer的独立线程模式和RefillScheduler都使用它。
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class RefillPacer
+ * @brief 按速率和突发量计算补充数量
+ *
+ * 时间用相对起点的秒数（double）表示。起点时刻立即产生1个token，
+ * 与原先"启动后先生产一个token再睡眠"的行为保持一致。
+ * 速率截断到[kMinRate, kMaxRate]：0、负数和NaN按kMinRate，无穷大按kMaxRate，
+ * 因此TokenProducer、RefillTimerFd、BucketSimulator等使用者不会因为无效的速率得到无意义的间隔。
+ * 非线程安全，由持有者在单线程中使用。
+ */
+class RefillPacer {
+public:
+    static constexpr double kMinRate = 1e-6;     // 速率下限（约11.6天一个token）
+    static constexpr double kMaxRate = 1e9;      // 速率上限（每纳秒一个token，累计数量数百年内不溢出）
+
+private:
+    static constexpr int kCatchUpIntervals = 4;  // burst至少容纳的唤醒间隔数
+
+    double rate_;           // 每秒产生的token数量
+    size_t burst_;          // 单次补充的最大token数量
+    double base_ = 1.0;     // origin_时刻已累计的token数量（含小数部分）
+    double origin_ = 0.0;   // 当前速率生效的时间点（秒）
+    uint64_t credited_ = 0; // 已经结算过的token数量
+
+public:
+    /**
+     * @brief 构造函数
+     * @param rate 每秒产生的token数量，截断到[kMinRate, kMaxRate]
+     * @param burst 单次补充的最大token数量（至少为1）
+     */
+    RefillPacer(double rate, size_t burst) : rate_(ClampRate(rate)), burst_(std::max<size_t>(burst, 1)) {}
+
+    /**
+     * @brief 把速率截断到[kMinRate, kMaxRate]，不是有限正数时按kMinRate（无穷大按kMaxRate）
+     */
+    static double ClampRate (double rate) {
+        if (!(rate >= kMinRate)) {
+            return kMinRate;  // 包括0、负数和NaN
+        }
+        return std::min(rate, kMaxRate);
+    }
+
+    /**
+     * @brief 结算到指定时间为止应补充的token数量
+     * @param elapsed 相对起点的秒数
+     * @return 本次应补充的数量，最多burst个
+     *
+     * 如果欠下的token超过burst（例如线程被长时间挂起），多出的部分直接丢弃，
+     * 避免恢复后瞬间涌入大量token。elapsed早于速率起点时不补充。
+     */
+    size_t Due (double elapsed) {
+        double accrued = std::floor(base_ + (elapsed - origin_) * rate_);
+        if (!(accrued > static_cast<double>(credited_))) {
+            return 0;  // 也避免把负数转换为uint64_t
+        }
+        uint64_t total = static_cast<uint64_t>(accrued);
+        if (total <= credited_) {
+            return 0;
+        }
+        uint64_t due = total - credited_;
+        credited_ = total;
+        return static_cast<size_t>(std::min<uint64_t>(due, burst_));
+    }
+
+    /**
+     * @brief 修改速率，从elapsed时刻开始按新速率累计
+     * @param rate 新的速率（每秒token数），截断到[kMinRate, kMaxRate]
+     * @param elapsed 修改发生的时间（相对起点的秒数），不应早于上一次修改的时间
+     */
+    void SetRate (double rate, double elapsed) {
+        base_ += (elapsed - origin_) * rate_;
+        origin_ = elapsed;
+        rate_ = ClampRate(rate);
+    }
+
+    /**
+     * @brief 修改单次补充上限
+     */
+    void SetBurst (size_t burst) { burst_ = std::max<size_t>(burst, 1); }
+
+    /**
+     * @brief 计算唤醒间隔
+     * @param min_interval 最短唤醒间隔
+     * @return 每产生一个token的时间与min_interval中的较大者
+     *
+     * 速率很高时（例如每秒上百万个token）不可能每个token唤醒一次，
+     * 此时按min_interval唤醒，每次补充这段时间内累计的多个token。
+     */
+    std::chrono::nanoseconds Interval (std::chrono::nanoseconds min_interval) const {
+        double ns = 1e9 / rate_;
+        constexpr auto kMax = std::chrono::nanoseconds::max();
+        std::chrono::nanoseconds per_token = ns >= static_cast<double>(kMax.count())
+            ? kMax : std::chrono::nanoseconds(static_cast<int64_t>(ns));
+        return std::max(per_token, min_interval);
+    }
+
+    /**
+     * @brief 确保正常节拍和少量晚醒累计的token不会被burst截断
+     * @param interval 唤醒间隔
+     *
+     * burst小于一个间隔内产生的token数时，正常节拍也会被截断，实际速率会低于配置。
+     * 这里把burst至少放大到kCatchUpIntervals个间隔的产量，偶尔晚醒几个节拍也能完整补上。
+     * 注意这会修改调用方配置的burst（只增不减），之后可以用Burst()查询实际值；
+     * 需要更小的单次补充量时应缩短唤醒间隔，而不是依赖burst截断。
+     */
+    void FitBurst (std::chrono::nanoseconds interval) {
+        double per_wakeup = std::ceil(rate_ * interval.count() / 1e9 * kCatchUpIntervals);
+        if (per_wakeup > static_cast<double>(burst_)) {
+            burst_ = static_cast<size_t>(per_wakeup);
+        }
+    }
+
+    double Rate () const { return rate_; }
+    size_t Burst () const { return burst_; }
+};
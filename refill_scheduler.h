@@ -0,0 +1,317 @@
+/**
+ * @file refill_scheduler.h
+ * @brief 共享的Token补充调度器 - 单线程驱动任意数量的生产者
+ *
+ * 每个TokenProducer各占一个线程时，1000个桶就意味着1000个大部分时间在睡眠的线程。
+ * RefillScheduler用一个线程加一个分层时间轮（TimerWheel）来驱动所有注册的补充任务：
+ * - 每个补充任务有独立的速率和突发量，可选地由RateController自适应调整
+ * - 注册和取消都是O(1)
+ * - 同一次推进中到期的、指向同一个TokenManager的补充会合并成一次AddTokens调用
+ * - AddTokens在释放调度器的锁之后调用：它会在调度线程上运行异步请求和变化通知的回调，
+ *   回调中可以再调用Register/Cancel/SetRate（例如TokenProducer::SetRate或生产者析构）
+ */
+
+#pragma once
+
+#include "rate_controller.h"
+#include "refill_pacer.h"
+#include "timer_wheel.h"
+#include "token_manager.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @class RefillScheduler
+ * @brief 基于时间轮的Token补充调度器
+ *
+ * 调度线程休眠到时间轮中最近的到期tick，醒来后推进时间轮并批量补充token。
+ * 周期任务按绝对tick重新排期，不会因为调度延迟而累积漂移。
+ */
+class RefillScheduler {
+public:
+    using RefillId = TimerWheel<int>::TimerId;  // 补充任务ID，0表示无效
+
+private:
+    // 一个补充任务
+    struct Refill {
+        std::shared_ptr<TokenManager> manager;  // 被补充的TokenManager
+        RefillPacer pacer{1.0, 1};              // 按绝对时间计算每次应补充的数量
+        std::shared_ptr<RateController> controller;  // 自适应速率控制器（可为空）
+        uint64_t period = 0;                    // 唤醒周期（tick）
+        uint64_t start_tick = 0;                // 注册时的tick
+        uint64_t generation = 0;                // 每次SetRate加1，用于识别过期的自适应调整
+    };
+
+    // 本轮到期、需要在锁外查询积压并调整速率的自适应任务
+    struct Adjustment {
+        RefillId id;
+        std::shared_ptr<TokenManager> manager;
+        std::shared_ptr<RateController> controller;
+        uint64_t fired_tick;
+        double elapsed;
+        uint64_t generation;   // 收集时任务的generation
+        size_t waiters = 0;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::duration tick_;                           // 一个tick的时长
+    const Clock::time_point epoch_;                        // tick 0对应的时间点
+    TimerWheel<Refill> wheel_;                             // 时间轮
+    std::vector<std::pair<std::shared_ptr<TokenManager>, size_t>> batch_;  // 本轮待合并的补充（只由调度线程访问）
+    std::vector<Adjustment> adjust_;                       // 本轮待调整的自适应任务（只由调度线程访问）
+    std::thread sched_thread_;                             // 调度线程
+    std::atomic<bool> running_{false};                     // 运行标志
+    mutable std::mutex mtx_;                               // 保护时间轮和dispatching_
+    std::condition_variable cond_;                         // 有新任务或需要停止时唤醒调度线程
+    bool dispatching_ = false;                             // 调度线程正在锁外补充
+    std::thread::id dispatcher_;                           // 正在锁外补充的线程
+    std::condition_variable dispatched_;                   // 锁外补充结束时通知Cancel
+
+public:
+    /**
+     * @brief 构造函数
+     * @param tick 时间轮的精度，默认1ms
+     *
+     * 创建调度器，但不会自动启动线程。需要调用start()方法来启动调度线程。
+     */
+    explicit RefillScheduler(std::chrono::microseconds tick = std::chrono::milliseconds(1))
+        : tick_(std::chrono::duration_cast<Clock::duration>(tick)), epoch_(Clock::now()) {}
+
+    /**
+     * @brief 析构函数
+     *
+     * 自动停止调度线程。
+     */
+    ~RefillScheduler() { stop(); }
+
+    /**
+     * @brief 注册一个按速率补充的任务
+     * @param manager 被补充的TokenManager
+     * @param rate 每秒补充的token数量，必须大于0
+     * @param burst 单次补充的最大数量（追赶错过节拍的上限）
+     * @param controller 自适应速率控制器，为空时速率固定
+     * @return 补充任务ID，可用于Cancel；rate不是有限的正数时不注册，返回0
+     *
+     * 唤醒周期为每个token的时间向上取整到tick（至少1个tick）；速率高于每tick一个时，
+     * 每次唤醒补充这个tick内累计的多个token。
+     * 第一次补充立即进行（与TokenProducer线程启动后立即生产一个token的行为一致）。
+     */
+    RefillId Register (std::shared_ptr<TokenManager> manager, double rate, size_t burst = 1,
+                       std::shared_ptr<RateController> controller = nullptr) {
+        if (!ValidRate(rate)) {
+            return TimerWheel<Refill>::kInvalidTimer;
+        }
+        Refill refill;
+        refill.manager = std::move(manager);
+        refill.pacer = RefillPacer(rate, burst);
+        refill.controller = std::move(controller);
+        FitPeriod(refill);
+        RefillId id;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            refill.start_tick = NowTick();
+            id = wheel_.Schedule(refill.start_tick, std::move(refill));
+        }
+        cond_.notify_one();  // 新任务可能比调度线程当前等待的时间点更早
+        return id;
+    }
+
+    /**
+     * @brief 注册一个固定周期补充的任务
+     * @param manager 被补充的TokenManager
+     * @param interval 补充周期，必须大于0
+     * @param tokens 每个周期补充的token数量，必须大于0
+     * @return 补充任务ID，可用于Cancel；interval或tokens为0时不注册，返回0
+     */
+    RefillId Register (std::shared_ptr<TokenManager> manager,
+                       std::chrono::nanoseconds interval,
+                       size_t tokens = 1) {
+        if (interval.count() <= 0 || tokens == 0) {
+            return TimerWheel<Refill>::kInvalidTimer;
+        }
+        double rate = tokens / std::chrono::duration<double>(interval).count();
+        return Register(std::move(manager), rate, tokens);
+    }
+
+    /**
+     * @brief 取消一个补充任务
+     * @param id Register返回的任务ID
+     * @return 如果任务存在并被取消返回true
+     *
+     * 返回后该任务不会再补充任何token：调度线程正在锁外补充时等待这一轮结束
+     * （在调度线程上调用时，例如在token回调中，不等待）。
+     */
+    bool Cancel (RefillId id) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        bool cancelled = wheel_.Cancel(id);
+        if (cancelled && dispatcher_ != std::this_thread::get_id()) {
+            dispatched_.wait(lock, [this] () { return !dispatching_; });
+        }
+        return cancelled;
+    }
+
+    /**
+     * @brief 修改一个补充任务的速率
+     * @param id Register返回的任务ID
+     * @param rate 新的速率（每秒token数，必须大于0）
+     * @return 如果任务存在且rate有效返回true
+     *
+     * 从调用时刻起按新速率累计，已累计的部分不受影响；下一次补充按新周期重新排期。
+     * O(1)，可以高频地批量推送到大量任务。挂接了RateController的任务，下一次调整会以控制器的速率为准。
+     */
+    bool SetRate (RefillId id, double rate) {
+        if (!ValidRate(rate)) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            Refill* refill = wheel_.Get(id);
+            if (!refill) {
+                return false;
+            }
+            uint64_t now = NowTick();
+            double elapsed = std::chrono::duration<double>(tick_ * static_cast<Clock::rep>(now - refill->start_tick)).count();
+            refill->pacer.SetRate(rate, elapsed);
+            refill->generation++;
+            FitPeriod(*refill);
+            wheel_.Reschedule(id, now + refill->period);
+        }
+        cond_.notify_one();  // 新的到期时间可能比调度线程当前等待的时间点更早
+        return true;
+    }
+
+    /**
+     * @brief 获取已注册的补充任务数量
+     */
+    size_t Size () const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return wheel_.Size();
+    }
+
+    /**
+     * @brief 启动调度线程
+     */
+    void start () {
+        running_ = true;
+        sched_thread_ = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(mtx_);
+            while (running_.load()) {
+                uint64_t next = wheel_.NextExpiry();
+                if (next == std::numeric_limits<uint64_t>::max()) {
+                    // 没有任务，等待注册或停止
+                    cond_.wait(lock);
+                    continue;
+                }
+                if (next > NowTick()) {
+                    cond_.wait_until(lock, epoch_ + tick_ * static_cast<Clock::rep>(next));
+                    continue;  // 重新计算，可能有更早的新任务
+                }
+                RunDue(lock, NowTick());
+            }
+        });
+    }
+
+    /**
+     * @brief 停止调度线程
+     *
+     * 已注册的任务保留，再次start()后继续调度。
+     */
+    void stop () {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            running_ = false;
+        }
+        cond_.notify_all();
+        if (sched_thread_.joinable()) {
+            sched_thread_.join();
+        }
+    }
+
+private:
+    static bool ValidRate (double rate) {
+        return rate > 0 && std::isfinite(rate);
+    }
+
+    uint64_t NowTick () const {
+        return static_cast<uint64_t>((Clock::now() - epoch_) / tick_);
+    }
+
+    // 根据速率计算唤醒周期：每个token的时间向上取整到tick，至少1个tick；
+    // 自适应任务的周期不超过控制器的调整周期
+    void FitPeriod (Refill& refill) const {
+        auto interval = refill.pacer.Interval(std::chrono::duration_cast<std::chrono::nanoseconds>(tick_));
+        if (refill.controller) {
+            interval = std::min(interval, refill.controller->AdjustInterval());
+        }
+        refill.period = std::max<uint64_t>(1, (interval + tick_ - Clock::duration(1)) / tick_);
+        refill.pacer.FitBurst(tick_ * static_cast<Clock::rep>(refill.period));
+    }
+
+    // 推进时间轮并批量补充：到期的任务在锁内收集，查询积压和AddTokens在锁外进行
+    void RunDue (std::unique_lock<std::mutex>& lock, uint64_t now_tick) {
+        wheel_.Advance(now_tick, [this](RefillId id, Refill& refill, uint64_t fired_tick) -> uint64_t {
+            double elapsed = std::chrono::duration<double>(tick_ * static_cast<Clock::rep>(fired_tick - refill.start_tick)).count();
+            size_t due = refill.pacer.Due(elapsed);
+            if (due > 0) {
+                batch_.emplace_back(refill.manager, due);
+            }
+            if (refill.controller) {
+                adjust_.push_back(Adjustment{id, refill.manager, refill.controller, fired_tick, elapsed,
+                                             refill.generation});
+            }
+            return fired_tick + refill.period;  // 按绝对tick排期，避免漂移
+        });
+        if (batch_.empty() && adjust_.empty()) {
+            return;
+        }
+        dispatching_ = true;
+        dispatcher_ = std::this_thread::get_id();
+        lock.unlock();
+        // 积压按补充之前的等待者数量计算
+        for (Adjustment& adjustment : adjust_) {
+            adjustment.waiters = adjustment.manager->GetWaiters();
+        }
+        // 同一个TokenManager的补充合并为一次AddTokens：一次加锁、一次唤醒
+        std::sort(batch_.begin(), batch_.end(), [] (const auto& a, const auto& b) {
+            return a.first.get() < b.first.get();
+        });
+        for (size_t i = 0; i < batch_.size();) {
+            TokenManager* manager = batch_[i].first.get();
+            size_t tokens = 0;
+            for (; i < batch_.size() && batch_[i].first.get() == manager; i++) {
+                tokens += batch_[i].second;
+            }
+            manager->AddTokens(tokens);
+        }
+        batch_.clear();
+        lock.lock();
+        dispatching_ = false;
+        dispatched_.notify_all();
+        // 锁外期间任务可能已被取消或被SetRate修改（例如在token回调中），按ID重新查找；
+        // 被SetRate修改过的任务跳过本轮调整，避免用过期的快照覆盖新速率。
+        // 新速率从当前时刻生效：SetRate已经把速率起点推进到锁外期间的某个时刻，不能再退回fired_tick
+        uint64_t now = NowTick();
+        for (Adjustment& adjustment : adjust_) {
+            Refill* refill = wheel_.Get(adjustment.id);
+            if (refill && refill->controller == adjustment.controller &&
+                refill->generation == adjustment.generation &&
+                adjustment.controller->Adjust(adjustment.elapsed, adjustment.waiters)) {
+                double elapsed = std::chrono::duration<double>(tick_ * static_cast<Clock::rep>(now - refill->start_tick)).count();
+                refill->pacer.SetRate(adjustment.controller->Rate(), elapsed);
+                FitPeriod(*refill);
+                wheel_.Reschedule(adjustment.id, now + refill->period);
+            }
+        }
+        adjust_.clear();
+    }
+};
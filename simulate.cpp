@@ -0,0 +1,133 @@
+/**
+ * @file simulate.cpp
+ * @brief 令牌桶容量规划工具
+ *
+ * 用BucketSimulator在虚拟时间中模拟一组桶配置，输出吞吐量、拒绝率、延迟分位数和利用率曲线。
+ *
+ * 编译：g++ -std=c++17 -O2 -pthread simulate.cpp -o simulate
+ * 运行：./simulate [选项]
+ *   --max-tokens N      桶的最大token数量（默认10，逗号分隔多个值时逐个扫描，例如 5,10,20）
+ *   --rate R            补充速率，每秒token数（默认100）
+ *   --arrivals R        泊松到达速率，每秒请求数（默认90）
+ *   --cost N            每个请求需要的token数量（默认1）
+ *   --workers N         处理请求的工作者数量（默认0，不模拟处理）
+ *   --service-ms T      平均处理时间（毫秒，指数分布）
+ *   --max-waiting N     等待token的请求上限，0表示只尝试不等待（默认不限）
+ *   --timeout-ms T      等待token的超时时间（毫秒，默认不超时）
+ *   --seconds S         模拟时长（默认3600）
+ *   --trace FILE        按轨迹文件重放到达（每行"时间(秒) [token数量]"），代替泊松到达
+ *   --curve             输出每个采样间隔的利用率曲线
+ */
+
+#include "bucket_simulator.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// 把延迟格式化为毫秒
+static double Ms (std::chrono::nanoseconds d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+int main (int argc, char* argv[]) {
+    SimulationConfig config;
+    config.producer.rate = 100;
+    config.duration = std::chrono::seconds(3600);
+    std::vector<size_t> max_tokens_list{10};
+    double arrival_rate = 90;
+    size_t cost = 1;
+    std::string trace_file;
+    bool print_curve = false;
+
+    for (int i = 1; i < argc; i++) {
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                std::cerr << "missing value for " << argv[i] << std::endl;
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (std::strcmp(argv[i], "--max-tokens") == 0) {
+            max_tokens_list.clear();
+            std::stringstream list(value());
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                max_tokens_list.push_back(std::strtoul(item.c_str(), nullptr, 10));
+            }
+        } else if (std::strcmp(argv[i], "--rate") == 0) {
+            config.producer.rate = std::strtod(value(), nullptr);
+        } else if (std::strcmp(argv[i], "--arrivals") == 0) {
+            arrival_rate = std::strtod(value(), nullptr);
+        } else if (std::strcmp(argv[i], "--cost") == 0) {
+            cost = std::strtoul(value(), nullptr, 10);
+        } else if (std::strcmp(argv[i], "--workers") == 0) {
+            config.workers = std::strtoul(value(), nullptr, 10);
+        } else if (std::strcmp(argv[i], "--service-ms") == 0) {
+            config.service_time = std::chrono::microseconds(static_cast<int64_t>(std::strtod(value(), nullptr) * 1000));
+            config.exponential_service = true;
+        } else if (std::strcmp(argv[i], "--max-waiting") == 0) {
+            config.max_waiting = std::strtoul(value(), nullptr, 10);
+        } else if (std::strcmp(argv[i], "--timeout-ms") == 0) {
+            config.timeout = std::chrono::microseconds(static_cast<int64_t>(std::strtod(value(), nullptr) * 1000));
+        } else if (std::strcmp(argv[i], "--seconds") == 0) {
+            config.duration = std::chrono::seconds(std::strtol(value(), nullptr, 10));
+        } else if (std::strcmp(argv[i], "--trace") == 0) {
+            trace_file = value();
+        } else if (std::strcmp(argv[i], "--curve") == 0) {
+            print_curve = true;
+        } else {
+            std::cerr << "unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Arrival> trace;
+    if (!trace_file.empty()) {
+        std::ifstream in(trace_file);
+        if (!in) {
+            std::cerr << "cannot open trace: " << trace_file << std::endl;
+            return 1;
+        }
+        trace = LoadTrace(in);
+        std::cout << "trace: " << trace.size() << " arrivals" << std::endl;
+    }
+
+    std::cout << "rate " << config.producer.rate << " tokens/s, "
+              << (trace_file.empty() ? "poisson " + std::to_string(arrival_rate) + " req/s" : trace_file)
+              << ", cost " << cost << ", workers " << config.workers
+              << ", simulated " << std::chrono::duration<double>(config.duration).count() << " s" << std::endl;
+    std::cout << "max_tokens  throughput  reject%   wait p50/p99/p999 (ms)        latency p99 (ms)  util%   events/s" << std::endl;
+
+    for (size_t max_tokens : max_tokens_list) {
+        config.max_tokens = max_tokens;
+        ArrivalProcess arrivals = trace_file.empty() ? PoissonArrivals(arrival_rate, cost, config.seed)
+                                                     : TraceArrivals(trace);
+        BucketSimulator simulator(config, std::move(arrivals));
+        auto begin = std::chrono::steady_clock::now();
+        SimulationResult result = simulator.Run();
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        std::cout << max_tokens << "\t    " << result.throughput
+                  << "\t" << result.rejection_rate * 100
+                  << "\t  " << Ms(result.token_wait.p50) << " / " << Ms(result.token_wait.p99)
+                  << " / " << Ms(result.token_wait.p999)
+                  << "\t" << Ms(result.latency.p99)
+                  << "\t  " << result.worker_utilization * 100
+                  << "\t" << static_cast<uint64_t>(result.events / wall) << std::endl;
+
+        if (print_curve) {
+            std::cout << "  time(s)  tokens  waiting  backlog  util%  throughput  rejections/s" << std::endl;
+            for (const SimulationSample& sample : result.curve) {
+                std::cout << "  " << sample.time << "\t" << sample.tokens << "\t" << sample.waiting
+                          << "\t" << sample.backlog << "\t" << sample.worker_utilization * 100
+                          << "\t" << sample.throughput << "\t" << sample.rejections << std::endl;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,212 @@
+/**
+ * @file spsc_queue.h
+ * @brief 单生产者单消费者无锁环形队列
+ *
+ * 只有一个生产者线程和一个消费者线程时，不需要CAS：
+ * - 尾位置只由生产者写，头位置只由消费者写，各自用一次release store发布
+ * - 生产者缓存上次读到的头位置，消费者缓存上次读到的尾位置，
+ *   只有缓存值显示队列满（或空）时才去读对方的缓存行
+ * - 快速路径上没有原子读-改-写（对方休眠时才有一次exchange）；每次入队/出队后有一次全序栅栏，
+ *   与休眠方"先登记再检查队列"配对，唤醒不会丢失，休眠不需要超时
+ * 接口与MpmcQueue一致（try_put/try_get/put/get），可以直接替换。
+ */
+
+#pragma once
+
+#include "cache_line.h"
+#include "cpu_relax.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+/**
+ * @class SpscQueue
+ * @brief 无锁有界SPSC环形队列
+ * @tparam T 元素类型
+ *
+ * put/try_put只能由同一个线程调用，get/try_get只能由另一个固定线程调用。
+ */
+template <typename T>
+class SpscQueue {
+private:
+    struct Storage {
+        alignas(T) unsigned char bytes[sizeof(T)];
+
+        T* Item () { return reinterpret_cast<T*>(bytes); }
+    };
+
+    static constexpr int kSpinCount = 256;                  // 休眠前的自旋次数
+
+    const size_t mask_;                                     // 容量-1（容量为2的幂）
+    std::unique_ptr<Storage[]> items_;                      // 元素数组
+
+    // 消费者独占的缓存行
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0};  // 下一个出队位置
+    size_t tail_cache_ = 0;                                 // 消费者缓存的尾位置
+
+    // 生产者独占的缓存行
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0};  // 下一个入队位置
+    size_t head_cache_ = 0;                                 // 生产者缓存的头位置
+
+    // 休眠相关，只在队列满/空时使用
+    alignas(kCacheLineSize) std::atomic<bool> producer_parked_{false};
+    std::atomic<bool> consumer_parked_{false};
+    std::mutex mtx_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+
+public:
+    /**
+     * @brief 构造函数
+     * @param capacity 容量，向上取整到2的幂（至少为2）
+     */
+    explicit SpscQueue(size_t capacity) : mask_(RoundUp(capacity) - 1), items_(new Storage[mask_ + 1]) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * @brief 析构函数，销毁队列中剩余的元素
+     */
+    ~SpscQueue() {
+        size_t end = tail_.load(std::memory_order_relaxed);
+        for (size_t pos = head_.load(std::memory_order_relaxed); pos != end; pos++) {
+            items_[pos & mask_].Item()->~T();
+        }
+    }
+
+    /**
+     * @brief 尝试入队（非阻塞，仅生产者线程）
+     * @param val 要入队的元素
+     * @return 成功返回true，队列满返回false
+     */
+    bool try_put (const T& val) { return Enqueue(val); }
+    bool try_put (T&& val) { return Enqueue(std::move(val)); }
+
+    /**
+     * @brief 尝试出队（非阻塞，仅消费者线程）
+     * @param out 出队的元素
+     * @return 成功返回true，队列空返回false
+     */
+    bool try_get (T& out) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return false;
+            }
+        }
+        T* item = items_[head & mask_].Item();
+        out = std::move(*item);
+        item->~T();
+        head_.store(head + 1, std::memory_order_release);
+        Wake(producer_parked_, not_full_);
+        return true;
+    }
+
+    /**
+     * @brief 阻塞入队（仅生产者线程）
+     * @param val 要入队的元素
+     */
+    void put (T val) {
+        for (int spins = 0; !Enqueue(std::move(val));) {
+            if (spins < kSpinCount) {
+                spins++;
+                CpuRelax();
+            } else {
+                Park(producer_parked_, not_full_, [this]() { return !Full(); });
+            }
+        }
+    }
+
+    /**
+     * @brief 阻塞出队（仅消费者线程）
+     * @return 出队的元素
+     */
+    T get () {
+        T val;
+        for (int spins = 0; !try_get(val);) {
+            if (spins < kSpinCount) {
+                spins++;
+                CpuRelax();
+            } else {
+                Park(consumer_parked_, not_empty_, [this]() { return !Empty(); });
+            }
+        }
+        return val;
+    }
+
+    /**
+     * @brief 获取容量
+     */
+    size_t capacity () const { return mask_ + 1; }
+
+    /**
+     * @brief 获取当前元素数量（并发修改时为近似值）
+     */
+    size_t size () const {
+        size_t tail = tail_.load(std::memory_order_acquire);
+        size_t head = head_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+private:
+    static size_t RoundUp (size_t n) {
+        size_t cap = 2;
+        while (cap < n) {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    template <typename U>
+    bool Enqueue (U&& val) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_) {
+                return false;
+            }
+        }
+        new (items_[tail & mask_].bytes) T(std::forward<U>(val));
+        tail_.store(tail + 1, std::memory_order_release);
+        Wake(consumer_parked_, not_empty_);
+        return true;
+    }
+
+    bool Full () const {
+        return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_acquire) > mask_;
+    }
+
+    bool Empty () const {
+        return head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire);
+    }
+
+    // 休眠直到ready()成立或被对方唤醒。
+    // 先登记休眠标志、全序栅栏之后再检查队列，与Wake配对：要么这里看到对方的修改，要么对方看到标志
+    template <typename Ready>
+    void Park (std::atomic<bool>& parked, std::condition_variable& cond, Ready ready) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        parked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready()) {
+            // Wake在持有锁时通知，不会落在检查和wait之间
+            cond.wait(lock, [&parked]() { return !parked.load(std::memory_order_relaxed); });
+        }
+        parked.store(false, std::memory_order_relaxed);
+    }
+
+    // 对方在休眠时唤醒它；先清除标志，同一次休眠只通知一次。
+    // 全序栅栏保证入队/出队的结果对检查标志之后才休眠的一方可见
+    void Wake (std::atomic<bool>& parked, std::condition_variable& cond) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed) && parked.exchange(false)) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            cond.notify_one();
+        }
+    }
+};
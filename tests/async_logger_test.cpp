@@ -0,0 +1,181 @@
+/**
+ * @file async_logger_test.cpp
+ * @brief AsyncLogger测试：多个线程的日志按时间戳合并输出、并发写入时不丢失且每个线程内保持顺序、
+ *        停止时写出所有线程的缓冲区（包括已退出的线程）、限速模式抑制超出速率的日志并报告
+ */
+
+#include "../async_logger.h"
+#include "check.h"
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+// 输出的日志行（不含"[logger]"开头的报告行）
+static std::vector<std::string> Lines (const std::ostringstream& out, size_t* reports = nullptr) {
+    std::vector<std::string> lines;
+    std::istringstream in(out.str());
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.rfind("[logger]", 0) == 0) {
+            if (reports) {
+                (*reports)++;
+            }
+            continue;
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// 多个线程交替写日志（互斥保证时间戳的先后与序号一致），后台线程启动后一次写出：
+// 输出按时间戳排序，与写入的全局顺序相同
+static void TestSortedByTimestamp () {
+    std::ostringstream out;
+    AsyncLogger logger(out);
+    std::mutex mtx;
+    int next = 0;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 6; t++) {
+        writers.emplace_back([&] () {
+            for (int i = 0; i < 300; i++) {
+                std::lock_guard<std::mutex> lock(mtx);
+                CHECK(logger.Log(std::to_string(next++)));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    logger.start();
+    logger.Flush();
+    auto lines = Lines(out);
+    CHECK(lines.size() == 1800);
+    bool sorted = true;
+    for (size_t i = 0; i < lines.size(); i++) {
+        sorted = sorted && lines[i] == std::to_string(i);
+    }
+    CHECK(sorted);
+    logger.stop();
+}
+
+// 后台线程运行期间多个线程并发写日志：一条不丢，每个线程自己的日志保持顺序
+static void TestConcurrentWritersComplete () {
+    constexpr int kWriters = 4;
+    constexpr int kLines = 5000;
+    std::ostringstream out;
+    AsyncLoggerConfig config;
+    config.buffer_capacity = kLines;
+    config.flush_interval = milliseconds(1);
+    AsyncLogger logger(out, config);
+    logger.start();
+    std::vector<std::thread> writers;
+    for (int t = 0; t < kWriters; t++) {
+        writers.emplace_back([&logger, t] () {
+            for (int i = 0; i < kLines; i++) {
+                logger.Log(std::to_string(t) + " " + std::to_string(i));
+            }
+        });
+    }
+    logger.Flush();   // 与写入并发的Flush
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    logger.stop();
+    CHECK(logger.Dropped() == 0);
+    std::vector<int> expected(kWriters, 0);
+    bool ordered = true;
+    for (const auto& line : Lines(out)) {
+        std::istringstream fields(line);
+        int t = -1, i = -1;
+        fields >> t >> i;
+        ordered = ordered && t >= 0 && t < kWriters && i == expected[t];
+        if (t >= 0 && t < kWriters) {
+            expected[t]++;
+        }
+    }
+    CHECK(ordered);
+    for (int t = 0; t < kWriters; t++) {
+        CHECK(expected[t] == kLines);
+    }
+}
+
+// 没有周期写出时停止：已退出线程和仍在运行的线程的缓冲区都被写出
+static void TestStopFlushesAllBuffers () {
+    std::ostringstream out;
+    AsyncLoggerConfig config;
+    config.flush_interval = hours(1);
+    AsyncLogger logger(out, config);
+    logger.start();
+    std::thread exited([&logger] () {
+        for (int i = 0; i < 100; i++) {
+            logger.Log("exited " + std::to_string(i));
+        }
+    });
+    exited.join();
+    std::promise<void> logged, release;
+    std::thread alive([&] () {
+        for (int i = 0; i < 100; i++) {
+            logger.Log("alive " + std::to_string(i));
+        }
+        logged.set_value();
+        release.get_future().wait();
+    });
+    logged.get_future().wait();
+    logger.Log("main");
+    CHECK(Lines(out).empty());   // 还没有到写出周期
+    CHECK(Finishes([&logger] () { logger.stop(); }));
+    release.set_value();
+    alive.join();
+    auto lines = Lines(out);
+    CHECK(lines.size() == 201);
+    size_t exited_lines = 0, alive_lines = 0;
+    for (const auto& line : lines) {
+        exited_lines += line.rfind("exited ", 0) == 0;
+        alive_lines += line.rfind("alive ", 0) == 0;
+    }
+    CHECK(exited_lines == 100 && alive_lines == 100);
+}
+
+// 限速模式：超出速率和突发量的日志被抑制（Log返回false）并计数，写出时报告抑制的条数
+static void TestRateLimitSuppresses () {
+    std::ostringstream out;
+    AsyncLoggerConfig config;
+    config.rate_limit = 20;
+    config.burst = 5;
+    AsyncLogger logger(out, config);
+    CHECK(!logger.Log("before start"));   // token生产者尚未启动
+    auto begin = steady_clock::now();
+    logger.start();
+    int accepted = 0;
+    for (int i = 0; i < 100; i++) {
+        accepted += logger.Log("burst " + std::to_string(i));
+    }
+    std::this_thread::sleep_for(milliseconds(300));
+    for (int i = 0; i < 100; i++) {
+        accepted += logger.Log("later " + std::to_string(i));
+    }
+    double elapsed = duration<double>(steady_clock::now() - begin).count();
+    logger.Flush();
+    logger.stop();
+    CHECK(accepted >= 2);
+    CHECK(accepted <= 2 * static_cast<int>(config.burst) + 1 + static_cast<int>(elapsed * config.rate_limit));
+    CHECK(logger.Suppressed() == static_cast<uint64_t>(201 - accepted));
+    size_t reports = 0;
+    CHECK(Lines(out, &reports).size() == static_cast<size_t>(accepted));
+    CHECK(reports >= 1);
+    CHECK(out.str().find("suppressed") != std::string::npos);
+}
+
+int main () {
+    TestSortedByTimestamp();
+    TestConcurrentWritersComplete();
+    TestStopFlushesAllBuffers();
+    TestRateLimitSuppresses();
+    return CheckResult("async_logger_test");
+}
@@ -0,0 +1,146 @@
+/**
+ * @file blocking_queue_test.cpp
+ * @brief BlockingQueue测试：只可移动的元素、批量存取的部分批次、try_系列接口、多生产者多消费者不丢不重
+ */
+
+#include "../blocking_queue.h"
+#include "check.h"
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using Item = std::unique_ptr<int>;
+
+static std::vector<Item> MakeItems (int first, int count) {
+    std::vector<Item> items;
+    for (int i = 0; i < count; i++) {
+        items.push_back(std::make_unique<int>(first + i));
+    }
+    return items;
+}
+
+// 只可移动的元素：put/emplace/get/try_put/try_get
+static void TestMoveOnly () {
+    BlockingQueue<Item> queue(2);
+    CHECK(queue.capacity() == 2);
+    queue.put(std::make_unique<int>(1));
+    queue.emplace(new int(2));
+    Item extra = std::make_unique<int>(3);
+    CHECK(!queue.try_put(std::move(extra)));
+    CHECK(extra && *extra == 3);           // 失败时保持不变
+    CHECK(queue.size() == 2);
+    Item out;
+    CHECK(queue.try_get(out) && *out == 1);
+    CHECK(queue.try_put(std::move(extra)));
+    CHECK(!extra);
+    CHECK(*queue.get() == 2);
+    CHECK(*queue.get() == 3);
+    CHECK(!queue.try_get(out));
+    CHECK(queue.size() == 0);
+}
+
+// 批量存取：try_put_bulk只放入容纳得下的部分，get_bulk取出已有的部分
+static void TestBulkPartial () {
+    BlockingQueue<Item> queue(4);
+    std::vector<Item> items = MakeItems(0, 6);
+    CHECK(queue.try_put_bulk(items.begin(), items.end()) == 4);
+    CHECK(!items[0] && !items[3]);
+    CHECK(items[4] && items[5]);           // 没有入队的元素不被移走
+    std::vector<Item> out;
+    CHECK(queue.try_get_bulk(std::back_inserter(out), 3) == 3);
+    CHECK(out.size() == 3 && *out[0] == 0 && *out[2] == 2);
+    CHECK(queue.get_bulk(std::back_inserter(out), 10) == 1);   // 只有1个可取，不等凑满
+    CHECK(*out[3] == 3);
+    CHECK(queue.try_get_bulk(std::back_inserter(out), 10) == 0);
+    CHECK(queue.get_bulk(std::back_inserter(out), 0) == 0);
+
+    // 阻塞的put_bulk超过容量：分多次放入，消费者取走后继续
+    std::vector<Item> many = MakeItems(100, 10);
+    std::thread producer([&queue, &many] () { queue.put_bulk(many.begin(), many.end()); });
+    std::vector<Item> got;
+    while (got.size() < 10) {
+        queue.get_bulk(std::back_inserter(got), 3);
+    }
+    producer.join();
+    bool ordered = true;
+    for (size_t i = 0; i < got.size(); i++) {
+        ordered = ordered && *got[i] == 100 + static_cast<int>(i);
+    }
+    CHECK(ordered);
+}
+
+// 4个生产者（单个和批量混用）、3个消费者（单个和批量混用），每个元素恰好取出一次
+static void TestConcurrentCount () {
+    const int producers = 4;
+    const int per_producer = 20000;
+    const int total = producers * per_producer;
+    BlockingQueue<Item> queue(16);
+    std::vector<std::atomic<int>> seen(total);
+    std::atomic<int> received{0};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, p] () {
+            int base = p * per_producer;
+            for (int i = 0; i < per_producer;) {
+                if (p % 2 == 0) {
+                    queue.put(std::make_unique<int>(base + i));
+                    i++;
+                } else {
+                    int count = std::min(7, per_producer - i);
+                    std::vector<Item> batch = MakeItems(base + i, count);
+                    queue.put_bulk(batch.begin(), batch.end());
+                    i += count;
+                }
+            }
+        });
+    }
+    const int consumers = 3;
+    for (int c = 0; c < consumers; c++) {
+        threads.emplace_back([&queue, &seen, &received, c] () {
+            std::vector<Item> batch;
+            for (;;) {
+                batch.clear();
+                if (c == 0) {
+                    batch.push_back(queue.get());
+                } else {
+                    queue.get_bulk(std::back_inserter(batch), 5);
+                }
+                for (Item& item : batch) {
+                    if (*item < 0) {
+                        return;   // 终止标记
+                    }
+                    seen[*item]++;
+                    received++;
+                }
+            }
+        });
+    }
+    CHECK(Finishes([&threads, &queue] () {
+        for (int p = 0; p < producers; p++) {
+            threads[p].join();
+        }
+        // 每个消费者一个终止标记；批量消费者可能一次取走多个，因此多放几个
+        for (int c = 0; c < consumers * 5; c++) {
+            queue.put(std::make_unique<int>(-1));
+        }
+        for (int c = 0; c < consumers; c++) {
+            threads[producers + c].join();
+        }
+    }, std::chrono::seconds(60)));
+    CHECK(received == total);
+    bool once = true;
+    for (std::atomic<int>& count : seen) {
+        once = once && count == 1;
+    }
+    CHECK(once);
+}
+
+int main () {
+    TestMoveOnly();
+    TestBulkPartial();
+    TestConcurrentCount();
+    return CheckResult("blocking_queue_test");
+}
@@ -0,0 +1,49 @@
+/**
+ * @file bucket_simulator_test.cpp
+ * @brief BucketSimulator测试：成本超过max_tokens的请求计为拒绝，结果可重复
+ */
+
+#include "../bucket_simulator.h"
+#include "check.h"
+#include <chrono>
+
+using namespace std::chrono;
+
+static SimulationConfig SmallConfig () {
+    SimulationConfig config;
+    config.max_tokens = 5;
+    config.producer.rate = 100;
+    config.duration = seconds(10);
+    return config;
+}
+
+// 成本超过max_tokens的请求永远无法满足：计入拒绝，不计入等待
+static void TestInfeasibleCostRejected () {
+    BucketSimulator simulator(SmallConfig(), ConstantArrivals(10, 6));
+    SimulationResult result = simulator.Run();
+    CHECK(result.arrivals > 0);
+    CHECK(result.rejected == result.arrivals);
+    CHECK(result.granted == 0);
+    CHECK(result.rejection_rate == 1.0);
+    for (const SimulationSample& sample : result.curve) {
+        CHECK(sample.waiting == 0);
+    }
+}
+
+// 可以满足的请求：速率足够时全部获得token；相同的种子结果相同
+static void TestFeasibleAndDeterministic () {
+    SimulationResult a = BucketSimulator(SmallConfig(), PoissonArrivals(50, 1, 7)).Run();
+    SimulationResult b = BucketSimulator(SmallConfig(), PoissonArrivals(50, 1, 7)).Run();
+    CHECK(a.arrivals > 400);
+    CHECK(a.rejected == 0);
+    CHECK(a.granted + 5 >= a.arrivals);  // 只有结束时仍在等待的少数请求没有获得token
+    CHECK(a.arrivals == b.arrivals);
+    CHECK(a.granted == b.granted);
+    CHECK(a.token_wait.p99 == b.token_wait.p99);
+}
+
+int main () {
+    TestInfeasibleCostRejected();
+    TestFeasibleAndDeterministic();
+    return CheckResult("bucket_simulator_test");
+}
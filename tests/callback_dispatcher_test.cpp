@@ -0,0 +1,131 @@
+/**
+ * @file callback_dispatcher_test.cpp
+ * @brief CallbackDispatcher测试：同一个Channel的投递合并分发且计数不丢失、
+ *        Flush返回前之前的投递都已分发、多个生产者向同一个分发器投递
+ */
+
+#include "../callback_dispatcher.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+// 分发前的多次投递合并为一批：批量回调只调用一次，逐次回调按计数调用
+static void TestCoalescePerChannel () {
+    CallbackDispatcher dispatcher;
+    size_t batches = 0, batch_ok = 0, batch_failed = 0;
+    CallbackDispatcher::Channel batched([] (bool) {}, [&] (size_t ok, size_t failed) {
+        batches++;
+        batch_ok += ok;
+        batch_failed += failed;
+    });
+    size_t single_ok = 0, single_failed = 0;
+    CallbackDispatcher::Channel single([&] (bool ok) { (ok ? single_ok : single_failed)++; });
+    for (int i = 0; i < 5; i++) {
+        dispatcher.Post(batched, true);
+    }
+    for (int i = 0; i < 3; i++) {
+        dispatcher.Post(batched, false);
+        dispatcher.Post(single, i != 0);
+    }
+    dispatcher.start();
+    dispatcher.Flush(batched);
+    dispatcher.Flush(single);
+    CHECK(batches == 1);
+    CHECK(batch_ok == 5 && batch_failed == 3);
+    CHECK(single_ok == 2 && single_failed == 1);
+
+    // 分发之后的投递重新入队，作为新的一批
+    dispatcher.Post(batched, true);
+    dispatcher.Flush(batched);
+    CHECK(batches == 2);
+    CHECK(batch_ok == 6);
+    dispatcher.stop();
+}
+
+// Flush返回时，之前的投递都已分发完（包括正在执行的慢回调）；stop()分发完剩余的投递
+static void TestFlushDeliversQueued () {
+    CallbackDispatcher dispatcher;
+    std::atomic<size_t> delivered{0};
+    CallbackDispatcher::Channel slow([&] (bool) {
+        std::this_thread::sleep_for(microseconds(200));
+        delivered++;
+    });
+    dispatcher.start();
+    size_t posted = 0;
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 10; i++) {
+            dispatcher.Post(slow, true);
+            posted++;
+        }
+        dispatcher.Flush(slow);
+        CHECK(delivered == posted);
+    }
+
+    for (int i = 0; i < 10; i++) {
+        dispatcher.Post(slow, false);
+        posted++;
+    }
+    CHECK(Finishes([&dispatcher] () { dispatcher.stop(); }));
+    CHECK(delivered == posted);
+    CHECK(Finishes([&] () { dispatcher.Flush(slow); }));  // 已停止时直接返回
+}
+
+// 多个生产者线程向同一个分发器的多个Channel投递：每个Channel的成功/失败计数都不丢失
+static void TestManyProducers () {
+    constexpr int kChannels = 4;
+    constexpr int kProducers = 8;
+    constexpr int kPosts = 20000;
+    CallbackDispatcher dispatcher(2);
+    struct Counts {
+        std::atomic<size_t> ok{0};
+        std::atomic<size_t> failed{0};
+        std::atomic<size_t> batches{0};
+    };
+    std::vector<Counts> counts(kChannels);
+    std::vector<std::unique_ptr<CallbackDispatcher::Channel>> channels;
+    for (int c = 0; c < kChannels; c++) {
+        Counts* count = &counts[c];
+        channels.emplace_back(new CallbackDispatcher::Channel([] (bool) {}, [count] (size_t ok, size_t failed) {
+            count->ok += ok;
+            count->failed += failed;
+            count->batches++;
+        }));
+    }
+    dispatcher.start();
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&, p] () {
+            for (int i = 0; i < kPosts; i++) {
+                dispatcher.Post(*channels[(p + i) % kChannels], i % 3 != 0);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    size_t total_ok = 0, total_failed = 0, total_batches = 0;
+    for (int c = 0; c < kChannels; c++) {
+        dispatcher.Flush(*channels[c]);
+        total_ok += counts[c].ok;
+        total_failed += counts[c].failed;
+        total_batches += counts[c].batches;
+        CHECK(counts[c].ok + counts[c].failed == kProducers * kPosts / kChannels);
+    }
+    size_t expected_failed = kProducers * ((kPosts + 2) / 3);
+    CHECK(total_failed == expected_failed);
+    CHECK(total_ok == kProducers * kPosts - expected_failed);
+    CHECK(total_batches > 0 && total_batches <= total_ok + total_failed);
+    dispatcher.stop();
+}
+
+int main () {
+    TestCoalescePerChannel();
+    TestFlushDeliversQueued();
+    TestManyProducers();
+    return CheckResult("callback_dispatcher_test");
+}
@@ -0,0 +1,59 @@
+/**
+ * @file check.h
+ * @brief 测试用的最小断言宏
+ *
+ * 每个测试是一个独立的可执行文件（tests目录下的*_test.cpp），不依赖测试框架。
+ * CHECK失败时打印位置并记录失败，不受NDEBUG影响；main返回CheckResult()，全部通过时为0。
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <thread>
+#include <utility>
+
+inline int& CheckFailures () {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            CheckFailures()++;                                                   \
+        }                                                                        \
+    } while (0)
+
+/**
+ * @brief 在另一个线程中运行f，检查它是否在limit内返回
+ * @return 按时返回true；超时返回false，挂住的线程被分离（测试随后以失败退出）
+ *
+ * 用于回归"stop()/析构永远不返回"一类的问题，避免整个测试挂住。
+ */
+template <typename F>
+bool Finishes (F f, std::chrono::milliseconds limit = std::chrono::seconds(5)) {
+    std::packaged_task<void()> task(std::move(f));
+    std::future<void> done = task.get_future();
+    std::thread runner(std::move(task));
+    if (done.wait_for(limit) != std::future_status::ready) {
+        runner.detach();
+        return false;
+    }
+    runner.join();
+    return true;
+}
+
+/**
+ * @brief 打印结果，返回进程退出码
+ */
+inline int CheckResult (const char* name) {
+    if (CheckFailures() == 0) {
+        std::printf("%s: OK\n", name);
+        return 0;
+    }
+    std::printf("%s: %d check(s) failed\n", name, CheckFailures());
+    return 1;
+}
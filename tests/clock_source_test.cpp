@@ -0,0 +1,131 @@
+/**
+ * @file clock_source_test.cpp
+ * @brief VirtualClock测试：等待时跳到截止时间、参与线程之间不漏跳、生产/消费在虚拟时间中的结果可重复
+ */
+
+#include "../clock_source.h"
+#include "../token_customer.h"
+#include "../token_producer.h"
+#include "check.h"
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+// 没有忙碌的参与线程时，等待直接跳到截止时间；Advance唤醒到期的等待者
+static void TestSleepJumps () {
+    VirtualClock clock;
+    auto start = clock.Now();
+    auto real = steady_clock::now();
+    clock.SleepFor(hours(1));
+    CHECK(clock.Now() - start == hours(1));
+    CHECK(steady_clock::now() - real < seconds(1));
+
+    clock.Advance(seconds(5));
+    CHECK(clock.Now() - start == hours(1) + seconds(5));
+    clock.AdvanceTo(start);  // 不会倒退
+    CHECK(clock.Now() - start == hours(1) + seconds(5));
+}
+
+// 两个参与线程按不同周期睡眠：每次醒来的时间恰好是截止时间，时间只在双方都等待时推进
+static void TestParticipantsWakeOnDeadline () {
+    auto clock = std::make_shared<VirtualClock>();
+    auto start = clock->Now();
+    std::vector<ClockSource::time_point> woke[2];
+    const milliseconds periods[2] = {milliseconds(3), milliseconds(7)};
+    const int rounds = 1000;
+    std::vector<std::thread> threads;
+    clock->Attach();  // 两个线程都在创建之前登记，否则先启动的线程睡眠时时间就会推进
+    clock->Attach();
+    for (int t = 0; t < 2; t++) {
+        threads.emplace_back([&clock, &woke, &periods, start, t] () {
+            clock->Bind();
+            for (int k = 1; k <= rounds; k++) {
+                clock->SleepUntil(start + periods[t] * k);
+                woke[t].push_back(clock->Now());
+            }
+            clock->Detach();
+        });
+    }
+    CHECK(Finishes([&threads] () {
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }));
+    for (int t = 0; t < 2; t++) {
+        CHECK(woke[t].size() == static_cast<size_t>(rounds));
+        bool exact = true;
+        for (int k = 1; k <= rounds && k <= static_cast<int>(woke[t].size()); k++) {
+            exact = exact && woke[t][k - 1] == start + periods[t] * k;
+        }
+        CHECK(exact);
+    }
+    CHECK(clock->Now() - start == milliseconds(7) * rounds);
+}
+
+struct RunResult {
+    uint64_t grants;
+    uint64_t tokens;
+    size_t left;
+    ClockSource::duration elapsed;
+};
+
+// 一个生产者、两个消费者在虚拟时间中运行60秒
+static RunResult RunVirtual () {
+    auto clock = std::make_shared<VirtualClock>();
+    clock->Attach();
+    clock->Bind();
+    auto start = clock->Now();
+    auto manager = std::make_shared<TokenManager>(10);
+    ProducerConfig config;
+    config.rate = 100;
+    TokenProducer producer(manager, config);
+    producer.SetClock(clock);
+    producer.start();
+    std::vector<std::unique_ptr<TokenCustomer>> customers;
+    for (int i = 0; i < 2; i++) {
+        customers.push_back(std::make_unique<TokenCustomer>(manager, 3));
+        customers.back()->SetClock(clock);
+        customers.back()->start();
+    }
+    clock->SleepFor(seconds(60));
+    RunResult result{0, 0, 0, clock->Now() - start};
+    for (auto& customer : customers) {
+        customer->stop();
+        CustomerStats stats = customer->GetStats();
+        result.grants += stats.grants;
+        result.tokens += stats.tokens;
+    }
+    producer.stop();
+    result.left = manager->GetTokens();
+    clock->Detach();
+    return result;
+}
+
+// 同样的配置运行两次，结果完全相同，且符合生产速率
+static void TestProducerConsumerDeterministic () {
+    RunResult first{};
+    RunResult second{};
+    auto real = steady_clock::now();
+    CHECK(Finishes([&first, &second] () {
+        first = RunVirtual();
+        second = RunVirtual();
+    }));
+    CHECK(steady_clock::now() - real < seconds(5));
+    CHECK(first.elapsed == seconds(60));
+    CHECK(first.grants == second.grants);
+    CHECK(first.tokens == second.tokens);
+    CHECK(first.left == second.left);
+    CHECK(first.elapsed == second.elapsed);
+    CHECK(first.tokens == first.grants * 3);
+    CHECK(first.tokens + first.left >= 5997 && first.tokens + first.left <= 6001);  // 100/s × 60s
+}
+
+int main () {
+    TestSleepJumps();
+    TestParticipantsWakeOnDeadline();
+    TestProducerConsumerDeterministic();
+    return CheckResult("clock_source_test");
+}
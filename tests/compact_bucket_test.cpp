@@ -0,0 +1,94 @@
+/**
+ * @file compact_bucket_test.cpp
+ * @brief CompactBucket测试：GCRA的消费/等待时间、高速率的精度、大突发量×长间隔不溢出、桶表的ID重用
+ */
+
+#include "../compact_bucket.h"
+#include "check.h"
+#include <cmath>
+#include <cstdint>
+
+static bool Near (double value, double expected, double tolerance) {
+    return std::fabs(value - expected) <= expected * tolerance;
+}
+
+// 基本的GCRA行为：满桶创建，消费到空后按速率恢复
+static void TestBasic () {
+    CompactBucket bucket;
+    bucket.Reset(1000, 5, 0);
+    CHECK(bucket.Tokens(0) == 5);
+    CHECK(bucket.TryConsume(5, 0));
+    CHECK(!bucket.TryConsume(1, 0));
+    CHECK(bucket.WaitTime(1, 0) == 1000000);
+    CHECK(bucket.WaitTime(6, 0) == UINT64_MAX);
+    CHECK(bucket.Tokens(1000000) == 1);
+    CHECK(bucket.TryConsume(1, 1000000));
+    CHECK(bucket.Tokens(100000000) == 5);  // 不超过突发量
+}
+
+// 高速率不再按整数纳秒取整：3e8/s过去变成3.33e8/s
+static void TestHighRatePrecision () {
+    CompactBucket bucket;
+    bucket.Reset(3e8, CompactBucket::kMaxBurst, 0);
+    CHECK(Near(bucket.Rate(), 3e8, 0.002));
+    CHECK(bucket.TryConsume(CompactBucket::kMaxBurst, 0));
+    CHECK(Near(static_cast<double>(bucket.Tokens(10000000)), 3e6, 0.002));  // 10ms
+    CHECK(!bucket.TryConsume(1, 0));
+    CHECK(bucket.WaitTime(1, 0) == 4);     // 3.33ns向上取整
+
+    bucket.Reset(7e8, 1000, 0);
+    CHECK(Near(bucket.Rate(), 7e8, 0.008));
+    bucket.Reset(1e9, 1, 0);
+    CHECK(bucket.Rate() == 1e9);
+    CHECK(bucket.TryConsume(1, 0));
+    CHECK(bucket.WaitTime(1, 0) == 1);
+    CHECK(bucket.TryConsume(1, 1));
+    bucket.Reset(5e9, 1, 0);               // 超过kMaxRate时截断
+    CHECK(bucket.Rate() == CompactBucket::kMaxRate);
+
+    // 低速率仍以纳秒为单位
+    bucket.Reset(3, 10, 0);
+    CHECK(Near(bucket.Rate(), 3, 1e-9));
+}
+
+// 长间隔和最大突发量：突发量被截断，时间计算不溢出
+static void TestNoOverflow () {
+    CompactBucket bucket;
+    uint64_t now = uint64_t(5) << 60;
+    bucket.Reset(0.001, CompactBucket::kMaxBurst, now);
+    CHECK(bucket.Burst() > 0);
+    CHECK(bucket.Burst() < CompactBucket::kMaxBurst);
+    CHECK(static_cast<double>(bucket.Burst()) / bucket.Rate() <= std::ldexp(1.0, 61) / 1e9);
+    CHECK(bucket.Tokens(now) == bucket.Burst());
+    CHECK(bucket.TryConsume(1, now));
+    CHECK(bucket.Tokens(now) == bucket.Burst() - 1);
+    CHECK(bucket.WaitTime(bucket.Burst(), now) > 0);
+    CHECK(bucket.WaitTime(bucket.Burst(), now) <= CompactBucket::kMaxInterval);
+}
+
+// 销毁的桶进入空闲链表，ID被重用，重用的桶重新变满
+static void TestTableReuse () {
+    CompactBucketTable table;
+    CompactBucketId a = table.Create(10, 2);
+    CompactBucketId b = table.Create(10, 2);
+    CHECK(a != b);
+    CHECK(table.Size() == 2);
+    CHECK(table.TryConsume(a, 2));
+    CHECK(!table.TryConsume(a, 1));
+    size_t memory = table.MemoryBytes();
+    table.Destroy(a);
+    CompactBucketId c = table.Create(10, 3);
+    CHECK(c == a);
+    CHECK(table[c].Burst() == 3);
+    CHECK(table.TryConsume(c, 3));
+    CHECK(table.MemoryBytes() == memory);
+    CHECK(table.Size() == 2);
+}
+
+int main () {
+    TestBasic();
+    TestHighRatePrecision();
+    TestNoOverflow();
+    TestTableReuse();
+    return CheckResult("compact_bucket_test");
+}
@@ -0,0 +1,194 @@
+/**
+ * @file concurrency_limiter_test.cpp
+ * @brief ConcurrencyLimiter测试：Lease的获取/归还/移动、上限的增大和减小、
+ *        减小时通过TryConsumeUpTo收回空闲槽位并记欠账、欠账由之后归还的槽位抵扣、
+ *        在虚拟时间中模拟容量有限的后端时上限收敛
+ */
+
+#include "../clock_source.h"
+#include "../concurrency_limiter.h"
+#include "check.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono;
+
+// 空闲槽位不会让在途请求超过上限（上限减小前已经在途的请求不受影响，此时没有空闲槽位）
+static bool WithinLimit (ConcurrencyLimiter& limiter, size_t in_flight) {
+    return limiter.Slots()->GetTokens() + in_flight <= std::max(limiter.Limit(), in_flight);
+}
+
+// 获取、移动、Release和Drop：只有Release产生样本，析构归还未释放的槽位
+static void TestLeaseLifecycle () {
+    ConcurrencyLimiterConfig config;
+    config.initial_limit = 2;
+    ConcurrencyLimiter limiter(config);
+    {
+        auto a = limiter.TryAcquire();
+        auto b = limiter.Acquire();
+        CHECK(a && b);
+        CHECK(!limiter.TryAcquire());
+        CHECK(limiter.GetStats().in_flight == 2);
+
+        ConcurrencyLimiter::Lease moved(std::move(a));
+        CHECK(moved && !a);
+        b.Drop();
+        CHECK(!b);
+        CHECK(limiter.GetStats().samples == 0);
+        CHECK(limiter.Slots()->GetTokens() == 1);
+
+        b = limiter.TryAcquire();
+        CHECK(b);
+        b = std::move(moved);    // 覆盖前先归还b原来的槽位
+        CHECK(b && !moved);
+        CHECK(limiter.Slots()->GetTokens() == 1);
+
+        b.Release();
+        b.Release();             // 重复Release无效
+        CHECK(limiter.GetStats().samples == 1);
+        auto c = limiter.TryAcquire();
+        CHECK(c);
+    }
+    // 全部归还后没有欠账：空闲槽位等于上限
+    CHECK(limiter.GetStats().in_flight == 0);
+    CHECK(limiter.Slots()->GetTokens() == limiter.Limit());
+
+    // 被停止标志中断时返回空的Lease
+    ConcurrencyLimiterConfig one;
+    one.initial_limit = 1;
+    ConcurrencyLimiter busy(one);
+    auto held = busy.TryAcquire();
+    std::atomic<bool> stop{true};
+    CHECK(!busy.Acquire(&stop));
+}
+
+// 需求饱和且RTT没有上升时，一个窗口（上限数量的样本）之后增大上限，新增的槽位立即可用；
+// 失败时不等窗口结束，立即按backoff减小
+static void TestGrowAndShrink () {
+    ConcurrencyLimiterConfig config;
+    config.initial_limit = 10;
+    ConcurrencyLimiter limiter(config);
+    // 直接从槽位池获取，按固定的RTT报告：排队估计为0
+    auto slots = limiter.Slots();
+    CHECK(slots->TryConsumeTokens(10));
+    CHECK(!slots->TryConsumeTokens(1));
+    for (int i = 0; i < 9; i++) {
+        limiter.Release(milliseconds(10));
+        CHECK(limiter.Limit() == 10);         // 窗口未满
+    }
+    limiter.Release(milliseconds(10));
+    CHECK(limiter.Limit() == 11);
+    CHECK(slots->GetTokens() == 11);         // 归还的10个加上新增的1个
+    CHECK(limiter.GetStats().samples == 10);
+
+    ConcurrencyLimiterConfig shrink;
+    shrink.initial_limit = 10;
+    shrink.backoff = 0.8;
+    ConcurrencyLimiter failing(shrink);
+    auto lease = failing.TryAcquire();
+    lease.Release(false);
+    CHECK(failing.Limit() == 8);
+    CHECK(failing.GetStats().drops == 1);
+    CHECK(failing.Slots()->GetTokens() == 8);  // 空闲槽位被收回，没有欠账
+}
+
+// 减小上限时空闲槽位不够收回：不足的部分记为欠账，之后归还的槽位先抵扣欠账，
+// 在途请求降到新上限以下之前没有空闲槽位，之后两者之和不超过新的上限
+static void TestShrinkIntoDebt () {
+    ConcurrencyLimiterConfig config;
+    config.initial_limit = 10;
+    config.backoff = 0.5;
+    ConcurrencyLimiter limiter(config);
+    std::vector<ConcurrencyLimiter::Lease> leases;
+    for (int i = 0; i < 6; i++) {
+        leases.push_back(limiter.TryAcquire());
+    }
+    // 6个在途、4个空闲：上限减到5，收回4个空闲槽位，欠1个，由这次归还的槽位抵扣
+    leases.back().Release(false);
+    leases.pop_back();
+    CHECK(limiter.Limit() == 5);
+    CHECK(limiter.Slots()->GetTokens() == 0);
+    CHECK(WithinLimit(limiter, leases.size()));
+
+    // 全部在途时再减半：上限2，欠账2
+    leases.back().Release(false);
+    leases.pop_back();
+    CHECK(limiter.Limit() == 2);
+    CHECK(limiter.GetStats().in_flight == 4);
+    CHECK(limiter.Slots()->GetTokens() == 0);
+    // 之后归还的槽位先还清欠账，然后才放回槽位池
+    size_t in_flight = leases.size();
+    while (!leases.empty()) {
+        leases.back().Drop();
+        leases.pop_back();
+        in_flight--;
+        CHECK(WithinLimit(limiter, in_flight));
+        CHECK(limiter.Slots()->GetTokens() == (in_flight < 2 ? 2 - in_flight : 0));
+    }
+    CHECK(limiter.Slots()->GetTokens() == 2);
+    CHECK(limiter.TryAcquire());
+}
+
+// 在虚拟时间中模拟容量为capacity的后端：在途请求超过容量时排队，RTT按比例增加。
+// 客户端需求无限（槽位一空出就被占用），返回每个完成时刻的上限
+static std::vector<size_t> Simulate (ConcurrencyLimiter& limiter, size_t capacity, size_t completions,
+                                     bool& within) {
+    VirtualClock clock;
+    const nanoseconds base = milliseconds(10);
+    std::multimap<ClockSource::time_point, ClockSource::time_point> in_flight;  // 完成时间 -> 开始时间
+    std::vector<size_t> limits;
+    within = true;
+    while (limits.size() < completions) {
+        while (limiter.Slots()->TryConsumeTokens(1)) {
+            double load = static_cast<double>(in_flight.size() + 1) / capacity;
+            auto rtt = duration_cast<nanoseconds>(base * std::max(1.0, load));
+            in_flight.emplace(clock.Now() + rtt, clock.Now());
+        }
+        within = within && WithinLimit(limiter, in_flight.size());
+        auto done = in_flight.begin();
+        clock.AdvanceTo(done->first);
+        limiter.Release(done->first - done->second, true);
+        in_flight.erase(done);
+        limits.push_back(limiter.Limit());
+    }
+    return limits;
+}
+
+// 上限在最后的样本中的波动范围
+static size_t Spread (const std::vector<size_t>& limits, size_t tail) {
+    auto begin = limits.end() - static_cast<std::ptrdiff_t>(tail);
+    return *std::max_element(begin, limits.end()) - *std::min_element(begin, limits.end());
+}
+
+// Vegas和Gradient都从远离容量的初始值收敛到容量附近并保持稳定
+// （Vegas约为容量加上alpha到beta个排队请求，Gradient约为RTT达到tolerance倍时的并发数）
+static void TestConverges () {
+    const size_t capacity = 20;
+    for (auto mode : {ConcurrencyLimiterConfig::Mode::kVegas, ConcurrencyLimiterConfig::Mode::kGradient}) {
+        for (size_t initial : {size_t(2), size_t(200)}) {
+            ConcurrencyLimiterConfig config;
+            config.mode = mode;
+            config.initial_limit = initial;
+            config.probe_samples = 100000;   // 测试期间不重新测量最小RTT
+            ConcurrencyLimiter limiter(config);
+            bool within = false;
+            auto limits = Simulate(limiter, capacity, 20000, within);
+            size_t final_limit = limits.back();
+            CHECK(within);
+            CHECK(final_limit >= capacity && final_limit <= capacity * 2);
+            CHECK(Spread(limits, 2000) <= 2);
+        }
+    }
+}
+
+int main () {
+    TestLeaseLifecycle();
+    TestGrowAndShrink();
+    TestShrinkIntoDebt();
+    TestConverges();
+    return CheckResult("concurrency_limiter_test");
+}
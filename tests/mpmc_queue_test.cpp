@@ -0,0 +1,125 @@
+/**
+ * @file mpmc_queue_test.cpp
+ * @brief MpmcQueue测试：容量和FIFO、剩余元素的析构、多生产者多消费者并发下每个元素恰好出队一次且保持每个生产者内的顺序
+ */
+
+#include "../mpmc_queue.h"
+#include "check.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// 记录存活实例数量的元素
+struct Counted {
+    static std::atomic<int> live;
+    int value = 0;
+
+    Counted() { live++; }
+    explicit Counted(int v) : value(v) { live++; }
+    Counted(const Counted& other) : value(other.value) { live++; }
+    Counted& operator=(const Counted&) = default;
+    ~Counted() { live--; }
+};
+
+std::atomic<int> Counted::live{0};
+
+static void TestBasic () {
+    MpmcQueue<int> queue(5);
+    CHECK(queue.capacity() == 8);
+    for (int i = 0; i < 8; i++) {
+        CHECK(queue.try_put(i));
+    }
+    CHECK(!queue.try_put(8));
+    CHECK(queue.size() == 8);
+    int out = -1;
+    for (int i = 0; i < 8; i++) {
+        CHECK(queue.try_get(out) && out == i);
+    }
+    CHECK(!queue.try_get(out));
+    // 多轮绕回
+    for (int i = 0; i < 100; i++) {
+        queue.put(i);
+        CHECK(queue.get() == i);
+    }
+    CHECK(queue.size() == 0);
+}
+
+static void TestDestroysRemaining () {
+    {
+        MpmcQueue<Counted> queue(4);
+        for (int i = 0; i < 3; i++) {
+            queue.put(Counted(i));
+        }
+        Counted out;
+        CHECK(queue.try_get(out) && out.value == 0);
+        CHECK(Counted::live == 3);   // 队列中2个 + out
+    }
+    CHECK(Counted::live == 0);
+}
+
+// 4个生产者、4个消费者、容量8（频繁满/空，走休眠路径）：阻塞和非阻塞接口混用
+static void TestConcurrent () {
+    const int producers = 4;
+    const int consumers = 4;
+    const int per_producer = 50000;
+    MpmcQueue<int> queue(8);
+    std::vector<std::atomic<int>> seen(producers * per_producer);
+    std::atomic<bool> ordered{true};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, p] () {
+            for (int i = 0; i < per_producer; i++) {
+                int value = p * per_producer + i;
+                if (i % 2 == 0 || !queue.try_put(value)) {
+                    queue.put(value);
+                }
+            }
+        });
+    }
+    for (int c = 0; c < consumers; c++) {
+        threads.emplace_back([&queue, &seen, &ordered] () {
+            std::vector<int> last(producers, -1);   // 每个生产者最近一次出队的序号
+            for (;;) {
+                int value;
+                if (!queue.try_get(value)) {
+                    value = queue.get();
+                }
+                if (value < 0) {
+                    return;
+                }
+                int p = value / per_producer;
+                int i = value % per_producer;
+                if (i <= last[p]) {
+                    ordered = false;
+                }
+                last[p] = i;
+                seen[value]++;
+            }
+        });
+    }
+    CHECK(Finishes([&threads, &queue] () {
+        for (int p = 0; p < producers; p++) {
+            threads[p].join();
+        }
+        for (int c = 0; c < consumers; c++) {
+            queue.put(-1);
+        }
+        for (int c = 0; c < consumers; c++) {
+            threads[producers + c].join();
+        }
+    }, std::chrono::seconds(60)));
+    bool once = true;
+    for (std::atomic<int>& count : seen) {
+        once = once && count == 1;
+    }
+    CHECK(once);
+    CHECK(ordered);
+    CHECK(queue.size() == 0);
+}
+
+int main () {
+    TestBasic();
+    TestDestroysRemaining();
+    TestConcurrent();
+    return CheckResult("mpmc_queue_test");
+}
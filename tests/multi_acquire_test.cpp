@@ -0,0 +1,174 @@
+/**
+ * @file multi_acquire_test.cpp
+ * @brief MultiAcquire测试：全部扣除或都不扣、阻塞获取与取消、按登记顺序满足、积压统计不含通知
+ */
+
+#include "../multi_acquire.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace std::chrono;
+
+template <typename F>
+static bool Eventually (F cond) {
+    auto deadline = steady_clock::now() + seconds(2);
+    while (!cond()) {
+        if (steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    return true;
+}
+
+// 任何一个桶不够时一个都不扣
+static void TestAllOrNothing () {
+    auto user = std::make_shared<TokenManager>(10);
+    auto global = std::make_shared<TokenManager>(10);
+    MultiAcquire acquire({{user, 2}, {global, 3}});
+    user->AddTokens(5);
+    global->AddTokens(2);
+    CHECK(!acquire.TryAcquire());
+    CHECK(user->GetTokens() == 5);
+    CHECK(global->GetTokens() == 2);
+    global->AddTokens(1);
+    CHECK(acquire.TryAcquire());
+    CHECK(user->GetTokens() == 3);
+    CHECK(global->GetTokens() == 0);
+
+    // 同一个桶出现多次时数量合并
+    MultiAcquire twice({{user, 2}, {user, 1}});
+    CHECK(twice.Charges().size() == 1 && twice.Charges()[0].n == 3);
+    CHECK(twice.TryAcquire());
+    CHECK(user->GetTokens() == 0);
+}
+
+// 某个桶上有排队的请求时不插队
+static void TestRespectsQueue () {
+    auto a = std::make_shared<TokenManager>(10);
+    auto b = std::make_shared<TokenManager>(10);
+    bool granted = false;
+    CHECK(a->ConsumeTokensAsync(4, [&granted] () { granted = true; }) != 0);
+    a->AddTokens(2);
+    b->AddTokens(2);
+    MultiAcquire acquire({{a, 1}, {b, 1}});
+    CHECK(!acquire.TryAcquire());
+    CHECK(a->GetTokens() == 2);
+    a->AddTokens(2);
+    CHECK(granted);
+    a->AddTokens(1);
+    CHECK(acquire.TryAcquire());
+}
+
+// 阻塞获取：等待期间不占用任何桶的token，最后一个桶补充后一次扣除
+static void TestBlockingAcquire () {
+    auto a = std::make_shared<TokenManager>(10);
+    auto b = std::make_shared<TokenManager>(10);
+    a->AddTokens(3);
+    MultiAcquire acquire({{a, 3}, {b, 2}});
+    std::atomic<bool> done{false};
+    std::thread waiter([&] () { done = acquire.Acquire(); });
+    CHECK(Eventually([&] () { return b->GetWatchers() == 1; }));
+    CHECK(a->GetTokens() == 3);       // 不占用a的token
+    CHECK(a->GetWaiters() == 0);      // 变化通知不计入积压
+    CHECK(b->GetWaiters() == 0);
+    b->AddTokens(1);
+    std::this_thread::sleep_for(milliseconds(20));
+    CHECK(!done);
+    b->AddTokens(1);
+    CHECK(Eventually([&] () { return done.load(); }));
+    waiter.join();
+    CHECK(a->GetTokens() == 0);
+    CHECK(b->GetTokens() == 0);
+    CHECK(a->GetWatchers() == 0 && b->GetWatchers() == 0);
+}
+
+// 停止信号中断等待：返回false，不扣除任何token，通知已注销
+static void TestStopCancels () {
+    auto a = std::make_shared<TokenManager>(10);
+    auto b = std::make_shared<TokenManager>(10);
+    a->AddTokens(1);
+    MultiAcquire acquire({{a, 1}, {b, 1}});
+    std::atomic<bool> stop{false};
+    std::atomic<int> result{-1};
+    std::thread waiter([&] () { result = acquire.Acquire(&stop) ? 1 : 0; });
+    CHECK(Eventually([&] () { return a->GetWatchers() == 1; }));
+    stop = true;
+    CHECK(Eventually([&] () { return result.load() == 0; }));
+    waiter.join();
+    CHECK(a->GetTokens() == 1);
+    CHECK(a->GetWatchers() == 0 && b->GetWatchers() == 0);
+    b->AddTokens(1);                  // 取消之后的补充不会被扣除
+    CHECK(b->GetTokens() == 1);
+
+    // 永远无法满足的请求立即返回
+    MultiAcquire infeasible({{a, 11}, {b, 1}});
+    CHECK(!infeasible.Acquire());
+    CHECK(a->GetWatchers() == 0);
+}
+
+// 同一组桶上的多个阻塞获取按登记顺序满足
+static void TestRegistrationOrder () {
+    auto a = std::make_shared<TokenManager>(10);
+    auto b = std::make_shared<TokenManager>(10);
+    MultiAcquire first({{a, 1}, {b, 1}});
+    MultiAcquire second({{a, 1}, {b, 1}});
+    std::atomic<bool> first_done{false};
+    std::atomic<bool> second_done{false};
+    std::thread t1([&] () { first_done = first.Acquire(); });
+    CHECK(Eventually([&] () { return a->GetWatchers() == 1 && b->GetWatchers() == 1; }));
+    std::thread t2([&] () { second_done = second.Acquire(); });
+    CHECK(Eventually([&] () { return a->GetWatchers() == 2 && b->GetWatchers() == 2; }));
+    a->AddTokens(1);
+    b->AddTokens(1);
+    CHECK(Eventually([&] () { return first_done.load(); }));
+    CHECK(!second_done);
+    a->AddTokens(1);
+    b->AddTokens(1);
+    CHECK(Eventually([&] () { return second_done.load(); }));
+    t1.join();
+    t2.join();
+}
+
+// 多个线程并发获取重叠的桶组：扣除总数与成功次数一致，token不会凭空消失或重复扣除
+static void TestConcurrentConservation () {
+    auto a = std::make_shared<TokenManager>(1000);
+    auto b = std::make_shared<TokenManager>(1000);
+    auto c = std::make_shared<TokenManager>(1000);
+    a->AddTokens(600);
+    b->AddTokens(600);
+    c->AddTokens(600);
+    std::atomic<int> ab{0};
+    std::atomic<int> bc{0};
+    std::thread t1([&] () {
+        MultiAcquire acquire({{a, 1}, {b, 1}});
+        for (int i = 0; i < 400; i++) {
+            ab += acquire.TryAcquire() ? 1 : 0;
+        }
+    });
+    std::thread t2([&] () {
+        MultiAcquire acquire({{c, 1}, {b, 1}});
+        for (int i = 0; i < 400; i++) {
+            bc += acquire.TryAcquire() ? 1 : 0;
+        }
+    });
+    t1.join();
+    t2.join();
+    CHECK(a->GetTokens() == static_cast<size_t>(600 - ab));
+    CHECK(c->GetTokens() == static_cast<size_t>(600 - bc));
+    CHECK(b->GetTokens() == static_cast<size_t>(600 - ab - bc));
+    CHECK(ab + bc == 600);            // b是瓶颈，正好被分完
+}
+
+int main () {
+    TestAllOrNothing();
+    TestRespectsQueue();
+    TestBlockingAcquire();
+    TestStopCancels();
+    TestRegistrationOrder();
+    TestConcurrentConservation();
+    return CheckResult("multi_acquire_test");
+}
@@ -0,0 +1,104 @@
+/**
+ * @file numa_bucket_test.cpp
+ * @brief NumaShardedBucket测试：非阻塞获取失败计入需求、按需求比例补充、阻塞获取借用其他节点补充的token
+ *
+ * 显式指定两个分片，单节点机器上也能运行（分片只是不再落在不同节点上）。
+ */
+
+#include "../numa_bucket.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono;
+
+template <typename F>
+static bool Eventually (F cond) {
+    auto deadline = steady_clock::now() + seconds(2);
+    while (!cond()) {
+        if (steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    return true;
+}
+
+// 只用TryConsumeTokens的节点获取失败后，下一次补充流向该节点，而不是最空的分片
+static void TestTryMissesAreDemand () {
+    NumaShardedBucket bucket(21, 2);  // 分片0容量11，分片1容量10
+    CHECK(!bucket.TryConsumeTokens(1, 1));
+    CHECK(bucket.AddTokens(4) == 4);
+    CHECK(bucket.At(1).GetTokens() == 4);
+    CHECK(bucket.At(0).GetTokens() == 0);
+    CHECK(bucket.TryConsumeTokens(1, 1));
+    CHECK(bucket.GetStats().local == 1);
+
+    // 需求已被满足：没有新的失败时按空余容量补充
+    CHECK(bucket.AddTokens(2) == 2);
+    CHECK(bucket.At(0).GetTokens() == 2);
+}
+
+// 多个节点都有需求时按比例分配
+static void TestProportionalShare () {
+    NumaShardedBucket bucket(40, 2);
+    for (int i = 0; i < 3; i++) {
+        CHECK(!bucket.TryConsumeTokens(1, 0));
+    }
+    CHECK(!bucket.TryConsumeTokens(1, 1));
+    CHECK(bucket.AddTokens(8) == 8);
+    CHECK(bucket.At(0).GetTokens() == 6);
+    CHECK(bucket.At(1).GetTokens() == 2);
+    CHECK(bucket.GetStats().misses == 4);
+}
+
+// 阻塞获取：本地分片没有补充时，借用其他节点的生产者补充的token
+static void TestBlockingBorrowsRemoteRefill () {
+    NumaShardedBucket bucket(20, 2);
+    std::atomic<bool> done{false};
+    std::thread consumer([&] () { done = bucket.ConsumeTokens(3, nullptr, 0); });
+    CHECK(Eventually([&] () { return bucket.At(0).GetWaiters() == 1; }));
+    bucket.At(1).AddTokens(3);        // 只有节点1的生产者在补充
+    CHECK(Eventually([&] () { return done.load(); }));
+    consumer.join();
+    NumaBucketStats stats = bucket.GetStats();
+    CHECK(stats.remote == 1);
+    CHECK(stats.local == 0);
+    CHECK(bucket.GetTokens() == 0);
+    CHECK(bucket.At(0).GetWaiters() == 0);     // 本地请求已撤销
+    CHECK(bucket.At(1).GetWatchers() == 0);
+    bucket.At(0).AddTokens(3);                  // 撤销之后的本地补充不会被扣除
+    CHECK(bucket.At(0).GetTokens() == 3);
+
+    // 本地补充照常满足
+    std::thread local([&] () { done = bucket.ConsumeTokens(5, nullptr, 0); });
+    CHECK(Eventually([&] () { return bucket.At(0).GetWaiters() == 1; }));
+    bucket.At(0).AddTokens(2);
+    local.join();
+    CHECK(done);
+    CHECK(bucket.GetStats().local == 1);
+}
+
+// 停止信号中断等待，不留下排队的请求和监视
+static void TestStop () {
+    NumaShardedBucket bucket(20, 2);
+    std::atomic<bool> stop{false};
+    std::atomic<int> result{-1};
+    std::thread consumer([&] () { result = bucket.ConsumeTokens(2, &stop, 0) ? 1 : 0; });
+    CHECK(Eventually([&] () { return bucket.At(0).GetWaiters() == 1; }));
+    stop = true;
+    CHECK(Eventually([&] () { return result.load() == 0; }));
+    consumer.join();
+    CHECK(bucket.At(0).GetWaiters() == 0);
+    CHECK(bucket.At(1).GetWatchers() == 0);
+    CHECK(!bucket.ConsumeTokens(11, nullptr, 0));  // 超过分片容量，立即失败
+}
+
+int main () {
+    TestTryMissesAreDemand();
+    TestProportionalShare();
+    TestBlockingBorrowsRemoteRefill();
+    TestStop();
+    return CheckResult("numa_bucket_test");
+}
@@ -0,0 +1,148 @@
+/**
+ * @file pipeline_test.cpp
+ * @brief Pipeline测试：每级限速、下游队列满时的背压、停止时处理完在途元素、运行中读取统计
+ */
+
+#include "../pipeline.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono;
+
+// 限速的阶段按配置的速率处理，不限速的阶段不受影响
+static void TestStageRateLimit () {
+    Pipeline<int> pipeline;
+    StageConfig limited;
+    limited.name = "limited";
+    limited.rate = 200;
+    limited.queue_capacity = 128;
+    StageConfig free;
+    free.name = "free";
+    std::atomic<int> done{0};
+    pipeline.AddStage(limited, [] (int&) { return true; })
+            .AddStage(free, [&done] (int&) { done++; return true; });
+    pipeline.start();
+    auto begin = steady_clock::now();
+    for (int i = 0; i < 60; i++) {
+        CHECK(pipeline.Submit(i));
+    }
+    while (done < 60 && steady_clock::now() - begin < seconds(5)) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    double elapsed = duration<double>(steady_clock::now() - begin).count();
+    pipeline.stop();
+    CHECK(done == 60);
+    CHECK(elapsed >= 0.2 && elapsed < 1.0);   // 约0.3秒
+    std::vector<StageStats> stats = pipeline.GetStats();
+    CHECK(stats.size() == 2);
+    CHECK(stats[0].processed == 60 && stats[1].processed == 60);
+    CHECK(stats[0].token_wait > milliseconds(100));
+    CHECK(stats[1].token_wait.count() == 0);
+}
+
+// 下游阶段卡住时，上游阻塞在put上，输入队列填满，TrySubmit失败；放行后所有元素都处理完
+static void TestBackpressure () {
+    Pipeline<int> pipeline;
+    std::atomic<bool> gate{false};
+    std::atomic<int> done{0};
+    StageConfig first;
+    first.queue_capacity = 2;
+    StageConfig second;
+    second.queue_capacity = 2;
+    pipeline.AddStage(first, [] (int&) { return true; })
+            .AddStage(second, [&] (int&) {
+                while (!gate.load()) {
+                    std::this_thread::sleep_for(milliseconds(1));
+                }
+                done++;
+                return true;
+            });
+    pipeline.start();
+    int accepted = 0;
+    auto deadline = steady_clock::now() + seconds(2);
+    for (int i = 0; steady_clock::now() < deadline; i++) {
+        int item = i;
+        if (pipeline.TrySubmit(item)) {
+            accepted++;
+        } else {
+            std::this_thread::sleep_for(milliseconds(20));
+            if (!pipeline.TrySubmit(item)) {
+                break;   // 等待之后仍然满：背压已传到入口
+            }
+            accepted++;
+        }
+    }
+    // 每级：队列2个 + 工作线程手上1个
+    CHECK(accepted >= 4 && accepted <= 6);
+    std::vector<StageStats> stats = pipeline.GetStats();
+    CHECK(stats[0].queue_depth == 2);
+    gate = true;
+    CHECK(Finishes([&pipeline] () { pipeline.stop(); }));
+    CHECK(done == accepted);
+    stats = pipeline.GetStats();
+    CHECK(stats[0].blocked_time > milliseconds(10));
+}
+
+// stop()处理完所有已提交的元素（包括被限速、还在队列中的），丢弃的元素不传给下游；停止后拒绝提交
+static void TestStopDrainsInFlight () {
+    Pipeline<int> pipeline;
+    StageConfig filter;
+    filter.queue_capacity = 256;
+    filter.workers = 2;
+    StageConfig sink;
+    sink.queue_capacity = 256;
+    sink.rate = 1000;
+    sink.workers = 3;
+    std::atomic<int> sum{0};
+    pipeline.AddStage(filter, [] (int& item) { return item % 2 == 0; })
+            .AddStage(sink, [&sum] (int& item) { sum += item; return true; });
+    pipeline.start();
+    int expected = 0;
+    for (int i = 0; i < 200; i++) {
+        CHECK(pipeline.Submit(i));
+        expected += i % 2 == 0 ? i : 0;
+    }
+    CHECK(Finishes([&pipeline] () { pipeline.stop(); }));
+    CHECK(sum == expected);
+    std::vector<StageStats> stats = pipeline.GetStats();
+    CHECK(stats[0].processed == 100 && stats[0].dropped == 100);
+    CHECK(stats[1].processed == 100);
+    CHECK(stats[0].queue_depth == 0 && stats[1].queue_depth == 0);
+    CHECK(!pipeline.Submit(1));
+    int item = 2;
+    CHECK(!pipeline.TrySubmit(item));
+}
+
+// 启动、运行和停止期间其他线程读取统计（在ThreadSanitizer下检查数据竞争）
+static void TestStatsWhileStopping () {
+    Pipeline<int> pipeline;
+    StageConfig config;
+    pipeline.AddStage(config, [] (int&) { return true; });
+    std::atomic<bool> reading{true};
+    std::thread reader([&] () {
+        while (reading) {
+            for (const StageStats& stats : pipeline.GetStats()) {
+                CHECK(stats.throughput >= 0);
+            }
+        }
+    });
+    std::this_thread::sleep_for(milliseconds(5));
+    pipeline.start();
+    for (int i = 0; i < 1000; i++) {
+        pipeline.Submit(i);
+    }
+    pipeline.stop();
+    reading = false;
+    reader.join();
+    CHECK(pipeline.GetStats()[0].processed == 1000);
+}
+
+int main () {
+    TestStageRateLimit();
+    TestBackpressure();
+    TestStopDrainsInFlight();
+    TestStatsWhileStopping();
+    return CheckResult("pipeline_test");
+}
@@ -0,0 +1,152 @@
+/**
+ * @file rate_controller_test.cpp
+ * @brief RateController测试：调整周期（含浮点误差）、AIMD的加性增大和乘性减小、速率上下限、Gradient的梯度截断
+ */
+
+#include "../rate_controller.h"
+#include "check.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace std::chrono;
+
+static bool Near (double a, double b) {
+    return std::fabs(a - b) < 1e-9 * std::max(1.0, std::fabs(b));
+}
+
+// 报告ok次成功和failed次失败
+static void Report (RateController& controller, int ok, int failed) {
+    for (int i = 0; i < ok; i++) {
+        controller.OnResult(true);
+    }
+    for (int i = 0; i < failed; i++) {
+        controller.OnResult(false);
+    }
+}
+
+// 距离上次调整不足一个调整周期时不调整，结果计数留到下一次
+static void TestAdjustInterval () {
+    RateControllerConfig config;
+    config.initial_rate = 10;
+    config.adjust_interval = milliseconds(100);
+    RateController controller(config);
+    CHECK(controller.AdjustInterval() == milliseconds(100));
+    Report(controller, 0, 1);
+    CHECK(!controller.Adjust(0.05, 1));
+    CHECK(controller.Rate() == 10);
+    CHECK(controller.Adjust(0.1, 1));    // 之前的失败仍然计入
+    CHECK(Near(controller.Rate(), 5));
+    CHECK(!controller.Adjust(0.15, 1));
+    CHECK(controller.Adjust(0.2, 1));
+    CHECK(Near(controller.Rate(), 6));   // 失败计数已经清零
+
+    // 按周期的整数倍驱动时每次都调整，浮点误差不会推迟一个周期
+    RateController periodic(config);
+    int adjusted = 0;
+    for (int i = 1; i <= 50; i++) {
+        adjusted += periodic.Adjust(i * 0.1, 0);
+    }
+    CHECK(adjusted == 50);
+}
+
+// AIMD：有积压且没有失败时加性增大，没有积压时不变，出现失败时乘性减小
+static void TestAimd () {
+    RateControllerConfig config;
+    config.initial_rate = 10;
+    config.additive_increase = 2;
+    config.multiplicative_decrease = 0.5;
+    RateController controller(config);
+    double now = 0;
+    auto step = [&controller, &now] (size_t waiters) {
+        now += 0.1;
+        return controller.Adjust(now, waiters);
+    };
+    Report(controller, 50, 0);
+    CHECK(step(3));
+    CHECK(Near(controller.Rate(), 12));
+    CHECK(step(3));
+    CHECK(Near(controller.Rate(), 14));
+    CHECK(step(0));                      // 没有积压：需求已经满足，不再试探
+    CHECK(Near(controller.Rate(), 14));
+    Report(controller, 100, 1);          // 一次失败就后退，即使有积压
+    CHECK(step(3));
+    CHECK(Near(controller.Rate(), 7));
+    Report(controller, 0, 5);            // 失败次数不影响后退的幅度
+    CHECK(step(0));
+    CHECK(Near(controller.Rate(), 3.5));
+}
+
+// 初始速率和每次调整的结果都截断到[min_rate, max_rate]
+static void TestBounds () {
+    RateControllerConfig config;
+    config.initial_rate = 1000;
+    config.min_rate = 1;
+    config.max_rate = 20;
+    config.additive_increase = 5;
+    config.multiplicative_decrease = 0.1;
+    RateController controller(config);
+    CHECK(controller.Rate() == 20);
+    CHECK(controller.Adjust(0.1, 10));
+    CHECK(controller.Rate() == 20);      // 已在上限
+    Report(controller, 0, 1);
+    CHECK(controller.Adjust(0.2, 10));
+    CHECK(Near(controller.Rate(), 2));
+    Report(controller, 0, 1);
+    CHECK(controller.Adjust(0.3, 10));
+    CHECK(controller.Rate() == 1);       // 0.2被截断到下限
+    Report(controller, 0, 1);
+    CHECK(controller.Adjust(0.4, 10));
+    CHECK(controller.Rate() == 1);
+
+    config.initial_rate = 0;
+    CHECK(RateController(config).Rate() == 1);
+}
+
+// Gradient：梯度 = 成功率/目标成功率，截断到[0.5, 1]；新速率 = 旧速率与目标速率按smoothing平滑
+static void TestGradient () {
+    RateControllerConfig config;
+    config.mode = RateControllerConfig::Mode::kGradient;
+    config.initial_rate = 100;
+    config.target_success = 0.99;
+    config.smoothing = 0.2;
+    config.backlog_headroom = 0.5;
+    RateController controller(config);
+    double now = 0;
+    auto step = [&controller, &now] (size_t waiters) {
+        now += 0.1;
+        return controller.Adjust(now, waiters);
+    };
+
+    CHECK(step(0));                      // 没有样本也没有积压：不变
+    CHECK(Near(controller.Rate(), 100));
+    Report(controller, 100, 0);
+    CHECK(step(0));                      // 全部成功（梯度截断到1）、没有积压：不变
+    CHECK(Near(controller.Rate(), 100));
+    Report(controller, 100, 0);
+    CHECK(step(4));                      // 全部成功且有积压：目标增加headroom
+    CHECK(Near(controller.Rate(), 100 * (0.8 + 0.2 * 1.5)));
+    CHECK(step(4));                      // 只有积压、没有样本时按成功率1处理
+    CHECK(Near(controller.Rate(), 110 * (0.8 + 0.2 * 1.5)));
+
+    RateController partial(config);
+    Report(partial, 90, 10);             // 梯度0.9/0.99，低于1时不加headroom
+    CHECK(partial.Adjust(0.1, 4));
+    CHECK(Near(partial.Rate(), 100 * (0.8 + 0.2 * (0.9 / 0.99))));
+
+    RateController failing(config);
+    Report(failing, 1, 9);               // 成功率0.1，梯度截断到0.5
+    CHECK(failing.Adjust(0.1, 4));
+    CHECK(Near(failing.Rate(), 100 * (0.8 + 0.2 * 0.5)));
+    Report(failing, 0, 10);              // 全部失败同样最多减半
+    CHECK(failing.Adjust(0.2, 0));
+    CHECK(Near(failing.Rate(), 90 * (0.8 + 0.2 * 0.5)));
+}
+
+int main () {
+    TestAdjustInterval();
+    TestAimd();
+    TestBounds();
+    TestGradient();
+    return CheckResult("rate_controller_test");
+}
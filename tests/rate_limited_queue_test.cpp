@@ -0,0 +1,177 @@
+/**
+ * @file rate_limited_queue_test.cpp
+ * @brief RateLimitedQueue测试：按成本分发、拒绝永远无法满足的任务、最大数量调小后队首不卡住队列、
+ *        低成本任务越过等待中的队首
+ */
+
+#include "../rate_limited_queue.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace std::chrono;
+
+// 等待直到cond为true，最多1秒
+template <typename F>
+static bool Eventually (F cond) {
+    auto deadline = steady_clock::now() + seconds(1);
+    while (!cond()) {
+        if (steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    return true;
+}
+
+// 任务在token足够后才能取出
+static void TestDispatchAfterFunding () {
+    auto manager = std::make_shared<TokenManager>(10);
+    RateLimitedQueue<int> queue(manager, 4);
+    CHECK(queue.put(1, 3));
+    int out = 0;
+    CHECK(!queue.try_get(out));
+    manager->AddTokens(3);
+    CHECK(queue.try_get(out));
+    CHECK(out == 1);
+    CHECK(manager->GetTokens() == 0);
+}
+
+// 成本超过最大数量的任务入队时被拒绝
+static void TestInfeasibleCostRejected () {
+    auto manager = std::make_shared<TokenManager>(5);
+    RateLimitedQueue<int> queue(manager, 4);
+    CHECK(!queue.put(1, 6));
+    int item = 2;
+    CHECK(!queue.try_put(std::move(item), 6));
+    CHECK(queue.size() == 0);
+    CHECK(Finishes([&queue] () { queue.close(); }));
+}
+
+// 入队后最大数量被调小：无法满足的队首被丢弃，后面的任务照常分发，close()和析构不挂住
+static void TestShrunkMaxDropsHead () {
+    auto manager = std::make_shared<TokenManager>(10);
+    auto queue = std::make_shared<RateLimitedQueue<int>>(manager, 4);
+    CHECK(queue->put(1, 8));   // 队首，预约8个token
+    CHECK(queue->put(2, 2));
+    manager->SetMaxTokens(5);  // 队首的预约已经在排队：留在TokenManager的队列中，直到最大数量恢复
+    int out = 0;
+    manager->AddTokens(2);
+    CHECK(!queue->try_get(out));
+    CHECK(Finishes([queue] () { queue->close(); }));
+
+    // 预约发出时已经无法满足：队首被丢弃，为下一个任务预约
+    auto manager2 = std::make_shared<TokenManager>(10);
+    RateLimitedQueue<int> queue2(manager2, 4);
+    manager2->AddTokens(10);
+    CHECK(queue2.put(1, 10));     // 立即满足，成为已扣除token的队首
+    CHECK(queue2.put(2, 8));
+    CHECK(queue2.put(3, 2));
+    manager2->SetMaxTokens(5);
+    CHECK(queue2.try_get(out));   // 取出1，为2预约时被拒绝，2被丢弃，改为3预约
+    CHECK(out == 1);
+    CHECK(queue2.size() == 1);
+    manager2->AddTokens(2);
+    CHECK(queue2.try_get(out));
+    CHECK(out == 3);
+    CHECK(Finishes([&queue2] () { queue2.close(); }));
+}
+
+// 关闭时退还已为队首扣除的token
+static void TestCloseRefunds () {
+    auto manager = std::make_shared<TokenManager>(10);
+    manager->AddTokens(4);
+    {
+        RateLimitedQueue<int> queue(manager, 4);
+        CHECK(queue.put(1, 4));
+        CHECK(manager->GetTokens() == 0);
+    }
+    CHECK(manager->GetTokens() == 4);
+    CHECK(manager->GetWaiters() == 0);
+}
+
+// 低成本任务越过等待token的队首，同一个队首最多被越过max_bypass次
+static void TestBypassHead () {
+    auto manager = std::make_shared<TokenManager>(10);
+    manager->AddTokens(3);
+    RateLimitedQueueConfig config;
+    config.allow_bypass = true;
+    config.max_bypass = 2;
+    RateLimitedQueue<int> queue(manager, 8, config);
+    CHECK(queue.put(1, 5));   // 队首：3个token不够，预约排队
+    CHECK(queue.put(2, 1));
+    CHECK(queue.put(3, 1));
+    CHECK(queue.put(4, 1));
+    CHECK(queue.put(5, 6));   // 成本不低于队首，不能越过
+    int out = 0;
+    CHECK(queue.try_get(out) && out == 2);
+    CHECK(queue.try_get(out) && out == 3);
+    CHECK(manager->GetTokens() == 1);
+    CHECK(!queue.try_get(out));          // 已越过2次
+    CHECK(manager->GetTokens() == 1);
+    manager->AddTokens(4);               // 队首凑满5个
+    CHECK(queue.try_get(out) && out == 1);
+    manager->AddTokens(1);               // 新队首4（成本1）
+    CHECK(queue.try_get(out) && out == 4);
+    CHECK(queue.size() == 1);
+    CHECK(!queue.try_get(out));          // 只剩队首5，没有可越过的任务
+}
+
+// 阻塞的get()在token增加时被唤醒并越过队首，不需要轮询
+static void TestBlockingGetBypassesOnRefill () {
+    auto manager = std::make_shared<TokenManager>(10);
+    RateLimitedQueueConfig config;
+    config.allow_bypass = true;
+    auto queue = std::make_shared<RateLimitedQueue<int>>(manager, 8, config);
+    CHECK(queue->put(1, 5));
+    CHECK(queue->put(2, 1));
+    CHECK(manager->GetWatchers() == 1);
+    std::atomic<int> got{0};
+    std::thread consumer([&] () {
+        int out = 0;
+        if (queue->get(out)) {
+            got = out;
+        }
+    });
+    std::this_thread::sleep_for(milliseconds(20));
+    CHECK(got == 0);
+    manager->AddTokens(1);
+    CHECK(Eventually([&] () { return got == 2; }));
+    CHECK(Finishes([&consumer] () { consumer.join(); }));
+    CHECK(Finishes([queue] () { queue->close(); }));
+    CHECK(manager->GetWatchers() == 0);
+    CHECK(manager->GetWaiters() == 0);
+}
+
+// TokenManager被共享时不越过其他调用方排在前面的请求
+static void TestBypassDoesNotOvertakeOthers () {
+    auto manager = std::make_shared<TokenManager>(10);
+    manager->AddTokens(2);
+    bool other = false;
+    CHECK(manager->ConsumeTokensAsync(4, [&other] () { other = true; }) != 0);
+    RateLimitedQueueConfig config;
+    config.allow_bypass = true;
+    RateLimitedQueue<int> queue(manager, 8, config);
+    CHECK(queue.put(1, 5));
+    CHECK(queue.put(2, 1));
+    int out = 0;
+    CHECK(!queue.try_get(out));
+    CHECK(manager->GetTokens() == 2);
+    manager->AddTokens(2);
+    CHECK(other);
+    manager->AddTokens(1);
+    CHECK(queue.try_get(out) && out == 2);   // 现在队首的预约在最前面
+}
+
+int main () {
+    TestDispatchAfterFunding();
+    TestInfeasibleCostRejected();
+    TestShrunkMaxDropsHead();
+    TestCloseRefunds();
+    TestBypassHead();
+    TestBlockingGetBypassesOnRefill();
+    TestBypassDoesNotOvertakeOthers();
+    return CheckResult("rate_limited_queue_test");
+}
@@ -0,0 +1,124 @@
+/**
+ * @file refill_scheduler_test.cpp
+ * @brief RefillScheduler测试：补充速率、参数校验、在token回调中重入调度器、
+ *        自适应调整不覆盖锁外期间的SetRate
+ */
+
+#include "../refill_scheduler.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace std::chrono;
+
+static void TestRejectsInvalidArguments () {
+    RefillScheduler scheduler;
+    auto manager = std::make_shared<TokenManager>(10);
+    CHECK(scheduler.Register(manager, nanoseconds(0)) == 0);
+    CHECK(scheduler.Register(manager, milliseconds(1), 0) == 0);
+    CHECK(scheduler.Register(manager, 0.0) == 0);
+    CHECK(scheduler.Register(manager, -5.0) == 0);
+    CHECK(scheduler.Size() == 0);
+    auto id = scheduler.Register(manager, 100.0);
+    CHECK(id != 0);
+    CHECK(!scheduler.SetRate(id, 0.0));
+    CHECK(scheduler.SetRate(id, 200.0));
+}
+
+static void TestRefillRate () {
+    RefillScheduler scheduler;
+    auto manager = std::make_shared<TokenManager>(1000000);
+    scheduler.Register(manager, 2000.0, 1);
+    scheduler.start();
+    std::this_thread::sleep_for(milliseconds(500));
+    scheduler.stop();
+    size_t tokens = manager->GetTokens();
+    CHECK(tokens >= 700 && tokens <= 1100);  // 约1000，留出调度误差
+}
+
+// 异步请求的回调在调度线程上运行，回调中修改和取消补充任务不能死锁
+static void TestReentrantCallbacks () {
+    auto scheduler = std::make_shared<RefillScheduler>();
+    auto manager = std::make_shared<TokenManager>(100);
+    auto id = scheduler->Register(manager, 1000.0);
+    std::atomic<int> grants{0};
+    std::atomic<bool> cancelled{false};
+    std::function<void()> again;
+    again = [&] () {
+        int n = ++grants;
+        scheduler->SetRate(id, 500.0 + n);
+        if (n == 20) {
+            cancelled = scheduler->Cancel(id);
+            return;
+        }
+        manager->ConsumeTokensAsync(5, again);
+    };
+    manager->ConsumeTokensAsync(5, again);
+    scheduler->start();
+    auto deadline = steady_clock::now() + seconds(5);
+    while (!cancelled && steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(milliseconds(10));
+    }
+    CHECK(cancelled);
+    CHECK(grants == 20);
+    // 取消返回之后不再补充
+    std::this_thread::sleep_for(milliseconds(20));
+    size_t tokens = manager->GetTokens();
+    std::this_thread::sleep_for(milliseconds(50));
+    CHECK(manager->GetTokens() == tokens);
+    scheduler->stop();
+}
+
+// 其他线程的Cancel返回之后不再补充
+static void TestCancelStopsRefill () {
+    RefillScheduler scheduler;
+    auto manager = std::make_shared<TokenManager>(1000000);
+    auto id = scheduler.Register(manager, 100000.0);
+    scheduler.start();
+    std::this_thread::sleep_for(milliseconds(30));
+    CHECK(scheduler.Cancel(id));
+    size_t tokens = manager->GetTokens();
+    std::this_thread::sleep_for(milliseconds(30));
+    CHECK(manager->GetTokens() == tokens);
+    CHECK(tokens > 0);
+    scheduler.stop();
+}
+
+// token回调中的SetRate发生在自适应调整的快照之后：过期的调整被跳过，不会把速率起点退回到快照时刻。
+// 否则累计量变成负数，转换为uint64_t后一次补充整个burst
+static void TestSetRateDuringAdjustment () {
+    auto scheduler = std::make_shared<RefillScheduler>();
+    auto manager = std::make_shared<TokenManager>(1000000000);
+    RateControllerConfig config;
+    config.initial_rate = 1000.0;
+    config.adjust_interval = milliseconds(0);   // 每一轮都调整
+    auto controller = std::make_shared<RateController>(config);
+    auto id = scheduler->Register(manager, config.initial_rate, 1000000, controller);
+    std::atomic<bool> changed{false};
+    manager->ConsumeTokensAsync(1, [&] () {
+        std::this_thread::sleep_for(milliseconds(5));   // 让SetRate明显晚于本轮的快照
+        scheduler->SetRate(id, 10000.0);
+        changed = true;
+    });
+    scheduler->start();
+    auto deadline = steady_clock::now() + seconds(5);
+    while (!changed && steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    CHECK(changed);
+    std::this_thread::sleep_for(milliseconds(100));
+    scheduler->stop();
+    size_t tokens = manager->GetTokens();
+    CHECK(tokens >= 50 && tokens < 10000);   // 约100个，外加新速率生效的几个tick
+}
+
+int main () {
+    TestRejectsInvalidArguments();
+    TestRefillRate();
+    TestReentrantCallbacks();
+    TestCancelStopsRefill();
+    TestSetRateDuringAdjustment();
+    return CheckResult("refill_scheduler_test");
+}
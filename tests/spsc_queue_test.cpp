@@ -0,0 +1,132 @@
+/**
+ * @file spsc_queue_test.cpp
+ * @brief SpscQueue测试：容量和FIFO、剩余元素的析构、休眠的一端被对方唤醒、
+ *        一个生产者一个消费者并发下严格按顺序且不丢不重（休眠没有超时，丢失唤醒会挂住）
+ */
+
+#include "../spsc_queue.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+static void TestBasic () {
+    SpscQueue<int> queue(3);
+    CHECK(queue.capacity() == 4);
+    for (int i = 0; i < 4; i++) {
+        CHECK(queue.try_put(i));
+    }
+    CHECK(!queue.try_put(4));
+    CHECK(queue.size() == 4);
+    int out = -1;
+    for (int i = 0; i < 4; i++) {
+        CHECK(queue.try_get(out) && out == i);
+    }
+    CHECK(!queue.try_get(out));
+    for (int i = 0; i < 100; i++) {
+        queue.put(i);
+        CHECK(queue.get() == i);
+    }
+    CHECK(queue.size() == 0);
+}
+
+// 析构时销毁队列中剩余的元素：通过shared_ptr的引用计数检查
+static void TestDestroysRemaining () {
+    auto tracked = std::make_shared<int>(0);
+    {
+        SpscQueue<std::shared_ptr<int>> queue(4);
+        for (int i = 0; i < 3; i++) {
+            queue.put(tracked);
+        }
+        std::shared_ptr<int> out;
+        CHECK(queue.try_get(out) && out == tracked);
+        CHECK(tracked.use_count() == 4);
+    }
+    CHECK(tracked.use_count() == 1);
+}
+
+// 空队列上休眠的消费者由put唤醒，满队列上休眠的生产者由get唤醒
+static void TestParkedSideWakes () {
+    SpscQueue<int> queue(2);
+    std::atomic<int> got{-1};
+    std::thread consumer([&] () { got = queue.get(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));   // 早已超过自旋次数
+    CHECK(got == -1);
+    queue.put(7);
+    CHECK(Finishes([&consumer] () { consumer.join(); }));
+    CHECK(got == 7);
+
+    CHECK(queue.try_put(1) && queue.try_put(2));
+    std::atomic<bool> put{false};
+    std::thread producer([&] () {
+        queue.put(3);
+        put = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(!put);
+    CHECK(queue.get() == 1);
+    CHECK(Finishes([&producer] () { producer.join(); }));
+    CHECK(put);
+    CHECK(queue.get() == 2 && queue.get() == 3);
+}
+
+// 容量16、一百万个元素：消费者按顺序收到每一个；两端都混用阻塞和非阻塞接口，频繁满/空走休眠路径
+static void TestConcurrent () {
+    const uint64_t count = 1000000;
+    SpscQueue<uint64_t> queue(16);
+    bool ordered = true;
+    uint64_t received = 0;
+    std::thread consumer([&queue, &ordered, &received] () {
+        for (uint64_t expect = 0; expect < count; expect++) {
+            uint64_t value;
+            if (expect % 3 == 0 || !queue.try_get(value)) {
+                value = queue.get();
+            }
+            ordered = ordered && value == expect;
+            received++;
+        }
+    });
+    std::thread producer([&queue] () {
+        for (uint64_t i = 0; i < count; i++) {
+            if (i % 2 == 0 || !queue.try_put(i)) {
+                queue.put(i);
+            }
+        }
+    });
+    CHECK(Finishes([&producer, &consumer] () {
+        producer.join();
+        consumer.join();
+    }, std::chrono::seconds(60)));
+    CHECK(ordered);
+    CHECK(received == count);
+    CHECK(queue.size() == 0);
+}
+
+// 非平凡类型的元素跨线程移动
+static void TestConcurrentStrings () {
+    const int count = 20000;
+    SpscQueue<std::string> queue(8);
+    bool ordered = true;
+    std::thread consumer([&queue, &ordered] () {
+        for (int i = 0; i < count; i++) {
+            ordered = ordered && queue.get() == std::string(40, 'a' + i % 26) + std::to_string(i);
+        }
+    });
+    for (int i = 0; i < count; i++) {
+        queue.put(std::string(40, 'a' + i % 26) + std::to_string(i));
+    }
+    CHECK(Finishes([&consumer] () { consumer.join(); }, std::chrono::seconds(60)));
+    CHECK(ordered);
+}
+
+int main () {
+    TestBasic();
+    TestDestroysRemaining();
+    TestParkedSideWakes();
+    TestConcurrent();
+    TestConcurrentStrings();
+    return CheckResult("spsc_queue_test");
+}
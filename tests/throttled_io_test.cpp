@@ -0,0 +1,149 @@
+/**
+ * @file throttled_io_test.cpp
+ * @brief ThrottledIo测试：短写、EAGAIN、短读和EOF时退回未用完的预算，Stop打断等待时退回已取得的部分
+ */
+
+#include "../throttled_io.h"
+#include "check.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std::chrono;
+
+// 非阻塞的管道，写端缓冲区尽量小；返回缓冲区大小
+static size_t SmallPipe (int fds[2]) {
+    if (pipe2(fds, O_NONBLOCK) != 0) {
+        return 0;
+    }
+    int size = fcntl(fds[1], F_SETPIPE_SZ, 4096);
+    return size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+// 管道只能写入一部分：写入的字节从桶中扣除，其余退回；随后的EAGAIN不扣除任何预算
+static void TestShortWriteRefunds () {
+    int fds[2];
+    size_t pipe_size = SmallPipe(fds);
+    CHECK(pipe_size > 0);
+    auto bucket = std::make_shared<TokenManager>(1000000);
+    bucket->AddTokens(100000);
+    ThrottleConfig config;
+    config.min_chunk = 1;
+    ThrottledIo io(bucket, config);
+    std::vector<char> data(50000, 'x');
+    ssize_t n = io.Write(fds[1], data.data(), data.size());
+    CHECK(n == static_cast<ssize_t>(pipe_size));
+    CHECK(bucket->GetTokens() == 100000 - pipe_size);
+    ThrottleStats stats = io.GetStats();
+    CHECK(stats.bytes == pipe_size);
+    CHECK(stats.syscalls == 2);   // 一次短写，一次EAGAIN
+
+    // 管道已满：一个字节都写不进去时返回-1/EAGAIN，预算全部退回
+    n = io.Write(fds[1], data.data(), data.size());
+    CHECK(n == -1 && errno == EAGAIN);
+    CHECK(bucket->GetTokens() == 100000 - pipe_size);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// 聚集写入的短写：写出的是各缓冲区拼接后的前缀，未写出的部分退回
+static void TestShortWritevRefunds () {
+    int fds[2];
+    size_t pipe_size = SmallPipe(fds);
+    CHECK(pipe_size > 0);
+    auto bucket = std::make_shared<TokenManager>(1000000);
+    bucket->AddTokens(30000);
+    ThrottleConfig config;
+    config.min_chunk = 1;
+    ThrottledIo io(bucket, config);
+    std::string parts[3] = {std::string(3000, 'a'), std::string(3000, 'b'), std::string(3000, 'c')};
+    iovec iov[3];
+    for (int i = 0; i < 3; i++) {
+        iov[i] = iovec{&parts[i][0], parts[i].size()};
+    }
+    ssize_t n = io.Writev(fds[1], iov, 3);
+    CHECK(n == static_cast<ssize_t>(std::min<size_t>(pipe_size, 9000)));
+    CHECK(bucket->GetTokens() == 30000 - static_cast<size_t>(n));
+    std::string expected = (parts[0] + parts[1] + parts[2]).substr(0, static_cast<size_t>(n));
+    std::string got(static_cast<size_t>(n), '\0');
+    CHECK(read(fds[0], &got[0], got.size()) == n);
+    CHECK(got == expected);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// 短读和EOF：只扣除实际读到的字节
+static void TestShortReadRefunds () {
+    int fds[2];
+    CHECK(SmallPipe(fds) > 0);
+    auto bucket = std::make_shared<TokenManager>(1000000);
+    bucket->AddTokens(5000);
+    ThrottleConfig config;
+    config.min_chunk = 1;
+    ThrottledIo io(bucket, config);
+    CHECK(write(fds[1], "hello", 5) == 5);
+    char buf[1000];
+    CHECK(io.Read(fds[0], buf, sizeof(buf)) == 5);
+    CHECK(std::memcmp(buf, "hello", 5) == 0);
+    CHECK(bucket->GetTokens() == 4995);
+    close(fds[1]);
+    CHECK(io.Read(fds[0], buf, sizeof(buf)) == 0);   // EOF
+    CHECK(bucket->GetTokens() == 4995);
+    CHECK(io.GetStats().bytes == 5);
+    close(fds[0]);
+}
+
+// 预算不足最小分片时等待；Stop打断等待，已取得的部分退回，返回-1/ECANCELED
+static void TestStopRefundsPartialBudget () {
+    int fd = open("/dev/null", O_WRONLY);
+    CHECK(fd >= 0);
+    auto bucket = std::make_shared<TokenManager>(100000);
+    bucket->AddTokens(10);
+    ThrottleConfig config;
+    config.min_chunk = 100;
+    ThrottledIo io(bucket, config);
+    std::vector<char> data(1000, 'x');
+    ssize_t n = 0;
+    int err = 0;
+    std::thread writer([&] () {
+        n = io.Write(fd, data.data(), data.size());
+        err = errno;
+    });
+    std::this_thread::sleep_for(milliseconds(50));
+    io.Stop();
+    CHECK(Finishes([&writer] () { writer.join(); }));
+    CHECK(n == -1 && err == ECANCELED);
+    CHECK(bucket->GetTokens() == 10);
+    CHECK(bucket->GetWaiters() == 0);
+    CHECK(io.GetStats().syscalls == 0);
+    close(fd);
+}
+
+// 对照：预算足够时一次写完，全部扣除
+static void TestFullWriteConsumes () {
+    int fd = open("/dev/null", O_WRONLY);
+    CHECK(fd >= 0);
+    auto bucket = std::make_shared<TokenManager>(100000);
+    bucket->AddTokens(100000);
+    ThrottledIo io(bucket);
+    std::vector<char> data(40000, 'x');
+    CHECK(io.Write(fd, data.data(), data.size()) == 40000);
+    CHECK(bucket->GetTokens() == 60000);
+    CHECK(io.GetStats().syscalls == 1);
+    close(fd);
+}
+
+int main () {
+    TestShortWriteRefunds();
+    TestShortWritevRefunds();
+    TestShortReadRefunds();
+    TestStopRefundsPartialBudget();
+    TestFullWriteConsumes();
+    return CheckResult("throttled_io_test");
+}
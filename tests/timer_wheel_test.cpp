@@ -0,0 +1,107 @@
+/**
+ * @file timer_wheel_test.cpp
+ * @brief TimerWheel测试：各层的到期时间、跨层降级、取消、改期和过期ID
+ */
+
+#include "../timer_wheel.h"
+#include "check.h"
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// 到期时间覆盖第0层、第1~3层的边界和超出表示范围的跨度
+static void TestCascadeAcrossLevels () {
+    const std::vector<uint64_t> deltas = {
+        0, 1, 255, 256, 257, 300, 16383, 16384, 16385, 70000,
+        (uint64_t(1) << 20) - 1, uint64_t(1) << 20, (uint64_t(1) << 20) + 7,
+        (uint64_t(1) << 26) - 1, uint64_t(1) << 26, (uint64_t(1) << 26) + 12345,
+    };
+    for (uint64_t start : {uint64_t(0), uint64_t(200), uint64_t(1) << 30}) {
+        TimerWheel<uint64_t> wheel(start);
+        for (uint64_t delta : deltas) {
+            wheel.Schedule(start + delta, start + delta);
+        }
+        CHECK(wheel.Size() == deltas.size());
+        std::map<uint64_t, int> fired;  // 期望的tick -> 次数
+        uint64_t last = start + deltas.back();
+        // 按NextExpiry跳跃推进，与RefillScheduler的用法相同
+        while (!wheel.Empty()) {
+            uint64_t next = wheel.NextExpiry();
+            CHECK(next <= last);
+            wheel.Advance(next, [&](TimerWheel<uint64_t>::TimerId, uint64_t& want, uint64_t tick) -> uint64_t {
+                CHECK(tick == want);
+                fired[want]++;
+                return 0;
+            });
+            if (next > last) {
+                break;
+            }
+        }
+        CHECK(fired.size() == deltas.size());
+        for (const auto& entry : fired) {
+            CHECK(entry.second == 1);
+        }
+    }
+}
+
+// 一次推进很长的区间（跳过多圈），每个定时器仍然恰好触发一次
+static void TestLongAdvance () {
+    TimerWheel<int> wheel;
+    for (int i = 0; i < 1000; i++) {
+        wheel.Schedule(static_cast<uint64_t>(i) * 997, i);
+    }
+    std::vector<int> count(1000, 0);
+    wheel.Advance(1000 * 997, [&](TimerWheel<int>::TimerId, int& i, uint64_t tick) -> uint64_t {
+        CHECK(tick == static_cast<uint64_t>(i) * 997);
+        count[i]++;
+        return 0;
+    });
+    for (int c : count) {
+        CHECK(c == 1);
+    }
+    CHECK(wheel.Empty());
+}
+
+// 周期任务按返回的绝对tick重新挂入
+static void TestPeriodic () {
+    TimerWheel<int> wheel;
+    wheel.Schedule(0, 0);
+    std::vector<uint64_t> ticks;
+    wheel.Advance(1000, [&](TimerWheel<int>::TimerId, int&, uint64_t tick) -> uint64_t {
+        ticks.push_back(tick);
+        return tick + 300;
+    });
+    CHECK((ticks == std::vector<uint64_t>{0, 300, 600, 900}));
+    CHECK(wheel.Size() == 1);
+}
+
+static void TestCancelAndReschedule () {
+    TimerWheel<int> wheel;
+    auto a = wheel.Schedule(10, 1);
+    auto b = wheel.Schedule(20000, 2);
+    auto c = wheel.Schedule(30, 3);
+    CHECK(wheel.Cancel(a));
+    CHECK(!wheel.Cancel(a));
+    CHECK(wheel.Reschedule(b, 40));
+    CHECK(wheel.Get(c) && *wheel.Get(c) == 3);
+    std::vector<int> order;
+    wheel.Advance(100, [&](TimerWheel<int>::TimerId, int& v, uint64_t) -> uint64_t {
+        order.push_back(v);
+        return 0;
+    });
+    CHECK((order == std::vector<int>{3, 2}));
+    // 节点被重用后，旧ID不能访问新定时器
+    auto d = wheel.Schedule(200, 4);
+    CHECK(!wheel.Get(c));
+    CHECK(!wheel.Cancel(b));
+    CHECK(wheel.Get(d) && *wheel.Get(d) == 4);
+    CHECK(!wheel.Get(TimerWheel<int>::kInvalidTimer));
+}
+
+int main () {
+    TestCascadeAcrossLevels();
+    TestLongAdvance();
+    TestPeriodic();
+    TestCancelAndReschedule();
+    return CheckResult("timer_wheel_test");
+}
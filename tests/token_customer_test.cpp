@@ -0,0 +1,81 @@
+/**
+ * @file token_customer_test.cpp
+ * @brief TokenCustomer测试：每次消费的数量超过最大数量时，各种运行模式都结束消费者而不是挂住stop()
+ */
+
+#include "../token_customer.h"
+#include "check.h"
+#include <chrono>
+#include <memory>
+
+using namespace std::chrono;
+
+// 线程池模式：请求被拒绝时结束在途状态，stop()立即返回
+static void TestExecutorRejected () {
+    auto executor = std::make_shared<WorkStealingExecutor>(1);
+    executor->start();
+    auto manager = std::make_shared<TokenManager>(5);
+    manager->AddTokens(5);
+    TokenCustomer customer(manager, 10, executor);
+    CHECK(Finishes([&customer] () {
+        customer.start();
+        customer.stop();
+    }));
+    CustomerStats stats = customer.GetStats();
+    CHECK(!stats.running);
+    CHECK(stats.grants == 0);
+    CHECK(manager->GetTokens() == 5);
+    CHECK(manager->GetWaiters() == 0);
+    executor->stop();
+}
+
+// 注入时钟的独立线程模式：请求被拒绝时消费线程退出
+static void TestClockRejected () {
+    auto clock = std::make_shared<VirtualClock>();
+    auto manager = std::make_shared<TokenManager>(5);
+    TokenCustomer customer(manager, 10);
+    customer.SetClock(clock);
+    CHECK(Finishes([&customer] () {
+        customer.start();
+        customer.stop();
+    }));
+    CHECK(customer.GetStats().grants == 0);
+    CHECK(manager->GetWaiters() == 0);
+}
+
+// 普通独立线程模式（ConsumeTokensWithStopCheck立即返回false）
+static void TestThreadRejected () {
+    auto manager = std::make_shared<TokenManager>(5);
+    TokenCustomer customer(manager, 10);
+    CHECK(Finishes([&customer] () {
+        customer.start();
+        customer.stop();
+    }));
+    CHECK(customer.GetStats().grants == 0);
+}
+
+// 对照：可以满足的请求在线程池上正常消费
+static void TestExecutorConsumes () {
+    auto executor = std::make_shared<WorkStealingExecutor>(1);
+    executor->start();
+    auto manager = std::make_shared<TokenManager>(10);
+    TokenCustomer customer(manager, 2, executor);
+    customer.start();
+    manager->AddTokens(6);
+    auto deadline = steady_clock::now() + seconds(2);
+    while (customer.GetStats().grants < 3 && steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    CHECK(Finishes([&customer] () { customer.stop(); }));
+    CHECK(customer.GetStats().grants == 3);
+    CHECK(manager->GetTokens() == 0);
+    executor->stop();
+}
+
+int main () {
+    TestExecutorRejected();
+    TestClockRejected();
+    TestThreadRejected();
+    TestExecutorConsumes();
+    return CheckResult("token_customer_test");
+}
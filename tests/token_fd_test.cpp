@@ -0,0 +1,98 @@
+/**
+ * @file token_fd_test.cpp
+ * @brief TokenEventFd测试：就绪通知、取消、永远无法满足的请求不会挂住析构；
+ *        RefillTimerFd的最短唤醒间隔为0时定时器仍然周期触发
+ */
+
+#include "../token_fd.h"
+#include "check.h"
+#include <memory>
+#include <poll.h>
+#include <vector>
+
+static bool Readable (int fd) {
+    pollfd pfd{fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) == 1;
+}
+
+// token到达后fd可读，Drain取出标签
+static void TestReadyAfterRefill () {
+    auto manager = std::make_shared<TokenManager>(10);
+    TokenEventFd events;
+    uint64_t handle = events.Arm(manager, 3, 42);
+    CHECK(handle != 0 && handle != TokenEventFd::kRejected);
+    CHECK(!Readable(events.fd()));
+    manager->AddTokens(3);
+    CHECK(Readable(events.fd()));
+    std::vector<uint64_t> tags;
+    CHECK(events.Drain(tags) == 1);
+    CHECK(tags.size() == 1 && tags[0] == 42);
+    CHECK(events.Pending() == 0);
+
+    // token足够时立即就绪
+    manager->AddTokens(2);
+    CHECK(events.Arm(manager, 2, 7) == 0);
+    tags.clear();
+    CHECK(events.Drain(tags) == 1 && tags[0] == 7);
+}
+
+// 超过最大数量的请求被拒绝：不留占位，析构不等待它
+static void TestRejectedRequest () {
+    auto manager = std::make_shared<TokenManager>(5);
+    CHECK(Finishes([manager] () {
+        TokenEventFd events;
+        CHECK(events.Arm(manager, 6, 1) == TokenEventFd::kRejected);
+        CHECK(events.Pending() == 0);
+        CHECK(!Readable(events.fd()));
+    }));
+    CHECK(manager->GetWaiters() == 0);
+}
+
+// 取消排队中的请求，析构时取消剩下的请求
+static void TestCancel () {
+    auto manager = std::make_shared<TokenManager>(10);
+    {
+        TokenEventFd events;
+        uint64_t first = events.Arm(manager, 4, 1);
+        events.Arm(manager, 4, 2);
+        CHECK(events.Pending() == 2);
+        CHECK(events.Cancel(first));
+        CHECK(!events.Cancel(first));
+        CHECK(events.Pending() == 1);
+    }
+    CHECK(manager->GetWaiters() == 0);
+    manager->AddTokens(4);
+    CHECK(manager->GetTokens() == 4);
+}
+
+// min_interval为0、速率达到上限时唤醒间隔仍至少1ns，定时器没有被全零的it_value解除
+static void TestRefillTimerZeroMinInterval () {
+    auto manager = std::make_shared<TokenManager>(1000000);
+    ProducerConfig config;
+    config.rate = 1e12;
+    config.min_interval = std::chrono::nanoseconds(0);
+    RefillTimerFd timer(manager, config);
+    timer.start();
+    CHECK(timer.Interval() >= std::chrono::nanoseconds(1));
+    pollfd pfd{timer.fd(), POLLIN, 0};
+    CHECK(poll(&pfd, 1, 1000) == 1);
+    CHECK(timer.OnReadable() > 0);
+
+    config.min_interval = std::chrono::nanoseconds(-5);
+    RefillTimerFd negative(manager, config);
+    negative.start();
+    negative.SetRate(1e12);
+    CHECK(negative.Interval() >= std::chrono::nanoseconds(1));
+    pfd.fd = negative.fd();
+    CHECK(poll(&pfd, 1, 1000) == 1);
+    negative.stop();
+    timer.stop();
+}
+
+int main () {
+    TestReadyAfterRefill();
+    TestRejectedRequest();
+    TestCancel();
+    TestRefillTimerZeroMinInterval();
+    return CheckResult("token_fd_test");
+}
@@ -0,0 +1,339 @@
+/**
+ * @file token_manager_test.cpp
+ * @brief TokenManager测试：FIFO规则（阻塞等待者、异步请求和非阻塞获取）、透支与拒绝、计数宽度和排队策略、
+ *        AdaptiveWait的唤醒、停止标志和自旋/睡眠的切换
+ */
+
+#include "../token_manager.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace std::chrono;
+
+// 等待直到cond为true，最多1秒
+template <typename F>
+static bool Eventually (F cond) {
+    auto deadline = steady_clock::now() + seconds(1);
+    while (!cond()) {
+        if (steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    return true;
+}
+
+// 有排队的请求时，非阻塞获取不插队
+static void TestTryDoesNotOvertakeQueue () {
+    TokenManager manager(10);
+    manager.AddTokens(3);
+    bool fired = false;
+    uint64_t id = manager.ConsumeTokensAsync(5, [&] () { fired = true; });
+    CHECK(id != 0);
+    CHECK(!manager.TryConsumeTokens(1));
+    CHECK(manager.TryConsumeUpTo(3) == 0);
+    manager.AddTokens(2);
+    CHECK(fired);
+    CHECK(manager.TryConsumeTokens(0));
+    CHECK(manager.GetTokens() == 0);
+}
+
+// 只能越过自己排队的请求，不能越过排在前面的其他请求
+static void TestTryAheadOfOwnRequest () {
+    TokenManager manager(10);
+    manager.AddTokens(3);
+    bool fired = false;
+    uint64_t mine = manager.ConsumeTokensAsync(5, [&] () { fired = true; });
+    bool other_fired = false;
+    uint64_t other = manager.ConsumeTokensAsync(4, [&] () { other_fired = true; });
+    CHECK(mine != 0 && other != 0);
+    CHECK(!manager.TryConsumeTokensAhead(1, other));   // 前面还有mine
+    CHECK(manager.TryConsumeTokensAhead(1, mine));
+    CHECK(manager.GetTokens() == 2);
+    CHECK(!manager.TryConsumeTokensAhead(3, mine));    // token不足
+    CHECK(manager.CancelAsync(mine));
+    CHECK(!manager.TryConsumeTokensAhead(1, mine));    // 现在队首是other
+    manager.AddTokens(2);
+    CHECK(other_fired && !fired);
+    CHECK(manager.TryConsumeTokensAhead(0, mine));     // 队列已空，等同于TryConsumeTokens
+}
+
+// 阻塞等待者和异步请求按到达顺序分配
+static void TestBlockingAndAsyncShareOneQueue () {
+    TokenManager manager(10);
+    std::atomic<bool> first{false};
+    std::thread blocking([&] () {
+        CHECK(manager.ConsumeTokens(3));
+        first = true;
+    });
+    CHECK(Eventually([&] () { return manager.GetWaiters() == 1; }));
+    std::atomic<bool> second{false};
+    manager.ConsumeTokensAsync(1, [&] () { second = true; });
+    manager.AddTokens(1);  // 只够第二个请求，但它排在后面
+    std::this_thread::sleep_for(milliseconds(20));
+    CHECK(!first && !second);
+    manager.AddTokens(2);  // 交给队首的阻塞等待者
+    blocking.join();
+    CHECK(first && !second);
+    manager.AddTokens(1);
+    CHECK(second);
+    CHECK(manager.GetTokens() == 0);
+    CHECK(manager.GetWaiters() == 0);
+}
+
+// 被停止的阻塞等待者离开队列，后面的请求随即可以满足
+static void TestStoppedWaiterLeavesQueue () {
+    TokenManager manager(10);
+    std::atomic<bool> stop{false};
+    std::thread blocking([&] () { CHECK(!manager.ConsumeTokensWithStopCheck(8, &stop)); });
+    CHECK(Eventually([&] () { return manager.GetWaiters() == 1; }));
+    bool fired = false;
+    manager.ConsumeTokensAsync(2, [&] () { fired = true; });
+    manager.AddTokens(2);
+    CHECK(!fired);
+    stop = true;
+    blocking.join();
+    CHECK(fired);
+    CHECK(manager.GetWaiters() == 0);
+}
+
+// 上限调小后无法满足的请求被跳过，调回后恢复原来的位置
+static void TestInfeasibleRequestDoesNotBlockQueue () {
+    TokenManager manager(10);
+    bool big = false;
+    bool small = false;
+    uint64_t id = manager.ConsumeTokensAsync(8, [&] () { big = true; });
+    manager.ConsumeTokensAsync(2, [&] () { small = true; });
+    manager.SetMaxTokens(5);
+    manager.AddTokens(2);
+    CHECK(!big && small);
+    CHECK(manager.TryConsumeTokens(0));
+    manager.SetMaxTokens(10);
+    CHECK(!manager.TryConsumeTokens(1));  // 大请求回到队列中
+    manager.AddTokens(10);
+    CHECK(big);
+    CHECK(!manager.CancelAsync(id));
+}
+
+// 非阻塞获取的紧密循环不会让排队的请求饿死
+static void TestQueuedRequestNotStarved () {
+    TokenManager manager(100);
+    std::atomic<bool> stop{false};
+    std::atomic<int> grants{0};
+    std::thread spinner([&] () {
+        while (!stop) {
+            manager.TryConsumeTokens(1);
+        }
+    });
+    std::thread producer([&] () {
+        while (!stop) {
+            manager.AddTokens(1);
+            std::this_thread::sleep_for(microseconds(50));
+        }
+    });
+    for (int i = 0; i < 20; i++) {
+        manager.ConsumeTokensAsync(5, [&] () { grants++; });
+        int want = i + 1;
+        CHECK(Eventually([&] () { return grants == want; }));
+    }
+    stop = true;
+    spinner.join();
+    producer.join();
+    CHECK(grants == 20);
+}
+
+// 超过最大数量的请求立即失败，不会永久等待
+static void TestInfeasibleRequestRejected () {
+    TokenManager manager(5);
+    manager.AddTokens(5);
+    bool called = false;
+    CHECK(manager.ConsumeTokensAsync(6, [&called] () { called = true; }) == TokenManager::kRejected);
+    CHECK(!called);
+    CHECK(!manager.Feasible(6));
+    CHECK(!manager.ConsumeTokens(6));
+    std::atomic<bool> stop{false};
+    CHECK(!manager.ConsumeTokensWithStopCheck(6, &stop));
+    CHECK(manager.GetTokens() == 5);  // 被拒绝的请求不扣除任何token
+    CHECK(manager.GetWaiters() == 0);
+}
+
+// 透支模式：大请求在桶满时放行，欠账先于桶中的token偿还，还清之前其他请求等待
+static void TestDebtRepayment () {
+    TokenManager manager(5);
+    manager.SetDebtMode(true);
+    CHECK(manager.Feasible(8));
+    bool big = false;
+    CHECK(manager.ConsumeTokensAsync(8, [&big] () { big = true; }) != 0);
+    CHECK(!big);                            // 桶不满，大请求排队
+    manager.AddTokens(5);
+    CHECK(big);                             // 桶满时放行
+    CHECK(manager.GetTokens() == 0);
+    CHECK(manager.GetDebt() == 3);
+
+    CHECK(!manager.TryConsumeTokens(1));    // 有欠账时不能获取
+    bool small = false;
+    CHECK(manager.ConsumeTokensAsync(1, [&small] () { small = true; }) != 0);
+    CHECK(manager.AddTokens(2) == 2);       // 全部用于还债
+    CHECK(manager.GetDebt() == 1);
+    CHECK(manager.GetTokens() == 0);
+    CHECK(!small);
+    CHECK(manager.AddTokens(3) == 3);       // 还清1个，剩下2个进入桶中，满足排队的请求
+    CHECK(manager.GetDebt() == 0);
+    CHECK(small);
+    CHECK(manager.GetTokens() == 1);
+
+    // 关闭透支模式后不再接受大请求，已有的欠账照常偿还
+    CHECK(manager.AddTokens(4) == 4);
+    CHECK(manager.ConsumeTokensAsync(9, [] () {}) == 0);  // 桶满，立即放行
+    CHECK(manager.GetDebt() == 4);
+    manager.SetDebtMode(false);
+    CHECK(manager.ConsumeTokensAsync(9, [] () {}) == TokenManager::kRejected);
+    CHECK(manager.AddTokens(6) == 6);
+    CHECK(manager.GetDebt() == 0);
+    CHECK(manager.GetTokens() == 2);
+}
+
+// 最大数量超过Counter的表示范围时截断，而不是取模
+static void TestMaxTokensClampedToCounter () {
+    BasicTokenManager<std::mutex, CondVarWait, steady_clock, uint8_t> narrow(300);
+    CHECK(narrow.GetMaxTokens() == 255);
+    CHECK(narrow.AddTokens(1000) == 255);
+    narrow.SetMaxTokens(70000, decltype(narrow)::ResizePolicy::kPreserve);
+    CHECK(narrow.GetMaxTokens() == 255);
+    CHECK(narrow.GetTokens() == 255);
+    CHECK(narrow.TryConsumeTokens(255));
+}
+
+// NoQueue去掉队列、变化通知和透支状态：单线程的窄计数桶只占几个字节，行为不变
+static void TestNoQueueIsSmall () {
+    using Tiny = BasicTokenManager<NullLock, NoWait, steady_clock, uint8_t>;
+    static_assert(sizeof(Tiny) <= 8, "NullLock/NoWait/uint8_t manager should not carry the wait queue");
+    using Atomic = BasicTokenManager<AtomicLock, FutexWait, steady_clock, uint32_t>;
+    static_assert(sizeof(Atomic) <= kCacheLineSize, "AtomicLock manager should fit in one cache line");
+    Tiny tiny(3);
+    CHECK(tiny.AddTokens(5) == 3);
+    CHECK(tiny.TryConsumeTokens(2));
+    CHECK(!tiny.TryConsumeTokens(2));
+    CHECK(tiny.TryConsumeUpTo(5) == 1);
+    CHECK(!tiny.Feasible(4));
+    CHECK(tiny.GetDebt() == 0);
+    CHECK(tiny.GetWaiters() == 0);
+
+    // 显式选择FifoQueue时单线程桶也有异步接口（模拟器使用）
+    BasicTokenManager<NullLock, NoWait, steady_clock, size_t, FifoQueue> queued(2);
+    int grants = 0;
+    CHECK(queued.ConsumeTokensAsync(2, [&grants] () { grants++; }) != 0);
+    queued.AddTokens(2);
+    CHECK(grants == 1);
+}
+
+using AdaptiveManager = BasicTokenManager<std::mutex, AdaptiveWait>;
+
+// 长时间睡眠的等待者在补充时被唤醒；之后高频补充时（可能改为自旋）每个token都被取走
+static void TestAdaptiveWakeAfterLongPark () {
+    AdaptiveManager manager(10);
+    std::atomic<bool> got{false};
+    std::thread consumer([&] () { got = manager.ConsumeTokens(5); });
+    std::this_thread::sleep_for(milliseconds(200));   // 远超自旋预算，等待者已经睡眠
+    CHECK(!got);
+    CHECK(manager.GetWaiters() == 1);
+    manager.AddTokens(5);
+    CHECK(Eventually([&got] () { return got.load(); }));
+    CHECK(Finishes([&consumer] () { consumer.join(); }));
+    CHECK(manager.GetTokens() == 0);
+
+    constexpr int kTokens = 20000;
+    std::thread fast([&manager] () {
+        for (int i = 0; i < kTokens; i++) {
+            while (manager.AddTokens(1) == 0) {
+                std::this_thread::yield();   // 桶满，等消费者取走
+            }
+        }
+    });
+    CHECK(Finishes([&manager] () {
+        for (int i = 0; i < kTokens; i++) {
+            manager.ConsumeTokens(1);
+        }
+    }));
+    fast.join();
+    CHECK(manager.GetTokens() == 0);
+}
+
+// 停止标志中断睡眠中的等待：返回false，请求离开队列，不占用之后补充的token
+static void TestAdaptiveStopFlag () {
+    AdaptiveManager manager(10);
+    std::atomic<bool> stop{false};
+    std::atomic<int> result{-1};
+    std::thread consumer([&] () { result = manager.ConsumeTokensWithStopCheck(5, &stop); });
+    std::this_thread::sleep_for(milliseconds(50));
+    CHECK(result == -1);
+    stop = true;
+    CHECK(Eventually([&result] () { return result == 0; }));
+    CHECK(Finishes([&consumer] () { consumer.join(); }));
+    CHECK(manager.GetWaiters() == 0);
+    manager.AddTokens(5);
+    CHECK(manager.GetTokens() == 5);
+}
+
+// 自旋时长跟随通知间隔的平均值：间隔短时先自旋（多次检查条件），间隔长或补充停止后直接睡眠。
+// 用一次注定失败的限时等待中检查条件的次数区分两者；只有一个CPU时从不自旋
+static void TestAdaptiveSpinFollowsNotifyInterval () {
+    using Waiter = AdaptiveWait::Waiter<std::mutex>;
+    std::mutex mtx;
+    auto probe = [&mtx] (Waiter& waiter) {
+        std::unique_lock<std::mutex> lock(mtx);
+        int checks = 0;
+        CHECK(!waiter.WaitUntil(lock, steady_clock::now() + milliseconds(2), [&checks] () {
+            checks++;
+            return false;
+        }));
+        return checks;
+    };
+    auto notify_every = [] (Waiter& waiter, nanoseconds gap) {
+        auto next = steady_clock::now();
+        for (int i = 0; i < 100; i++) {
+            next += gap;
+            while (steady_clock::now() < next) {
+            }
+            waiter.NotifyAll();
+        }
+    };
+    const int kParked = 8;   // 睡眠时最多检查的次数（含超时前后的检查）
+    Waiter waiter;
+    CHECK(probe(waiter) <= kParked);            // 还没有通知过，不自旋
+
+    notify_every(waiter, microseconds(10));
+    int short_interval = probe(waiter);
+    if (std::thread::hardware_concurrency() > 1) {
+        CHECK(short_interval > 4 * kParked);
+    } else {
+        CHECK(short_interval <= kParked);
+    }
+
+    notify_every(waiter, microseconds(200));
+    CHECK(probe(waiter) <= kParked);            // 平均间隔超过50微秒
+
+    notify_every(waiter, microseconds(10));
+    std::this_thread::sleep_for(milliseconds(1));
+    CHECK(probe(waiter) <= kParked);            // 补充已经停止
+}
+
+int main () {
+    TestTryDoesNotOvertakeQueue();
+    TestTryAheadOfOwnRequest();
+    TestBlockingAndAsyncShareOneQueue();
+    TestStoppedWaiterLeavesQueue();
+    TestInfeasibleRequestDoesNotBlockQueue();
+    TestQueuedRequestNotStarved();
+    TestInfeasibleRequestRejected();
+    TestDebtRepayment();
+    TestMaxTokensClampedToCounter();
+    TestNoQueueIsSmall();
+    TestAdaptiveWakeAfterLongPark();
+    TestAdaptiveStopFlag();
+    TestAdaptiveSpinFollowsNotifyInterval();
+    return CheckResult("token_manager_test");
+}
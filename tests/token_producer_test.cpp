@@ -0,0 +1,131 @@
+/**
+ * @file token_producer_test.cpp
+ * @brief TokenProducer和RefillPacer测试：补充速率、SetRate、burst放大、高速率下的CPU占用
+ */
+
+#include "../token_producer.h"
+#include "check.h"
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <sys/resource.h>
+
+using namespace std::chrono;
+
+static double CpuSeconds () {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+// 按绝对时间结算：晚醒不丢节拍（受burst限制），提前调用不多给
+static void TestPacer () {
+    RefillPacer pacer(10.0, 100);
+    CHECK(pacer.Due(0.0) == 1);     // 起点立即产生一个
+    CHECK(pacer.Due(0.05) == 0);
+    CHECK(pacer.Due(0.1) == 1);
+    CHECK(pacer.Due(1.0) == 9);     // 晚醒补上错过的节拍
+    pacer.SetRate(100.0, 1.0);
+    CHECK(pacer.Due(1.5) == 50);
+    RefillPacer capped(1000.0, 5);
+    capped.Due(0.0);
+    CHECK(capped.Due(1.0) == 5);    // 欠下的超过burst的部分丢弃
+    CHECK(capped.Due(1.0025) == 2);
+}
+
+// burst小于一个唤醒间隔的产量时被放大，并且可以查询到
+static void TestFitBurstRaisesBurst () {
+    RefillPacer pacer(1e6, 1);
+    pacer.FitBurst(milliseconds(1));
+    CHECK(pacer.Burst() == 4000);
+    RefillPacer slow(2.0, 10);
+    slow.FitBurst(milliseconds(500));
+    CHECK(slow.Burst() == 10);       // 已经足够时不修改
+}
+
+// 0、负数、NaN和无穷大的速率被截断，唤醒间隔不溢出，生产者可以正常启动和停止
+static void TestInvalidRateClamped () {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+    CHECK(RefillPacer(0.0, 1).Rate() == RefillPacer::kMinRate);
+    CHECK(RefillPacer(-5.0, 1).Rate() == RefillPacer::kMinRate);
+    CHECK(RefillPacer(nan, 1).Rate() == RefillPacer::kMinRate);
+    CHECK(RefillPacer(inf, 1).Rate() == RefillPacer::kMaxRate);
+    CHECK(RefillPacer(1e-300, 1).Interval(milliseconds(1)) == nanoseconds(1000000000000000));
+    RefillPacer pacer(10.0, 100);
+    pacer.Due(0.0);
+    pacer.SetRate(nan, 1.0);
+    CHECK(pacer.Rate() == RefillPacer::kMinRate);
+    CHECK(pacer.Due(2.0) == 10);     // 1秒前按旧速率累计的部分照常结算
+
+    auto manager = std::make_shared<TokenManager>(10);
+    ProducerConfig config;
+    config.rate = 0.0;
+    TokenProducer producer(manager, config);
+    CHECK(producer.Rate() == RefillPacer::kMinRate);
+    producer.SetRate(-1.0);
+    CHECK(producer.Rate() == RefillPacer::kMinRate);
+    CHECK(Finishes([&producer, inf] () {
+        producer.start();
+        std::this_thread::sleep_for(milliseconds(20));
+        producer.SetRate(inf);
+        producer.stop();
+    }));
+    CHECK(producer.Rate() == RefillPacer::kMaxRate);
+
+    // 由调度器驱动时截断后的速率可以注册
+    auto scheduler = std::make_shared<RefillScheduler>();
+    scheduler->start();
+    TokenProducer scheduled(manager, scheduler, config);
+    bool started = true;
+    try {
+        scheduled.start();
+    } catch (const std::runtime_error&) {
+        started = false;
+    }
+    CHECK(started);
+    scheduled.stop();
+    scheduler->stop();
+}
+
+static void TestRate () {
+    auto manager = std::make_shared<TokenManager>(100000000);
+    ProducerConfig config;
+    config.rate = 5000;
+    TokenProducer producer(manager, config);
+    producer.start();
+    std::this_thread::sleep_for(milliseconds(400));
+    producer.SetRate(20000);
+    size_t before = manager->GetTokens();
+    std::this_thread::sleep_for(milliseconds(400));
+    producer.stop();
+    size_t after = manager->GetTokens();
+    CHECK(before >= 1600 && before <= 2400);            // 约2000
+    CHECK(after - before >= 6400 && after - before <= 9600);  // 约8000
+}
+
+// 速率远高于1/spin_window时，生产者线程仍然以睡眠为主
+static void TestHighRateDoesNotSpin () {
+    auto manager = std::make_shared<TokenManager>(100000000);
+    ProducerConfig config;
+    config.rate = 200000;
+    TokenProducer producer(manager, config);
+    double cpu = CpuSeconds();
+    producer.start();
+    std::this_thread::sleep_for(seconds(1));
+    producer.stop();
+    cpu = CpuSeconds() - cpu;
+    CHECK(cpu < 0.3);
+    CHECK(manager->GetTokens() >= 160000 && manager->GetTokens() <= 240000);
+}
+
+int main () {
+    TestPacer();
+    TestFitBurstRaisesBurst();
+    TestInvalidRateClamped();
+    TestRate();
+    TestHighRateDoesNotSpin();
+    return CheckResult("token_producer_test");
+}
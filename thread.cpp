@@ -1,54 +1,76 @@
 #include <iostream>
+#include <string>
 #include <thread>
-#include <queue>
-#include <condition_variable>
-#include <mutex>
+#include <memory>
+#include <vector>
+#include "async_logger.h"
+#include "blocking_queue.h"
+#include "spsc_queue.h"
 const int maxx = 10;
 
-class Queue {
-public:
-    void put (int val) {
-        std::unique_lock<std::mutex> lock(mtx);
-        cv.wait(lock, [&]() -> bool { return q.size() <= maxx; });
-        q.push(val);
-        std::cout << "producer: " << val << std::endl;
-        cv.notify_all();
-    }
+AsyncLogger logger;  // 日志由后台线程写出，不占用生产者/消费者的时间
 
-    int get () {
-        std::unique_lock<std::mutex> lock(mtx);
-        cv.wait(lock, [&]() -> bool { return !q.empty(); });
-        int val = q.front();
-        q.pop();
-        std::cout << "consumer: " << val << std::endl; 
-        cv.notify_all();
-        return val;
-    }
-private:
-    std::queue <int> q;
-    std::mutex mtx;
-    std::condition_variable cv;
+using Queue = SpscQueue<int>;  // 恰好一个生产者线程和一个消费者线程
 
-};
 void producer (Queue *q) {
     for (int i = 1; i <= 100; i++) {
         q->put(i);
+        logger.Log("producer: " + std::to_string(i));
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 }
 
 void consumer (Queue *q) {
     for (int i = 1; i <= 100; i++) {
-        q->get();
+        int val = q->get();
+        logger.Log("consumer: " + std::to_string(val));
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
 }
+// 多个生产者成批提交只可移动的消息，一个消费者成批取出
+using Message = std::unique_ptr<std::string>;
+using BatchQueue = BlockingQueue<Message>;
+
+void batch_producer (BatchQueue *q, int id) {
+    for (int round = 0; round < 10; round++) {
+        std::vector<Message> batch;
+        for (int i = 0; i < 5; i++) {
+            batch.push_back(std::make_unique<std::string>("producer " + std::to_string(id) + " message " + std::to_string(round * 5 + i)));
+        }
+        q->put_bulk(batch.begin(), batch.end());
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void batch_consumer (BatchQueue *q, int total) {
+    std::vector<Message> batch;
+    for (int received = 0; received < total;) {
+        batch.clear();
+        size_t n = q->get_bulk(std::back_inserter(batch), 16);
+        logger.Log("batch consumer: " + std::to_string(n) + " messages, first: " + *batch.front());
+        received += static_cast<int>(n);
+    }
+}
+
 int main () {
-    Queue q;
+    logger.start();
+    Queue q(maxx);
     std::thread t1(producer, &q);
     std::thread t2(consumer, &q);
 
     t1.join();
     t2.join();
 
-}
\ No newline at end of file
+    const int batch_producers = 3;
+    BatchQueue bq(maxx);
+    std::vector<std::thread> producers;
+    for (int i = 0; i < batch_producers; i++) {
+        producers.emplace_back(batch_producer, &bq, i + 1);
+    }
+    std::thread t3(batch_consumer, &bq, batch_producers * 50);
+    for (auto& t : producers) {
+        t.join();
+    }
+    t3.join();
+
+}
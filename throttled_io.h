@@ -0,0 +1,251 @@
+/**
+ * @file throttled_io.h
+ * @brief 按字节限速的文件描述符读写（仅Linux）
+ *
+ * ThrottledIo把一个TokenManager当作字节桶：1个token = 1字节，补充速率即带宽（字节/秒）。
+ * 大块传输被切分成按当前预算确定大小的分片，每个分片一次系统调用：
+ * - 预算充足时一次取走当前全部预算（不超过max_chunk），系统调用次数最少
+ * - 预算不足min_chunk时阻塞等待凑满min_chunk，避免大量小分片的系统调用开销
+ * - 系统调用实际传输的字节少于预算（短写、EOF、EAGAIN）时，多取的token退回桶中
+ * 支持write/writev/read/sendfile/splice，对socket、普通文件和管道都适用，可以离线测试。
+ */
+
+#pragma once
+
+#if !defined(__linux__)
+#error "throttled_io.h requires Linux (sendfile/splice)"
+#endif
+
+#include "token_manager.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/sendfile.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/**
+ * @struct ThrottleConfig
+ * @brief 分片配置
+ */
+struct ThrottleConfig {
+    size_t min_chunk = 16 * 1024;    // 最小分片：预算不足时等待凑满，再小的分片系统调用开销占比过高
+    size_t max_chunk = 1024 * 1024;  // 最大分片：预算再多单次也不超过，避免一次调用占用过久
+};
+
+/**
+ * @struct ThrottleStats
+ * @brief 传输统计
+ */
+struct ThrottleStats {
+    uint64_t bytes = 0;                        // 实际传输的字节数
+    uint64_t syscalls = 0;                     // 发起的读写系统调用次数
+    std::chrono::nanoseconds throttled{0};     // 等待预算的总时长
+};
+
+/**
+ * @class ThrottledIo
+ * @brief 按字节限速的读写器
+ *
+ * 接口与对应的系统调用一致：返回传输的字节数，失败且没有传输任何字节时返回-1并设置errno。
+ * 写类操作（Write/Writev/SendFile/Splice）循环直到全部传输、EOF或出错；Read与read(2)一样最多读一个分片。
+ * 被Stop()打断时返回已传输的字节数，一个字节都没有传输时返回-1、errno为ECANCELED。
+ * 多个线程可以共享同一个ThrottledIo（或同一个字节桶），带宽在它们之间分配。
+ * 注意：字节桶的max_tokens决定了最大突发量，也是单个分片的上限。
+ */
+class ThrottledIo {
+private:
+    std::shared_ptr<TokenManager> bucket_;   // 字节桶（1 token = 1字节）
+    const ThrottleConfig config_;            // 分片配置
+    std::atomic<bool> stopped_{false};       // 停止标志，打断等待预算的线程
+    std::atomic<uint64_t> bytes_{0};         // 统计：已传输字节
+    std::atomic<uint64_t> syscalls_{0};      // 统计：系统调用次数
+    std::atomic<int64_t> throttled_ns_{0};   // 统计：等待预算的时长
+
+public:
+    /**
+     * @brief 构造函数
+     * @param bucket 字节桶，由TokenProducer（或RefillScheduler、RefillTimerFd）按字节/秒补充
+     * @param config 分片配置
+     */
+    explicit ThrottledIo(std::shared_ptr<TokenManager> bucket, ThrottleConfig config = ThrottleConfig())
+        : bucket_(std::move(bucket)), config_(config) {}
+
+    /**
+     * @brief 限速写入，直到写完len字节
+     */
+    ssize_t Write (int fd, const void* buf, size_t len) {
+        const char* data = static_cast<const char*>(buf);
+        return Transfer(len, [fd, data] (size_t done, size_t budget) {
+            return ::write(fd, data + done, budget);
+        });
+    }
+
+    /**
+     * @brief 限速的聚集写入，直到写完所有缓冲区
+     *
+     * 每个分片按预算截取iov的一段窗口，一次writev写出。
+     */
+    ssize_t Writev (int fd, const iovec* iov, int iovcnt) {
+        size_t total = 0;
+        for (int i = 0; i < iovcnt; i++) {
+            total += iov[i].iov_len;
+        }
+        std::vector<iovec> window;
+        return Transfer(total, [fd, iov, iovcnt, &window] (size_t done, size_t budget) {
+            // 跳过已写完的缓冲区，截取budget字节的窗口
+            window.clear();
+            int i = 0;
+            while (i < iovcnt && done >= iov[i].iov_len) {
+                done -= iov[i].iov_len;
+                i++;
+            }
+            for (; i < iovcnt && budget > 0 && window.size() < IOV_MAX; i++) {
+                size_t len = std::min(iov[i].iov_len - done, budget);
+                window.push_back(iovec{static_cast<char*>(iov[i].iov_base) + done, len});
+                budget -= len;
+                done = 0;
+            }
+            return ::writev(fd, window.data(), static_cast<int>(window.size()));
+        });
+    }
+
+    /**
+     * @brief 限速读取，与read(2)一样最多读一个分片
+     * @return 读到的字节数，0表示EOF
+     */
+    ssize_t Read (int fd, void* buf, size_t len) {
+        if (len == 0) {
+            return 0;
+        }
+        size_t budget = Reserve(len);
+        if (budget == 0) {
+            errno = ECANCELED;
+            return -1;
+        }
+        ssize_t n;
+        do {
+            n = ::read(fd, buf, budget);
+        } while (n < 0 && errno == EINTR);
+        int err = errno;
+        Settle(budget, n);
+        errno = err;
+        return n;
+    }
+
+    /**
+     * @brief 限速的sendfile，从in_fd向out_fd复制count字节（零拷贝）
+     * @param offset 读取位置，为nullptr时使用并推进in_fd的文件位置
+     */
+    ssize_t SendFile (int out_fd, int in_fd, off_t* offset, size_t count) {
+        return Transfer(count, [out_fd, in_fd, offset] (size_t, size_t budget) {
+            return ::sendfile(out_fd, in_fd, offset, budget);
+        });
+    }
+
+    /**
+     * @brief 限速的splice，在管道和其他fd之间移动count字节（其中一端必须是管道）
+     * @param flags splice标志，例如SPLICE_F_MOVE | SPLICE_F_MORE
+     */
+    ssize_t Splice (int in_fd, int out_fd, size_t count, unsigned flags = SPLICE_F_MOVE) {
+        return Transfer(count, [in_fd, out_fd, flags] (size_t, size_t budget) {
+            return ::splice(in_fd, nullptr, out_fd, nullptr, budget, flags);
+        });
+    }
+
+    /**
+     * @brief 打断所有正在等待预算的传输，之后的传输立即返回
+     */
+    void Stop () {
+        stopped_ = true;
+    }
+
+    /**
+     * @brief 获取传输统计
+     */
+    ThrottleStats GetStats () const {
+        ThrottleStats stats;
+        stats.bytes = bytes_.load(std::memory_order_relaxed);
+        stats.syscalls = syscalls_.load(std::memory_order_relaxed);
+        stats.throttled = std::chrono::nanoseconds(throttled_ns_.load(std::memory_order_relaxed));
+        return stats;
+    }
+
+private:
+    // 循环传输count字节：op(已传输字节, 本次预算)执行一次系统调用
+    template <typename Op>
+    ssize_t Transfer (size_t count, Op op) {
+        size_t done = 0;
+        while (done < count) {
+            size_t budget = Reserve(count - done);
+            if (budget == 0) {
+                return Finish(done, ECANCELED);
+            }
+            ssize_t n = op(done, budget);
+            int err = errno;
+            Settle(budget, n);
+            if (n < 0) {
+                if (err == EINTR) {
+                    continue;
+                }
+                return Finish(done, err);
+            }
+            if (n == 0) {
+                break;  // EOF
+            }
+            done += static_cast<size_t>(n);
+        }
+        return static_cast<ssize_t>(done);
+    }
+
+    // 取得本次分片的预算（1..want字节）；被停止时返回0
+    size_t Reserve (size_t want) {
+        if (stopped_.load()) {
+            return 0;
+        }
+        size_t cap = std::min({want, config_.max_chunk, bucket_->GetMaxTokens()});
+        size_t floor = std::min(cap, std::max<size_t>(config_.min_chunk, 1));
+        size_t budget = bucket_->TryConsumeUpTo(cap);
+        if (budget >= floor) {
+            return budget;
+        }
+        // 预算不足一个最小分片：保留已取得的部分，等待补足，再顺带取走等待期间新增的预算
+        auto begin = std::chrono::steady_clock::now();
+        bool ok = bucket_->ConsumeTokensWithStopCheck(floor - budget, &stopped_);
+        throttled_ns_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - begin).count(), std::memory_order_relaxed);
+        if (!ok) {
+            if (budget > 0) {
+                bucket_->AddTokens(budget);
+            }
+            return 0;
+        }
+        return floor + bucket_->TryConsumeUpTo(cap - floor);
+    }
+
+    // 记账：统计实际传输的字节，退回未用完的预算
+    void Settle (size_t budget, ssize_t n) {
+        size_t used = n > 0 ? static_cast<size_t>(n) : 0;
+        syscalls_.fetch_add(1, std::memory_order_relaxed);
+        bytes_.fetch_add(used, std::memory_order_relaxed);
+        if (used < budget) {
+            bucket_->AddTokens(budget - used);
+        }
+    }
+
+    // 出错或被打断：已经传输过数据时返回字节数，否则返回-1并设置errno
+    static ssize_t Finish (size_t done, int err) {
+        if (done > 0) {
+            return static_cast<ssize_t>(done);
+        }
+        errno = err;
+        return -1;
+    }
+};
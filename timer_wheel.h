@@ -0,0 +1,305 @@
+/**
+ * @file timer_wheel.h
+ * @brief 分层时间轮 - O(1)注册/取消的定时器结构
+ *
+ * TimerWheel以tick为单位管理大量定时器，采用Linux内核式的四层哈希时间轮：
+ * - 第0层256个槽，每槽1个tick
+ * - 第1~3层各64个槽，每层的一个槽覆盖下一层的一整圈
+ * 定时器按到期时间落入对应层的槽中，低层转完一圈时把上层对应槽"降级"（cascade）到低层。
+ * 注册和取消都只是双向链表的插入/摘除，复杂度为O(1)。
+ *
+ * 注意：TimerWheel本身不是线程安全的，由调用方（如RefillScheduler）加锁保护。
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+/**
+ * @class TimerWheel
+ * @brief 分层哈希时间轮
+ * @tparam T 定时器携带的数据类型
+ *
+ * 时间以tick（无单位整数）表示，由调用方决定一个tick对应的真实时长。
+ * 节点存放在连续数组中并通过空闲链表复用，稳态下注册/取消不分配内存。
+ */
+template <typename T>
+class TimerWheel {
+public:
+    using TimerId = uint64_t;                    // 高32位为代数，低32位为节点下标+1
+    static constexpr TimerId kInvalidTimer = 0;  // 无效的定时器ID
+
+private:
+    static constexpr uint32_t kNil = std::numeric_limits<uint32_t>::max();
+    static constexpr int kLevels = 4;             // 时间轮层数
+    static constexpr int kBits0 = 8;              // 第0层的位数（256个槽）
+    static constexpr int kBitsN = 6;              // 第1~3层的位数（64个槽）
+    static constexpr uint64_t kSlots0 = uint64_t(1) << kBits0;
+    static constexpr uint64_t kSlotsN = uint64_t(1) << kBitsN;
+    static constexpr uint64_t kMask0 = kSlots0 - 1;
+    static constexpr uint64_t kMaskN = kSlotsN - 1;
+    static constexpr uint64_t kMaxDelta = (uint64_t(1) << (kBits0 + 3 * kBitsN)) - 1;  // 可直接表示的最大跨度
+
+    struct Node {
+        T payload;
+        uint64_t expire = 0;     // 绝对到期tick
+        uint32_t prev = kNil;    // 槽内双向链表
+        uint32_t next = kNil;    // 槽内双向链表（空闲时作为空闲链表指针）
+        uint32_t slot = kNil;    // 所在槽的全局下标，kNil表示不在任何槽中
+        uint32_t gen = 1;        // 代数，用于识别过期的TimerId
+    };
+
+    std::vector<Node> nodes_;                    // 节点存储
+    std::vector<uint32_t> heads_;                // 每个槽的链表头
+    uint32_t free_head_ = kNil;                  // 空闲节点链表头
+    uint64_t current_;                           // 下一个待处理的tick
+    size_t size_ = 0;                            // 已注册的定时器数量
+
+public:
+    /**
+     * @brief 构造函数
+     * @param start_tick 时间轮的起始tick
+     */
+    explicit TimerWheel(uint64_t start_tick = 0)
+        : heads_(kSlots0 + (kLevels - 1) * kSlotsN, kNil), current_(start_tick) {}
+
+    /**
+     * @brief 注册一个定时器
+     * @param expire_tick 绝对到期tick，早于当前tick的会在下一次Advance时立即触发
+     * @param payload 定时器携带的数据
+     * @return 定时器ID，可用于Cancel
+     */
+    TimerId Schedule (uint64_t expire_tick, T payload) {
+        uint32_t index;
+        if (free_head_ != kNil) {
+            index = free_head_;
+            free_head_ = nodes_[index].next;
+        } else {
+            index = static_cast<uint32_t>(nodes_.size());
+            nodes_.emplace_back();
+        }
+        Node& node = nodes_[index];
+        node.payload = std::move(payload);
+        node.expire = expire_tick < current_ ? current_ : expire_tick;
+        Link(index);
+        size_++;
+        return MakeId(index, node.gen);
+    }
+
+    /**
+     * @brief 取消一个定时器
+     * @param id Schedule返回的定时器ID
+     * @return 如果定时器存在并被取消返回true，已触发完毕或ID无效返回false
+     */
+    bool Cancel (TimerId id) {
+        Node* node = Find(id);
+        if (!node) {
+            return false;
+        }
+        uint32_t index = static_cast<uint32_t>(node - nodes_.data());
+        Unlink(index);
+        Release(index);
+        return true;
+    }
+
+    /**
+     * @brief 修改定时器的到期时间，ID保持不变
+     * @param id 定时器ID
+     * @param expire_tick 新的绝对到期tick，早于当前tick的会在下一次Advance时立即触发
+     * @return 如果定时器存在返回true
+     */
+    bool Reschedule (TimerId id, uint64_t expire_tick) {
+        Node* node = Find(id);
+        if (!node) {
+            return false;
+        }
+        uint32_t index = static_cast<uint32_t>(node - nodes_.data());
+        Unlink(index);
+        node->expire = expire_tick < current_ ? current_ : expire_tick;
+        Link(index);
+        return true;
+    }
+
+    /**
+     * @brief 获取定时器携带的数据
+     * @param id 定时器ID
+     * @return 指向数据的指针，ID无效时返回nullptr
+     */
+    T* Get (TimerId id) {
+        Node* node = Find(id);
+        return node ? &node->payload : nullptr;
+    }
+
+    /**
+     * @brief 推进时间轮直到now_tick（包含）
+     * @param now_tick 当前tick
+     * @param on_expire 到期回调，签名为 uint64_t(TimerId, T&, uint64_t fired_tick)，
+     *                  返回下一次的绝对到期tick，返回0表示不再重复（释放定时器）
+     * @return 本次触发的定时器次数
+     *
+     * 同一个tick到期的定时器在同一轮中依次回调。回调中不允许调用Schedule/Cancel。
+     */
+    template <typename F>
+    size_t Advance (uint64_t now_tick, F&& on_expire) {
+        size_t fired = 0;
+        while (current_ <= now_tick) {
+            uint64_t index = current_ & kMask0;
+            // 第0层转完一圈，逐层把上层对应槽降级
+            if (index == 0) {
+                for (int level = 1; level < kLevels; level++) {
+                    if (Cascade(level, SlotIndex(current_, level)) != 0) {
+                        break;
+                    }
+                }
+            }
+            // 摘下当前槽的整条链表，逐个触发
+            uint32_t it = heads_[index];
+            heads_[index] = kNil;
+            while (it != kNil) {
+                Node& node = nodes_[it];
+                uint32_t next = node.next;
+                node.slot = kNil;
+                uint64_t again = on_expire(MakeId(it, node.gen), node.payload, current_);
+                fired++;
+                if (again != 0) {
+                    // 重新挂入时至少推迟到下一个tick，避免落回正在处理的槽
+                    node.expire = again > current_ ? again : current_ + 1;
+                    Link(it);
+                } else {
+                    Release(it);
+                }
+                it = next;
+            }
+            current_++;
+        }
+        return fired;
+    }
+
+    /**
+     * @brief 估计最近一次到期的tick（下界）
+     * @return 最近可能到期的tick，没有定时器时返回UINT64_MAX
+     *
+     * 第0层给出精确值；上层只能给出该槽覆盖区间的起点，在该时刻推进时间轮即可完成降级。
+     * 调用方可以据此休眠到该tick，而不必每个tick都醒来。
+     */
+    uint64_t NextExpiry () const {
+        if (size_ == 0) {
+            return std::numeric_limits<uint64_t>::max();
+        }
+        for (uint64_t tick = current_; ; tick++) {
+            // 第0层边界处需要降级，最晚在此时醒来
+            if (heads_[tick & kMask0] != kNil || (tick & kMask0) == 0) {
+                return tick;
+            }
+        }
+    }
+
+    /**
+     * @brief 获取下一个待处理的tick
+     */
+    uint64_t CurrentTick () const { return current_; }
+
+    /**
+     * @brief 获取已注册的定时器数量
+     */
+    size_t Size () const { return size_; }
+
+    /**
+     * @brief 是否没有任何定时器
+     */
+    bool Empty () const { return size_ == 0; }
+
+private:
+    static TimerId MakeId (uint32_t index, uint32_t gen) {
+        return (static_cast<uint64_t>(gen) << 32) | (static_cast<uint64_t>(index) + 1);
+    }
+
+    static uint64_t SlotIndex (uint64_t tick, int level) {
+        return (tick >> (kBits0 + (level - 1) * kBitsN)) & kMaskN;
+    }
+
+    Node* Find (TimerId id) {
+        uint64_t low = id & 0xffffffffu;
+        if (low == 0 || low > nodes_.size()) {
+            return nullptr;
+        }
+        Node& node = nodes_[low - 1];
+        if (node.gen != static_cast<uint32_t>(id >> 32) || node.slot == kNil) {
+            return nullptr;
+        }
+        return &node;
+    }
+
+    // 根据到期时间把节点挂到合适的层和槽
+    void Link (uint32_t index) {
+        Node& node = nodes_[index];
+        uint64_t expire = node.expire;
+        uint64_t delta = expire - current_;
+        if (delta > kMaxDelta) {
+            // 超出时间轮表示范围，先挂在最高层的最远处，降级时再重新计算
+            delta = kMaxDelta;
+            expire = current_ + kMaxDelta;
+        }
+        uint32_t slot;
+        if (delta < kSlots0) {
+            slot = static_cast<uint32_t>(expire & kMask0);
+        } else {
+            int level = 1;
+            while (level < kLevels - 1 && delta >= (uint64_t(1) << (kBits0 + level * kBitsN))) {
+                level++;
+            }
+            slot = static_cast<uint32_t>(kSlots0 + (level - 1) * kSlotsN + SlotIndex(expire, level));
+        }
+        node.slot = slot;
+        node.prev = kNil;
+        node.next = heads_[slot];
+        if (node.next != kNil) {
+            nodes_[node.next].prev = index;
+        }
+        heads_[slot] = index;
+    }
+
+    void Unlink (uint32_t index) {
+        Node& node = nodes_[index];
+        if (node.prev != kNil) {
+            nodes_[node.prev].next = node.next;
+        } else {
+            heads_[node.slot] = node.next;
+        }
+        if (node.next != kNil) {
+            nodes_[node.next].prev = node.prev;
+        }
+        node.slot = kNil;
+    }
+
+    // 回收节点：代数加一使旧ID失效，挂回空闲链表
+    void Release (uint32_t index) {
+        Node& node = nodes_[index];
+        node.payload = T();
+        node.slot = kNil;
+        node.gen++;
+        node.next = free_head_;
+        free_head_ = index;
+        size_--;
+    }
+
+    // 把上层某个槽中的定时器重新按剩余时间挂入低层，返回槽下标
+    uint64_t Cascade (int level, uint64_t index) {
+        uint32_t slot = static_cast<uint32_t>(kSlots0 + (level - 1) * kSlotsN + index);
+        uint32_t it = heads_[slot];
+        heads_[slot] = kNil;
+        while (it != kNil) {
+            uint32_t next = nodes_[it].next;
+            Link(it);
+            it = next;
+        }
+        return index;
+    }
+};
+
+template <typename T> constexpr typename TimerWheel<T>::TimerId TimerWheel<T>::kInvalidTimer;
+template <typename T> constexpr uint32_t TimerWheel<T>::kNil;
@@ -3,17 +3,46 @@
  * @brief Token消费者类 - 从TokenManager消费token的线程
  * 
  * TokenCustomer在独立线程中运行，定期从TokenManager消费指定数量的token。
+ * 也可以作为轻量任务运行在共享的WorkStealingExecutor上，此时不占用独立线程。
  * 支持可中断的消费操作，可以通过stop()方法优雅地停止。
+ * 可以注入ClockSource（例如VirtualClock），在虚拟时间中运行并统计。
  */
 
 #pragma once 
 
 #include "token_manager.h"
+#include "cache_line.h"
+#include "clock_source.h"
+#include "callback_dispatcher.h"
+#include "rate_controller.h"
+#include "work_stealing_executor.h"
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
+
+/**
+ * @struct CustomerStats
+ * @brief 消费者运行统计快照
+ *
+ * 由TokenCustomer::GetStats()返回，运行中也可以随时读取。
+ */
+struct CustomerStats {
+    uint64_t grants = 0;                          // 成功获取token的次数
+    uint64_t tokens = 0;                          // 消费的token总数
+    uint64_t failures = 0;                        // 下游任务失败的次数（见SetTask）
+    std::chrono::nanoseconds total_wait{0};       // 等待token的总时间
+    std::chrono::nanoseconds avg_wait{0};         // 每次获取的平均等待时间
+    std::chrono::nanoseconds max_wait{0};         // 单次获取的最长等待时间
+    std::chrono::nanoseconds callback_time{0};    // 下游任务和回调的总耗时
+    std::chrono::nanoseconds elapsed{0};          // 运行时长（运行中为start()至今）
+    double rate = 0.0;                            // 实际消费速率（每秒token数）
+    bool running = false;                         // 是否仍在运行
+};
 
 /**
  * @class TokenCustomer
@@ -22,18 +51,48 @@
  * 在独立线程中运行，持续从TokenManager消费token。
  * 每次消费指定数量的token，并在成功后调用回调函数。
  * 支持优雅停止，可以响应停止信号中断等待。
+ *
+ * 如果构造时传入了WorkStealingExecutor，则不创建线程：向TokenManager登记异步消费请求，
+ * token扣除成功后才把一次消费任务投递到线程池，任务执行完再登记下一次请求。
+ * 等待token期间不占用任何线程和栈，大量消费者可以共享少量工作线程。
  */
 class TokenCustomer {
 private:
     std::shared_ptr<TokenManager> token_manager_;      // 共享的TokenManager指针
     std::thread cons_thread_;                          // 消费者线程
     const size_t tokens_per_customer_;                 // 每次消费的token数量
-    std::atomic<bool> running_ {false};               // 运行标志（原子变量，线程安全）
     std::function<void(bool)> call_back_;              // 消费成功后的回调函数
+    std::function<bool()> task_;                       // 每次获得token后执行的下游任务（可选）
+    std::shared_ptr<RateController> controller_;       // 接收下游任务结果的速率控制器（可选）
     const size_t max_cons_count_;                      // 最大消费次数（0表示无限制）
-    size_t cons_count{0};                              // 当前消费次数
-    std::chrono::steady_clock::time_point start_;      // 开始时间
-    std::chrono::steady_clock::time_point end_;        // 结束时间
+    std::shared_ptr<ClockSource> clock_;               // 注入的时钟（为空时使用steady_clock）
+
+    // 控制标志：由控制线程写入、消费线程每轮读取，单独占一个缓存行
+    alignas(kCacheLineSize) std::atomic<bool> running_ {false};  // 运行标志（原子变量，线程安全）
+    std::atomic<bool> stop_requested_ {false};        // 停止请求标志，用于中断等待
+    std::atomic<bool> granted_ {false};               // 注入时钟时：本次异步请求已满足
+
+    // 运行统计：只由消费线程（或当前在途任务）写入，任意线程都可以随时读取。
+    // 与控制标志分开，避免每次更新统计都让控制线程的缓存行失效
+    alignas(kCacheLineSize) std::atomic<uint64_t> grants_{0};  // 当前消费次数
+    std::atomic<uint64_t> failures_{0};                // 下游任务失败次数
+    std::atomic<int64_t> wait_ns_{0};                  // 等待token的总时间（纳秒）
+    std::atomic<int64_t> max_wait_ns_{0};              // 单次最长等待时间（纳秒）
+    std::atomic<int64_t> callback_ns_{0};              // 下游任务和回调的总耗时（纳秒）
+    std::atomic<int64_t> start_ns_{0};                 // 开始时间（steady_clock纳秒）
+    std::atomic<int64_t> end_ns_{0};                   // 结束时间（0表示仍在运行）
+
+    // 线程池模式的状态
+    alignas(kCacheLineSize) std::shared_ptr<WorkStealingExecutor> executor_;   // 共享的线程池（为空时使用独立线程）
+    std::mutex task_mtx_;                              // 保护以下两个成员
+    std::condition_variable task_cond_;                // 等待在途任务结束
+    uint64_t pending_grant_{0};                        // 排队中的异步消费请求ID
+    bool inflight_{false};                             // 是否有排队的请求或在途的任务
+    int64_t wait_begin_ns_{0};                         // 本次异步请求的登记时间
+
+    // 异步回调
+    std::shared_ptr<CallbackDispatcher> dispatcher_;            // 回调分发器（为空时同步调用回调）
+    std::unique_ptr<CallbackDispatcher::Channel> channel_;      // 本消费者在分发器上的通道
 
 public:
     /**
@@ -53,35 +112,109 @@ public:
     call_back_(call_back),
     max_cons_count_(0) {}  // 默认无限制消费
 
+    /**
+     * @brief 构造函数（运行在共享线程池上）
+     * @param token_manager 共享的TokenManager指针
+     * @param tokens_per_customer 每次消费的token数量
+     * @param executor 共享的WorkStealingExecutor，调用方负责启动它，并在所有消费者停止后再停止它
+     * @param call_back 消费成功后的回调函数（可选），在线程池的工作线程上调用
+     */
+    TokenCustomer (std::shared_ptr<TokenManager> token_manager,
+                    const size_t tokens_per_customer,
+                    std::shared_ptr<WorkStealingExecutor> executor,
+                    std::function<void(bool)> call_back = nullptr):
+    token_manager_(std::move(token_manager)),
+    tokens_per_customer_(tokens_per_customer),
+    call_back_(std::move(call_back)),
+    max_cons_count_(0),
+    executor_(std::move(executor)) {}
+
+    /**
+     * @brief 设置每次获得token后执行的下游任务
+     * @param task 下游任务，返回true表示成功，false表示失败（过载、超时、被拒绝等）
+     * @param controller 速率控制器（可选），任务结果会报告给它，用于自适应调整生产速率
+     *
+     * 设置后回调函数的参数变为任务的执行结果。需在start()之前调用。
+     */
+    void SetTask (std::function<bool()> task, std::shared_ptr<RateController> controller = nullptr) {
+        task_ = std::move(task);
+        controller_ = std::move(controller);
+    }
+
+    /**
+     * @brief 改为通过分发器异步调用回调
+     * @param dispatcher 共享的CallbackDispatcher，调用方负责启动它
+     * @param batch_callback 批量回调（可选），设置后同一批的多次成功/失败合并为一次调用，
+     *                       参数为本批的成功次数和失败次数
+     *
+     * 消费循环只做一次原子计数就继续获取下一批token，回调在分发线程上执行；
+     * 多次获取在分发前到达时会合并成一批。stop()返回前会等待已投递的回调执行完。
+     * 需在start()之前调用。
+     */
+    void SetCallbackDispatcher (std::shared_ptr<CallbackDispatcher> dispatcher,
+                                std::function<void(size_t, size_t)> batch_callback = nullptr) {
+        dispatcher_ = std::move(dispatcher);
+        channel_.reset(new CallbackDispatcher::Channel(call_back_, std::move(batch_callback)));
+    }
+
+    /**
+     * @brief 注入时钟
+     * @param clock 时钟，需在start()之前设置
+     *
+     * 设置后统计按clock的时间计算；独立线程模式下改为登记异步请求并在clock上等待，
+     * 使用VirtualClock时消费线程登记为虚拟时间的参与线程。
+     * 线程池模式只用于统计（线程池的工作线程不参与虚拟时间）。
+     */
+    void SetClock (std::shared_ptr<ClockSource> clock) {
+        clock_ = std::move(clock);
+    }
+
     /**
      * @brief 启动消费者线程
      * 
      * 创建并启动一个新线程，在该线程中持续消费token。
      * 线程会一直运行直到调用stop()或达到最大消费次数。
      * 使用ConsumeTokensWithStopCheck确保可以响应停止信号。
+     * 线程池模式下只登记第一次异步消费请求，不创建线程。
      */
     void start () {
         running_ = true;
+        stop_requested_ = false;
+        start_ns_ = NowNs();  // 记录开始时间
+        end_ns_ = 0;
+        if (executor_) {
+            {
+                std::lock_guard<std::mutex> lock(task_mtx_);
+                inflight_ = true;
+            }
+            Arm();
+            return;
+        }
+        if (clock_) {
+            clock_->Attach();  // 在创建线程之前登记，线程启动前虚拟时间不会推进
+        }
         cons_thread_ = std::thread([this]() {
-            start_ = std::chrono::steady_clock::now();  // 记录开始时间
+            if (clock_) {
+                clock_->Bind();
+            }
             while (running_.load()) {
                 // 检查是否达到最大消费次数
-                if (max_cons_count_ > 0 && cons_count >= max_cons_count_) {
+                if (max_cons_count_ > 0 && grants_.load() >= max_cons_count_) {
                     break;
                 }
                 // 尝试消费token（可中断）
-                bool success = token_manager_->ConsumeTokensWithStopCheck(tokens_per_customer_, &running_);
+                int64_t wait_begin = NowNs();
+                bool success = clock_ ? AcquireOnClock()
+                                      : token_manager_->ConsumeTokensWithStopCheck(tokens_per_customer_, &stop_requested_);
                 if (!success) {
                     break;  // 被停止信号中断
                 }
-                cons_count++;  // 增加消费计数
-
-                // 如果设置了回调函数，调用它
-                if (call_back_) {
-                    call_back_(success);
-                }
+                OnGranted(NowNs() - wait_begin);
+            }
+            end_ns_ = NowNs();  // 记录结束时间
+            if (clock_) {
+                clock_->Detach();
             }
-            end_ = std::chrono::steady_clock::now();  // 记录结束时间
         });
     }
 
@@ -90,11 +223,33 @@ public:
      * 
      * 设置运行标志为false，并等待线程结束。
      * 这会中断ConsumeTokensWithStopCheck中的等待。
+     * 线程池模式下取消排队中的异步请求，并等待在途的任务执行完。
+     * 使用异步回调时还会等待已投递的回调执行完。
      */
     void stop () {
+        stop_requested_ = true;  // 中断正在进行的等待
         running_ = false;  // 设置停止标志
-        if (cons_thread_.joinable()) {
-            cons_thread_.join();  // 等待线程结束
+        if (clock_) {
+            clock_->Notify();
+        }
+        if (executor_) {
+            std::unique_lock<std::mutex> lock(task_mtx_);
+            if (pending_grant_ != 0 && token_manager_->CancelAsync(pending_grant_)) {
+                // 请求还在排队，取消成功后不会再有任务
+                pending_grant_ = 0;
+                inflight_ = false;
+                end_ns_ = NowNs();
+            }
+            task_cond_.wait(lock, [this]() { return !inflight_; });
+        } else if (cons_thread_.joinable()) {
+            if (clock_) {
+                clock_->Join(cons_thread_);  // 等待期间不阻止虚拟时间推进
+            } else {
+                cons_thread_.join();  // 等待线程结束
+            }
+        }
+        if (dispatcher_) {
+            dispatcher_->Flush(*channel_);  // 等待已投递的回调执行完
         }
     }
 
@@ -111,11 +266,148 @@ public:
      * @brief 计算运行时间
      * @return 运行时间（毫秒）
      * 
-     * 返回从start()到线程结束的时间差。
-     * 如果线程还未结束，返回的时间可能不准确。
+     * 返回从start()到线程结束的时间差；线程仍在运行时返回start()至今的时间。
      */
     uint32_t CountTime () const {
-        return std::chrono::duration_cast<std::chrono::milliseconds>(
-            end_ - start_).count();
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            GetStats().elapsed).count());
+    }
+
+    /**
+     * @brief 获取运行统计快照
+     * @return 统计快照
+     *
+     * 线程安全，运行中也可以随时调用，不需要先stop()。
+     * 各项计数分别原子读取，运行中的快照在各项之间可能相差一两次获取。
+     */
+    CustomerStats GetStats () const {
+        CustomerStats stats;
+        stats.grants = grants_.load();
+        stats.tokens = stats.grants * tokens_per_customer_;
+        stats.failures = failures_.load();
+        stats.total_wait = std::chrono::nanoseconds(wait_ns_.load());
+        stats.max_wait = std::chrono::nanoseconds(max_wait_ns_.load());
+        stats.callback_time = std::chrono::nanoseconds(callback_ns_.load());
+        if (stats.grants > 0) {
+            stats.avg_wait = stats.total_wait / static_cast<int64_t>(stats.grants);
+        }
+        int64_t start = start_ns_.load();
+        int64_t end = end_ns_.load();
+        stats.running = start != 0 && end == 0;
+        if (start != 0) {
+            stats.elapsed = std::chrono::nanoseconds((end != 0 ? end : NowNs()) - start);
+        }
+        if (stats.elapsed.count() > 0) {
+            stats.rate = stats.tokens / std::chrono::duration<double>(stats.elapsed).count();
+        }
+        return stats;
+    }
+
+private:
+    int64_t NowNs () const {
+        auto now = clock_ ? clock_->Now() : std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+    }
+
+    /**
+     * @brief 注入时钟时获取token：登记异步请求，在时钟上等待满足或停止
+     * @return 获得token返回true，被停止信号中断或请求永远无法满足（被拒绝）返回false
+     *
+     * 回调在补充token的线程上设置标志并通知时钟，被唤醒的消费线程立即计为忙碌，
+     * 虚拟时间不会在消费线程处理这批token之前推进。
+     */
+    bool AcquireOnClock () {
+        granted_ = false;
+        uint64_t id = token_manager_->ConsumeTokensAsync(tokens_per_customer_, [this]() {
+            granted_ = true;
+            clock_->Notify();
+        });
+        if (id == 0) {
+            return true;  // token足够，已立即扣除
+        }
+        if (id == TokenManager::kRejected) {
+            return false;  // 每次消费的数量超过最大数量，永远无法满足
+        }
+        clock_->WaitUntil(ClockSource::time_point::max(), [this]() {
+            return granted_.load() || stop_requested_.load();
+        });
+        if (granted_.load()) {
+            return true;
+        }
+        if (token_manager_->CancelAsync(id)) {
+            return false;  // 被停止信号中断
+        }
+        // 取消时请求恰好已被满足：等回调执行完，按正常获取处理
+        clock_->WaitUntil(ClockSource::time_point::max(), [this]() { return granted_.load(); });
+        return true;
+    }
+
+    /**
+     * @brief 处理一次成功的消费：记录统计、执行下游任务、调用回调
+     * @param wait_ns 本次等待token的时间（纳秒）
+     */
+    void OnGranted (int64_t wait_ns) {
+        // 统计只有一个写者，用load/store即可，无需原子读-改-写
+        wait_ns_.store(wait_ns_.load(std::memory_order_relaxed) + wait_ns, std::memory_order_relaxed);
+        if (wait_ns > max_wait_ns_.load(std::memory_order_relaxed)) {
+            max_wait_ns_.store(wait_ns, std::memory_order_relaxed);
+        }
+        grants_.store(grants_.load(std::memory_order_relaxed) + 1);  // 增加消费计数
+
+        // 执行下游任务，并把结果反馈给速率控制器
+        int64_t callback_begin = NowNs();
+        bool success = true;
+        if (task_) {
+            success = task_();
+            if (controller_) {
+                controller_->OnResult(success);
+            }
+            if (!success) {
+                failures_.store(failures_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+        }
+
+        // 如果设置了回调函数，调用它（或交给分发器异步调用）
+        if (dispatcher_) {
+            dispatcher_->Post(*channel_, success);
+        } else if (call_back_) {
+            call_back_(success);
+        }
+        callback_ns_.store(callback_ns_.load(std::memory_order_relaxed) + NowNs() - callback_begin,
+                           std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 线程池模式：登记下一次异步消费请求
+     *
+     * token扣除成功时（可能就在本次调用中）把消费任务投递到线程池；
+     * 已停止、达到最大消费次数或请求被拒绝（永远无法满足）时结束在途状态并通知stop()。
+     */
+    void Arm () {
+        std::lock_guard<std::mutex> lock(task_mtx_);
+        if (!running_.load() || (max_cons_count_ > 0 && grants_.load() >= max_cons_count_)) {
+            FinishLocked();
+            return;
+        }
+        wait_begin_ns_ = NowNs();
+        pending_grant_ = token_manager_->ConsumeTokensAsync(tokens_per_customer_, [this]() {
+            executor_->Submit([this]() {
+                OnGranted(NowNs() - wait_begin_ns_);
+                Arm();
+            });
+        });
+        if (pending_grant_ == TokenManager::kRejected) {
+            FinishLocked();  // 与独立线程模式一样，无法满足时结束消费者
+        }
+    }
+
+    /**
+     * @brief 线程池模式：结束在途状态、记录结束时间并通知stop()（调用时已持有task_mtx_）
+     */
+    void FinishLocked () {
+        pending_grant_ = 0;
+        inflight_ = false;
+        end_ns_ = NowNs();  // 记录结束时间
+        task_cond_.notify_all();
     }
 };
\ No newline at end of file
@@ -0,0 +1,317 @@
+/**
+ * @file token_fd.h
+ * @brief 可poll的token就绪通知 - 接入epoll事件循环（仅Linux）
+ *
+ * 事件循环不能在ConsumeTokens中阻塞线程。这里提供两个文件描述符，可以和socket一起放进epoll：
+ * - TokenEventFd：基于eventfd。向任意多个TokenManager登记"需要n个token"的请求，
+ *   token扣除成功后对应的标签进入就绪列表、fd变为可读；一个fd可以复用成千上万个桶
+ * - RefillTimerFd：基于timerfd。在事件循环线程中按速率补充一个TokenManager，
+ *   到下一次补充时间时fd变为可读，不需要生产者线程
+ * 两者配合使用时，整个限流过程都在事件循环线程中完成，没有任何辅助线程。
+ */
+
+#pragma once
+
+#if !defined(__linux__)
+#error "token_fd.h requires Linux (eventfd/timerfd)"
+#endif
+
+#include "refill_pacer.h"
+#include "token_manager.h"
+#include "token_producer.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/**
+ * @class TokenEventFd
+ * @brief token就绪时变为可读的eventfd
+ *
+ * 用法：Arm(manager, n, tag)登记请求；epoll报告fd可读后调用Drain取出就绪的标签，
+ * 每个标签对应一次已经扣除了n个token的请求（token已经属于调用方，不会被其他消费者抢走）。
+ * Arm/Cancel/Drain可以在任意线程调用；标签由补充token的线程（生产者、调度器或RefillTimerFd）写入。
+ */
+class TokenEventFd {
+private:
+    // 一个排队中的请求
+    struct Request {
+        std::shared_ptr<TokenManager> manager;
+        uint64_t async_id;
+    };
+
+    int fd_;                                          // eventfd，非阻塞
+    std::mutex mtx_;                                  // 保护以下成员
+    std::condition_variable idle_cond_;               // 析构时等待正在执行的回调
+    std::vector<uint64_t> ready_;                     // 已就绪、尚未取出的标签
+    std::unordered_map<uint64_t, Request> pending_;   // 排队中的请求，按句柄索引
+    uint64_t next_handle_ = 1;                        // 下一个请求句柄
+
+public:
+    /**
+     * @brief Arm的返回值：请求永远无法满足（n超过桶的最大数量），没有登记
+     */
+    static constexpr uint64_t kRejected = TokenManager::kRejected;
+
+    /**
+     * @brief 构造函数
+     * @throw std::system_error 创建eventfd失败
+     */
+    TokenEventFd() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "eventfd");
+        }
+    }
+
+    TokenEventFd(const TokenEventFd&) = delete;
+    TokenEventFd& operator=(const TokenEventFd&) = delete;
+
+    /**
+     * @brief 析构函数
+     *
+     * 取消所有排队中的请求，并等待正在执行的回调结束，然后关闭fd。
+     */
+    ~TokenEventFd() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        std::vector<std::pair<uint64_t, Request>> pending(pending_.begin(), pending_.end());
+        lock.unlock();
+        for (auto& entry : pending) {
+            if (entry.second.manager->CancelAsync(entry.second.async_id)) {
+                lock.lock();
+                pending_.erase(entry.first);
+                lock.unlock();
+            }
+        }
+        lock.lock();
+        idle_cond_.wait(lock, [this]() { return pending_.empty(); });  // 取消失败的请求回调即将执行
+        lock.unlock();
+        close(fd_);
+    }
+
+    /**
+     * @brief 获取可以加入epoll的文件描述符（EPOLLIN）
+     */
+    int fd () const { return fd_; }
+
+    /**
+     * @brief 登记一个请求
+     * @param manager 要扣除token的桶
+     * @param n 需要的token数量
+     * @param tag 就绪时由Drain返回的标签（例如连接ID）
+     * @return 请求句柄，可用于Cancel；token足够、已立即扣除时返回0（标签已进入就绪列表）；
+     *         请求永远无法满足时返回kRejected，标签不会就绪
+     */
+    uint64_t Arm (std::shared_ptr<TokenManager> manager, size_t n, uint64_t tag) {
+        uint64_t handle;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            handle = next_handle_++;
+            // 先占位，回调可能在ConsumeTokensAsync返回之前就在其他线程执行
+            pending_.emplace(handle, Request{manager, 0});
+        }
+        uint64_t async_id = manager->ConsumeTokensAsync(n, [this, handle, tag]() { OnGranted(handle, tag); });
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = pending_.find(handle);
+        if (it == pending_.end()) {
+            return 0;  // 已经满足
+        }
+        if (async_id == TokenManager::kRejected) {
+            pending_.erase(it);  // 撤掉占位，否则析构时会一直等待它
+            if (pending_.empty()) {
+                idle_cond_.notify_all();
+            }
+            return kRejected;
+        }
+        it->second.async_id = async_id;
+        return handle;
+    }
+
+    /**
+     * @brief 取消一个尚未就绪的请求
+     * @param handle Arm返回的句柄
+     * @return 取消成功返回true；已经就绪（标签已经或即将进入就绪列表）返回false
+     */
+    bool Cancel (uint64_t handle) {
+        Request pending;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = pending_.find(handle);
+            if (it == pending_.end() || it->second.async_id == 0) {
+                return false;
+            }
+            pending = it->second;
+        }
+        if (!pending.manager->CancelAsync(pending.async_id)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mtx_);
+        pending_.erase(handle);
+        return true;
+    }
+
+    /**
+     * @brief 取出所有就绪的标签
+     * @param tags 就绪的标签追加到这里
+     * @return 取出的数量（fd可读但没有标签时可能为0）
+     */
+    size_t Drain (std::vector<uint64_t>& tags) {
+        uint64_t counter;
+        while (read(fd_, &counter, sizeof(counter)) < 0 && errno == EINTR) {}
+        std::lock_guard<std::mutex> lock(mtx_);
+        size_t count = ready_.size();
+        tags.insert(tags.end(), ready_.begin(), ready_.end());
+        ready_.clear();
+        return count;
+    }
+
+    /**
+     * @brief 排队中的请求数量
+     */
+    size_t Pending () {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return pending_.size();
+    }
+
+private:
+    // token扣除成功：标签进入就绪列表，列表由空变为非空时才写eventfd
+    void OnGranted (uint64_t handle, uint64_t tag) {
+        bool was_empty;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            pending_.erase(handle);
+            was_empty = ready_.empty();
+            ready_.push_back(tag);
+            if (pending_.empty()) {
+                idle_cond_.notify_all();
+            }
+        }
+        if (was_empty) {
+            uint64_t one = 1;
+            while (write(fd_, &one, sizeof(one)) < 0 && errno == EINTR) {}
+        }
+    }
+};
+
+/**
+ * @class RefillTimerFd
+ * @brief 由事件循环驱动的token补充
+ *
+ * 与TokenProducer的独立线程模式使用相同的RefillPacer规则，但不创建线程：
+ * timerfd按唤醒间隔周期触发，事件循环在fd可读时调用OnReadable()补充token
+ * （补充可能满足TokenEventFd登记的请求，使其fd随之可读）。
+ * 只能在事件循环线程中使用。
+ */
+class RefillTimerFd {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::shared_ptr<TokenManager> token_manager_;  // 被补充的TokenManager
+    const ProducerConfig config_;                   // 速率配置（只使用rate、burst和min_interval）
+    RefillPacer pacer_;                             // 补充节拍
+    Clock::time_point epoch_;                       // 起点
+    std::chrono::nanoseconds interval_{0};          // 当前唤醒间隔
+    int fd_;                                        // timerfd，非阻塞
+
+public:
+    /**
+     * @brief 构造函数
+     * @param token_manager 被补充的TokenManager
+     * @param config 速率配置
+     * @throw std::system_error 创建timerfd失败
+     */
+    explicit RefillTimerFd(std::shared_ptr<TokenManager> token_manager, ProducerConfig config = ProducerConfig())
+        : token_manager_(std::move(token_manager)),
+          config_(config),
+          pacer_(config.rate, config.burst),
+          fd_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "timerfd_create");
+        }
+    }
+
+    RefillTimerFd(const RefillTimerFd&) = delete;
+    RefillTimerFd& operator=(const RefillTimerFd&) = delete;
+
+    ~RefillTimerFd() { close(fd_); }
+
+    /**
+     * @brief 获取可以加入epoll的文件描述符（EPOLLIN）
+     */
+    int fd () const { return fd_; }
+
+    /**
+     * @brief 开始补充：立即补充一个token，之后按速率周期触发
+     */
+    void start () {
+        epoch_ = Clock::now();
+        FitInterval();
+        Refill();
+        Arm();
+    }
+
+    /**
+     * @brief 停止触发
+     */
+    void stop () {
+        itimerspec spec{};
+        timerfd_settime(fd_, 0, &spec, nullptr);
+    }
+
+    /**
+     * @brief fd可读时调用：补充到期的token
+     * @return 实际添加的token数量
+     */
+    size_t OnReadable () {
+        uint64_t expirations;
+        while (read(fd_, &expirations, sizeof(expirations)) < 0 && errno == EINTR) {}
+        return Refill();  // 按绝对时间结算，错过的触发次数不需要单独处理
+    }
+
+    /**
+     * @brief 修改速率，从现在起按新速率补充
+     */
+    void SetRate (double rate) {
+        pacer_.SetRate(rate, Elapsed());
+        FitInterval();
+        Arm();
+    }
+
+    /**
+     * @brief 下一次补充的时间间隔
+     */
+    std::chrono::nanoseconds Interval () const { return interval_; }
+
+private:
+    double Elapsed () const {
+        return std::chrono::duration<double>(Clock::now() - epoch_).count();
+    }
+
+    size_t Refill () {
+        size_t due = pacer_.Due(Elapsed());
+        return due > 0 ? token_manager_->AddTokens(due) : 0;
+    }
+
+    // 按速率计算唤醒间隔并相应放大burst。间隔至少1ns：全零的it_value会解除定时器而不是立即触发
+    void FitInterval () {
+        interval_ = std::max(pacer_.Interval(config_.min_interval), std::chrono::nanoseconds(1));
+        pacer_.FitBurst(interval_);
+    }
+
+    // 按当前间隔设置周期定时器
+    void Arm () {
+        itimerspec spec{};
+        spec.it_interval.tv_sec = static_cast<time_t>(interval_.count() / 1000000000);
+        spec.it_interval.tv_nsec = static_cast<long>(interval_.count() % 1000000000);
+        spec.it_value = spec.it_interval;
+        timerfd_settime(fd_, 0, &spec, nullptr);
+    }
+};
@@ -5,39 +5,140 @@
  * TokenManager负责管理token的存储和线程安全的访问。
  * 它使用互斥锁和条件变量来确保多线程环境下的安全性。
  * 支持以下操作：
- * - 添加token（如果未达到最大数量）
- * - 尝试消费token（非阻塞）
+ * - 添加token（如果未达到最大数量），支持批量添加
+ * - 尝试消费token（非阻塞），或一次取走不超过n个的当前预算（TryConsumeUpTo）
  * - 阻塞等待消费token（直到有足够token）
  * - 可中断的消费token（可以响应停止信号）
+ * - 异步消费token（token足够时回调，不占用等待线程）
+ * - 统一的FIFO规则：阻塞等待者和异步请求在同一个队列中按到达顺序分配，非阻塞获取不插队
+ * - 运行中修改最大token数量（SetMaxTokens）
+ * - 透支模式（SetDebtMode）：超过最大数量的大请求在桶满时放行，余额记为欠账，还清之前其他请求等待
+ * - token变化通知（Watch），供跨多个桶的原子获取（multi_acquire.h）使用
+ *
+ * 实现为策略模板BasicTokenManager（加锁方式、等待方式、时钟、计数宽度、排队方式，见token_policies.h），
+ * TokenManager是默认策略组合（std::mutex + 条件变量 + steady_clock + size_t + FifoQueue）的别名。
  */
 
 #pragma once
 
+#include "cache_line.h"
+#include "token_policies.h"
+#include <algorithm>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 /**
- * @class TokenManager
- * @brief 线程安全的Token管理器
+ * @class BasicTokenManager
+ * @brief 按策略组合的Token管理器
+ * @tparam Lock 加锁策略：std::mutex、SpinLock、AtomicLock或NullLock
+ * @tparam Wait 等待策略：CondVarWait、FutexWait、SpinWait或NoWait
+ * @tparam Clock 可中断等待使用的时钟
+ * @tparam Counter token计数的类型（无符号整数），较窄的类型可以缩小对象
+ * @tparam Queue 排队策略：FifoQueue（等待队列、异步接口、变化通知和透支模式）或NoQueue，
+ *         默认std::mutex/SpinLock为FifoQueue，AtomicLock和NullLock为NoQueue
  * 
  * 该类使用互斥锁和条件变量实现线程安全的token管理。
  * 支持多个生产者和消费者并发访问。
+ *
+ * 会被多个线程访问时对象按缓存行对齐，锁和计数在同一缓存行上，
+ * 多个TokenManager连续存放（见TokenManagerArray）时也不会互相伪共享；
+ * NullLock（单线程）时不对齐，对象只占实际需要的大小。
+ * 策略不需要的功能在编译期去掉，连同其数据成员：NoWait时阻塞接口不可用，NoQueue时没有等待队列、
+ * 异步接口、变化通知和透支状态，例如BasicTokenManager<NullLock, NoWait, steady_clock, uint8_t>只占几个字节。
+ * 最大数量超过Counter的表示范围时截断为Counter的最大值（GetMaxTokens返回实际生效的值）。
+ *
+ * FIFO规则：token不足而等待的请求（阻塞的ConsumeTokens/ConsumeTokensWithStopCheck和ConsumeTokensAsync）
+ * 进入同一个队列，添加token时按到达顺序把token直接交给队首；队列不为空时，
+ * 所有获取路径（TryConsumeTokens、TryConsumeUpTo、MultiAcquire等）都不插队，调用方自己排队的请求也不例外；
+ * 需要越过自己的预约时使用TryConsumeTokensAhead。
+ * 队首的大请求会让后面的小请求一起等待。暂时无法满足的请求（n超过最大数量）留在原位但被跳过，不阻塞其他请求。
+ * NoQueue没有队列，阻塞等待者被唤醒后竞争token。
  */
-class TokenManager{
+template <typename Lock = std::mutex,
+          typename Wait = CondVarWait,
+          typename Clock = std::chrono::steady_clock,
+          typename Counter = size_t,
+          typename Queue = DefaultQueue<Lock>>
+class BasicTokenManager {
+    static_assert(std::is_unsigned<Counter>::value, "Counter must be an unsigned integer type");
+    static_assert(!(LockTraits<Lock>::kAtomic && Queue::kEnabled), "FifoQueue is not available with AtomicLock");
+
+public:
+    /**
+     * @brief 修改最大token数量时如何处理当前的token
+     */
+    enum class ResizePolicy {
+        kClamp,      // 超出新上限的部分丢弃
+        kPreserve,   // 保留当前数量，即使超出新上限（消费到上限以下后才能继续添加）
+        kScale,      // 按新旧上限的比例缩放，保持桶的填充比例不变
+    };
+
+    /**
+     * @brief ConsumeTokensAsync的返回值：请求永远无法满足，已拒绝
+     */
+    static constexpr uint64_t kRejected = UINT64_MAX;
+
 private:
-    const size_t max_tokens_;           // 最大token数量限制
-    size_t current_tokens_;              // 当前token数量
-    mutable std::mutex mtx_;             // 保护共享数据的互斥锁
-    std::condition_variable cond_;        // 用于线程间通信的条件变量
+    static constexpr bool kAtomic = LockTraits<Lock>::kAtomic;
+    static constexpr bool kQueue = Queue::kEnabled;
+    static constexpr bool kBlocking = Wait::template Waiter<Lock>::kBlocking;
+    static constexpr size_t kLineAlign = LockTraits<Lock>::kShared ? kCacheLineSize : alignof(Lock);
+
+    // 无锁模式下计数是原子变量，其他模式下由锁保护
+    template <typename T>
+    using Cell = std::conditional_t<kAtomic, std::atomic<T>, T>;
+
+    // 一个排队的请求：token足够时扣除n个，异步请求调用on_grant，阻塞等待者把*granted置为true
+    struct AsyncWaiter {
+        uint64_t id;
+        size_t n;
+        std::function<void()> on_grant;
+        bool* granted = nullptr;   // 阻塞等待者的完成标志（异步请求为空）
+        bool parked = false;       // 暂时无法满足（n超过最大数量），分配时跳过
+    };
+    using AsyncList = std::list<AsyncWaiter>;
+
+    // 等待队列和透支状态，NoQueue时不存在
+    struct WaitQueue {
+        AsyncList waiters;                                         // 等待者队列（FIFO）
+        std::unordered_map<uint64_t, typename AsyncList::iterator> index;  // 按ID索引，O(1)取消
+        std::vector<std::pair<uint64_t, std::function<void()>>> watchers;  // token变化通知（Watch）
+        size_t parked = 0;                                         // 队列中暂时无法满足的请求数量
+        uint64_t next_id = 1;                                      // 下一个异步等待者ID
+        size_t debt = 0;                                           // 透支模式下尚未还清的欠账
+        bool debt_mode = false;                                    // 是否开启透支模式
+    };
+    struct NoWaitQueue {};
+    struct NoCount {};
+
+    // 频繁修改的状态，从缓存行起点开始：锁和计数在同一行，加锁后访问计数不会再次缺失
+    alignas(kLineAlign) mutable Lock mtx_;  // 保护共享数据的锁
+    Cell<Counter> max_tokens_;              // 最大token数量限制（可由SetMaxTokens修改）
+    Cell<Counter> current_tokens_;          // 当前token数量
+    // 竞争token的阻塞等待者数量，只在没有队列时需要（有队列时阻塞等待者也在队列中）
+    std::conditional_t<!kQueue && kBlocking, Cell<size_t>, NoCount> waiters_{};
+    typename Wait::template Waiter<Lock> wait_;  // 等待/通知
+    std::conditional_t<kQueue, WaitQueue, NoWaitQueue> queue_;  // 等待队列和透支状态
+
+    template <typename Manager>
+    friend class BasicMultiAcquire;  // 按地址顺序同时锁住多个桶
 
 public:
     /**
      * @brief 构造函数
-     * @param max_tokens 允许的最大token数量
+     * @param max_tokens 允许的最大token数量（超过Counter的表示范围时截断为其最大值）
      */
-    explicit TokenManager(size_t max_tokens) : max_tokens_(max_tokens), current_tokens_(0) {}
+    explicit BasicTokenManager(size_t max_tokens)
+        : max_tokens_(ClampCount(max_tokens)), current_tokens_(0) {}
     
     /**
      * @brief 添加一个token
@@ -46,80 +147,317 @@ public:
      * 线程安全地增加token数量，如果未达到上限则增加并通知等待的消费者。
      */
     bool AddToken () {
-        std::lock_guard<std::mutex> lock(mtx_);
-        if (current_tokens_ < max_tokens_) {
-            current_tokens_++;
-            cond_.notify_all();  // 通知所有等待的消费者
-            return true;   
-        }        
-        return false;  // 已达到最大数量，无法添加
+        return AddTokens(1) == 1;
+    }
+
+    /**
+     * @brief 一次添加多个token
+     * @param n 要添加的token数量
+     * @return 实际添加的数量（受最大数量限制）
+     *
+     * 批量补充时只加锁一次、唤醒一次，供RefillScheduler等批量补充者使用。
+     */
+    size_t AddTokens (size_t n) {
+        std::vector<std::function<void()>> granted;
+        size_t added = 0;
+        {
+            std::lock_guard<Lock> lock(mtx_);
+            if constexpr (kQueue) {
+                // 有欠账时先还债，还清之前token不进入桶中
+                size_t repaid = std::min<size_t>(n, queue_.debt);
+                queue_.debt -= repaid;
+                n -= repaid;
+                added = repaid;
+                if (n == 0) {
+                    return added;
+                }
+            }
+            Update([this, n, &added] (Counter current) {
+                Counter max_tokens = max_tokens_;
+                size_t fill = current < max_tokens ? std::min<size_t>(n, max_tokens - current) : 0;
+                added += fill;
+                return static_cast<Counter>(current + fill);
+            });
+            if (added > 0) {
+                GrantAsyncLocked(granted);  // 按FIFO把token交给排队的请求，阻塞等待者由它唤醒
+                WatchersLocked(granted);
+                if constexpr (!kQueue) {
+                    wait_.NotifyAll();  // 没有队列，唤醒所有等待者竞争
+                }
+            }
+        }
+        RunGranted(granted);
+        return added;
     }
 
     /**
      * @brief 尝试消费指定数量的token（非阻塞）
      * @param n 要消费的token数量
-     * @return 如果成功消费返回true，如果token不足返回false
+     * @return 如果成功消费返回true，如果token不足（或有未还清的欠账、有排队的请求）返回false
      * 
      * 这是一个非阻塞操作，如果token不足会立即返回false。
      */
     bool TryConsumeTokens (size_t n) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        if (current_tokens_ >= n) {
-            current_tokens_ -= n;
-            return true;
+        std::lock_guard<Lock> lock(mtx_);
+        return TryTakeLocked(n);
+    }
+
+    /**
+     * @brief 越过调用方自己排队的请求，尝试消费n个token（非阻塞）
+     * @param n 要消费的token数量
+     * @param id 调用方自己的排队请求（ConsumeTokensAsync返回的ID）
+     * @return 成功返回true；id前面还有其他排队的请求、token不足或有未还清的欠账时返回false
+     *
+     * 只有id是队列中第一个可以满足的请求时才允许越过它：桶中现有的token本来就不够它，
+     * 越过只推迟它自己（和排在它后面、本来也要等它的请求），不会越过其他调用方。
+     * id已不在队列中时等同于TryConsumeTokens。供RateLimitedQueue让低成本任务越过等待中的队首。
+     * 需要FifoQueue排队策略。
+     */
+    bool TryConsumeTokensAhead (size_t n, uint64_t id) {
+        static_assert(kQueue, "TryConsumeTokensAhead requires the FifoQueue policy");
+        std::lock_guard<Lock> lock(mtx_);
+        for (const AsyncWaiter& waiter : queue_.waiters) {
+            if (!waiter.parked) {
+                return waiter.id == id && TakeLocked(n);
+            }
         }
-        return false;  // token不足，无法消费
+        return TakeLocked(n);
+    }
+
+    /**
+     * @brief 尽量消费最多n个token（非阻塞）
+     * @param n 最多消费的token数量
+     * @return 实际消费的数量（当前token不足n时取走全部，可能为0）
+     *
+     * 用于按字节计数等大粒度场景：一次取走当前预算，而不是等待凑满固定数量。
+     * 有排队的请求时不插队，返回0。
+     */
+    size_t TryConsumeUpTo (size_t n) {
+        std::lock_guard<Lock> lock(mtx_);
+        if (QueuedLocked()) {
+            return 0;
+        }
+        size_t taken = 0;
+        Update([n, &taken] (Counter current) {
+            taken = std::min<size_t>(n, current);
+            return static_cast<Counter>(current - taken);
+        });
+        return taken;
     }
 
     /**
      * @brief 阻塞等待并消费指定数量的token
      * @param n 要消费的token数量
-     * @return 总是返回true（因为会等待直到有足够token）
+     * @return 获取成功返回true；请求永远无法满足（n超过最大数量且未开启透支模式）时立即返回false
      * 
-     * 如果当前token不足，会阻塞等待直到有足够的token。
+     * 如果当前token不足，会阻塞等待直到有足够的token（按FIFO排队）。
      * 注意：此方法无法被中断，可能导致线程永久阻塞。
      */
     bool ConsumeTokens (size_t n) {
-        std::unique_lock<std::mutex> lock(mtx_);
-        // 等待直到有足够的token
-        cond_.wait(lock, [this, n] () {
-            return current_tokens_ >= n;
-        });
-        current_tokens_ -= n;
-        return true;
+        static_assert(Wait::template Waiter<Lock>::kBlocking, "blocking consume requires a blocking Wait policy");
+        std::vector<std::function<void()>> granted;
+        std::unique_lock<Lock> lock(mtx_);
+        bool taken = WaitTakeLocked(lock, n, nullptr, granted);
+        lock.unlock();
+        RunGranted(granted);
+        return taken;
     }
 
     /**
      * @brief 可中断地消费指定数量的token
      * @param n 要消费的token数量
      * @param stop_flag 指向停止标志的指针，如果为true则中断等待
-     * @return 如果成功消费返回true，如果被停止信号中断返回false
+     * @return 如果成功消费返回true，如果被停止信号中断或请求永远无法满足返回false（可用Feasible区分）
      * 
-     * 这是一个可中断的消费操作。如果token不足，会使用wait_for定期检查停止标志。
+     * 这是一个可中断的消费操作。如果token不足，会使用带超时的等待定期检查停止标志。
      * 每100ms检查一次，如果stop_flag为true则立即返回false。
      * 这允许线程在等待时响应停止信号，避免永久阻塞。
      */
     bool ConsumeTokensWithStopCheck (size_t n, std::atomic<bool>* stop_flag) {
-        std::unique_lock<std::mutex> lock(mtx_);
-        while (current_tokens_ < n) {
-            // 检查停止标志
-            if (stop_flag && stop_flag->load()) {
-                return false;  // 被停止信号中断
-            }
-            // 使用wait_for定期检查，每100ms检查一次
-            cond_.wait_for(lock, std::chrono::milliseconds(100), [this, n, stop_flag] () {
-                return current_tokens_ >= n || (stop_flag && stop_flag->load());
-            });
-            // 再次检查停止标志
-            if (stop_flag && stop_flag->load()) {
-                return false;  // 被停止信号中断
+        static_assert(Wait::template Waiter<Lock>::kBlocking, "blocking consume requires a blocking Wait policy");
+        std::vector<std::function<void()>> granted;
+        std::unique_lock<Lock> lock(mtx_);
+        bool taken = WaitTakeLocked(lock, n, stop_flag, granted);
+        lock.unlock();
+        RunGranted(granted);
+        return taken;
+    }
+
+    /**
+     * @brief 异步消费指定数量的token
+     * @param n 要消费的token数量
+     * @param on_grant token扣除成功后调用的回调
+     * @return 等待者ID（可用于CancelAsync）；如果token足够、已立即扣除并调用了回调，返回0；
+     *         请求永远无法满足（n超过最大数量且未开启透支模式）时返回kRejected，不调用回调
+     *
+     * 不阻塞调用线程。token不足时把请求挂入FIFO队列（与阻塞等待者共用），之后由添加token的线程扣除并调用回调。
+     * 回调总是在释放内部锁之后调用，可以在回调中再次调用本类的方法；
+     * 但回调运行在生产者（或调度器）线程上，应尽快返回，例如只把任务投递到线程池。
+     * 需要FifoQueue排队策略。
+     */
+    uint64_t ConsumeTokensAsync (size_t n, std::function<void()> on_grant) {
+        static_assert(kQueue, "ConsumeTokensAsync requires the FifoQueue policy");
+        {
+            std::lock_guard<Lock> lock(mtx_);
+            if (!FeasibleLocked(n)) {
+                return kRejected;
+            }
+            if (!TryTakeLocked(n)) {
+                return EnqueueLocked(n, std::move(on_grant), nullptr);
             }
         }
-        // 有足够的token，执行消费
-        current_tokens_ -= n;
+        on_grant();
+        return 0;
+    }
+
+    /**
+     * @brief 取消一个尚未满足的异步消费请求
+     * @param id ConsumeTokensAsync返回的等待者ID
+     * @return 如果请求仍在排队并被取消返回true；已经满足（回调已调用或即将调用）返回false
+     */
+    bool CancelAsync (uint64_t id) {
+        static_assert(kQueue, "CancelAsync requires the FifoQueue policy");
+        std::vector<std::function<void()>> granted;
+        {
+            std::lock_guard<Lock> lock(mtx_);
+            auto it = queue_.index.find(id);
+            if (it == queue_.index.end()) {
+                return false;
+            }
+            RemoveLocked(it->second);
+            GrantAsyncLocked(granted);  // 队首被取消后，后面的请求可能已经可以满足
+        }
+        RunGranted(granted);
         return true;
     }
 
+    /**
+     * @brief 在运行中修改最大token数量
+     * @param max_tokens 新的最大token数量（超过Counter的表示范围时截断为其最大值）
+     * @param policy 当前token的处理方式
+     *
+     * 原子地生效，不影响正在等待的消费者：修改后立即按新的数量重新检查阻塞等待者和异步请求
+     * （例如按比例放大后可能已经可以满足）。只加一次锁，O(1)，可以高频地批量推送到大量桶。
+     */
+    void SetMaxTokens (size_t max_tokens, ResizePolicy policy = ResizePolicy::kClamp) {
+        std::vector<std::function<void()>> granted;
+        {
+            std::lock_guard<Lock> lock(mtx_);
+            Counter new_max = ClampCount(max_tokens);
+            Counter old_max = max_tokens_;
+            max_tokens_ = new_max;
+            Update([new_max, old_max, policy] (Counter current) {
+                switch (policy) {
+                case ResizePolicy::kClamp:
+                    return std::min(current, new_max);
+                case ResizePolicy::kPreserve:
+                    return current;
+                case ResizePolicy::kScale:
+                    break;
+                }
+                Counter scaled = old_max > 0
+                    ? static_cast<Counter>(static_cast<double>(current) * new_max / old_max)
+                    : 0;
+                return std::min(scaled, new_max);
+            });
+            ParkLocked();
+            GrantAsyncLocked(granted);
+            WatchersLocked(granted);
+            wait_.NotifyAll();  // 让阻塞的消费者按新的数量重新检查
+        }
+        RunGranted(granted);
+    }
+
+    /**
+     * @brief 注册token变化通知
+     * @param on_change 添加了token、修改了最大数量或透支模式之后调用的回调
+     * @return 通知ID（用于Unwatch）
+     *
+     * 回调和异步请求的回调一样在释放内部锁之后、在修改者的线程上调用，不扣除token，
+     * 可能在Unwatch返回之后仍有一次调用正在进行，回调引用的状态应由回调自己持有。
+     * 每次变化按注册顺序调用所有回调，开销与注册数量成正比。
+     * 注册数量由GetWatchers单独统计，不计入GetWaiters。需要FifoQueue排队策略。
+     */
+    uint64_t Watch (std::function<void()> on_change) {
+        static_assert(kQueue, "Watch requires the FifoQueue policy");
+        std::lock_guard<Lock> lock(mtx_);
+        uint64_t id = queue_.next_id++;
+        queue_.watchers.emplace_back(id, std::move(on_change));
+        return id;
+    }
+
+    /**
+     * @brief 取消token变化通知
+     * @param id Watch返回的通知ID
+     */
+    void Unwatch (uint64_t id) {
+        static_assert(kQueue, "Unwatch requires the FifoQueue policy");
+        std::lock_guard<Lock> lock(mtx_);
+        auto& watchers = queue_.watchers;
+        for (auto it = watchers.begin(); it != watchers.end(); ++it) {
+            if (it->first == id) {
+                watchers.erase(it);  // 保持注册顺序
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief 开启或关闭透支模式
+     * @param enabled 是否开启
+     *
+     * 默认关闭：超过最大数量的请求永远无法满足，各个获取接口立即返回失败（ConsumeTokensAsync返回kRejected），
+     * 而不是永久等待。开启后，这样的大请求在桶满时放行：桶清空，不足的部分记为欠账，
+     * 之后添加的token先用于还债，还清之前所有获取都等待。长期来看速率仍然不超过补充速率。
+     * 关闭时已有的欠账照常偿还；已经排队、变得无法满足的异步请求不会被拒绝，而是留在队列中但不再阻塞其他请求，
+     * 重新开启后恢复原来的位置，需要时用CancelAsync取消。
+     * 需要FifoQueue排队策略。
+     */
+    void SetDebtMode (bool enabled) {
+        static_assert(kQueue, "SetDebtMode requires the FifoQueue policy");
+        std::vector<std::function<void()>> granted;
+        {
+            std::lock_guard<Lock> lock(mtx_);
+            queue_.debt_mode = enabled;
+            ParkLocked();
+            GrantAsyncLocked(granted);
+            WatchersLocked(granted);
+            wait_.NotifyAll();  // 让阻塞的消费者按新的模式重新检查（关闭时无法满足的请求返回失败）
+        }
+        RunGranted(granted);
+    }
+
+    /**
+     * @brief 获取尚未还清的欠账（没有透支模式的NoQueue时恒为0）
+     */
+    size_t GetDebt () const {
+        std::lock_guard<Lock> lock(mtx_);
+        if constexpr (kQueue) {
+            return queue_.debt;
+        } else {
+            return 0;
+        }
+    }
+
+    /**
+     * @brief 请求n个token是否有可能被满足
+     * @return n不超过最大数量，或已开启透支模式时返回true
+     *
+     * 用于区分ConsumeTokens/ConsumeTokensWithStopCheck返回false的原因。
+     */
+    bool Feasible (size_t n) const {
+        std::lock_guard<Lock> lock(mtx_);
+        return FeasibleLocked(n);
+    }
+
+    /**
+     * @brief 获取最大token数量
+     */
+    size_t GetMaxTokens () const {
+        std::lock_guard<Lock> lock(mtx_);
+        return max_tokens_;
+    }
+
     /**
      * @brief 获取当前token数量
      * @return 当前token数量
@@ -127,16 +465,265 @@ public:
      * 线程安全地获取当前token数量。
      */
     size_t GetTokens () const {
-        std::lock_guard<std::mutex> lock(mtx_);
+        std::lock_guard<Lock> lock(mtx_);
         return current_tokens_;
     }
+
+    /**
+     * @brief 获取正在阻塞等待token的消费者数量
+     * @return 等待者数量
+     *
+     * 包括阻塞等待的线程和排队中的异步请求，反映消费者的积压程度，
+     * 供自适应速率控制（RateController）使用。变化通知（Watch）不计入，见GetWatchers。
+     */
+    size_t GetWaiters () const {
+        std::lock_guard<Lock> lock(mtx_);
+        if constexpr (kQueue) {
+            return queue_.waiters.size();
+        } else if constexpr (kBlocking) {
+            return waiters_;
+        } else {
+            return 0;
+        }
+    }
+
+    /**
+     * @brief 获取注册的变化通知数量（例如在本桶上阻塞的MultiAcquire）
+     *
+     * 通知不在本桶上排队，其中多数在等待其他桶，因此与GetWaiters分开统计。
+     */
+    size_t GetWatchers () const {
+        std::lock_guard<Lock> lock(mtx_);
+        if constexpr (kQueue) {
+            return queue_.watchers.size();
+        } else {
+            return 0;
+        }
+    }
     
     /**
      * @brief 析构函数
      */
-    ~TokenManager();
+    ~BasicTokenManager();
+
+private:
+    // 用f(当前数量)更新token数量（调用时已持有锁）；无锁模式下用CAS循环，值不变时不写
+    template <typename F>
+    void Update (F f) {
+        if constexpr (kAtomic) {
+            Counter current = current_tokens_.load(std::memory_order_relaxed);
+            Counter next;
+            do {
+                next = f(current);
+                if (next == current) {
+                    return;
+                }
+            } while (!current_tokens_.compare_exchange_weak(current, next, std::memory_order_acq_rel,
+                                                            std::memory_order_relaxed));
+        } else {
+            current_tokens_ = f(current_tokens_);
+        }
+    }
+
+    // 现在能否扣除n个token：没有欠账且token足够；透支模式下超过最大数量的请求在桶满时也可以（调用时已持有锁）
+    bool CanTakeLocked (size_t n) const {
+        if constexpr (kQueue) {
+            if (queue_.debt > 0) {
+                return false;
+            }
+            return current_tokens_ >= n || (queue_.debt_mode && n > max_tokens_ && current_tokens_ >= max_tokens_);
+        } else if constexpr (kAtomic) {
+            return current_tokens_.load(std::memory_order_relaxed) >= n;
+        } else {
+            return current_tokens_ >= n;
+        }
+    }
+
+    // 请求是否有可能被满足（调用时已持有锁）
+    bool FeasibleLocked (size_t n) const {
+        if constexpr (kQueue) {
+            return n <= static_cast<size_t>(max_tokens_) || queue_.debt_mode;
+        } else {
+            return n <= static_cast<size_t>(max_tokens_);
+        }
+    }
+
+    // 把数量截断到Counter的表示范围
+    static Counter ClampCount (size_t n) {
+        return static_cast<Counter>(std::min<size_t>(n, std::numeric_limits<Counter>::max()));
+    }
+
+    // 如果可以则扣除n个token并返回true，不足的部分记为欠账（调用时已持有锁）
+    bool TakeLocked (size_t n) {
+        if constexpr (kQueue) {
+            if (!CanTakeLocked(n)) {
+                return false;
+            }
+            Counter current = current_tokens_;
+            if (n > current) {
+                queue_.debt = n - current;  // 透支：桶清空，余额记为欠账
+                current_tokens_ = 0;
+            } else {
+                current_tokens_ = static_cast<Counter>(current - n);
+            }
+            return true;
+        }
+        bool taken = false;
+        Update([n, &taken] (Counter current) {
+            taken = current >= n;
+            return taken ? static_cast<Counter>(current - n) : current;
+        });
+        return taken;
+    }
+
+    // 是否有排队的请求（调用时已持有锁）；有时其他获取路径不插队，暂时无法满足的请求不算
+    bool QueuedLocked () const {
+        if constexpr (kQueue) {
+            return queue_.waiters.size() > queue_.parked;
+        } else {
+            return false;
+        }
+    }
+
+    // 不插队地检查现在能否扣除n个token（调用时已持有锁）
+    bool ReadyLocked (size_t n) const {
+        return !QueuedLocked() && CanTakeLocked(n);
+    }
+
+    // 不插队地扣除n个token（调用时已持有锁）
+    bool TryTakeLocked (size_t n) {
+        return !QueuedLocked() && TakeLocked(n);
+    }
+
+    // 把请求挂入队尾，返回ID（调用时已持有锁）
+    uint64_t EnqueueLocked (size_t n, std::function<void()> on_grant, bool* granted) {
+        uint64_t id = queue_.next_id++;
+        queue_.waiters.push_back(AsyncWaiter{id, n, std::move(on_grant), granted});
+        queue_.index.emplace(id, std::prev(queue_.waiters.end()));
+        return id;
+    }
+
+    // 从队列中摘除一个请求（调用时已持有锁）
+    void RemoveLocked (typename AsyncList::iterator it) {
+        queue_.parked -= it->parked ? 1 : 0;
+        queue_.index.erase(it->id);
+        queue_.waiters.erase(it);
+    }
+
+    // 最大数量或透支模式变化后，重新标记暂时无法满足的请求，它们留在原位但不阻塞后面的请求（调用时已持有锁）
+    void ParkLocked () {
+        if constexpr (kQueue) {
+            queue_.parked = 0;
+            for (AsyncWaiter& waiter : queue_.waiters) {
+                waiter.parked = !FeasibleLocked(waiter.n);
+                queue_.parked += waiter.parked ? 1 : 0;
+            }
+        }
+    }
+
+    // 阻塞等待并扣除n个token（调用时已持有锁）：有队列时排队、由添加token的线程按FIFO交付，否则被唤醒后竞争；
+    // stop_flag不为空时每100ms检查一次。放弃等待时摘除请求，之后可以满足的回调收集到granted中
+    bool WaitTakeLocked (std::unique_lock<Lock>& lock, size_t n, std::atomic<bool>* stop_flag,
+                         std::vector<std::function<void()>>& granted) {
+        auto stopped = [stop_flag] () { return stop_flag && stop_flag->load(); };
+        if constexpr (!kQueue) {
+            (void)granted;
+            while (!TakeLocked(n)) {
+                if (stopped() || !FeasibleLocked(n)) {
+                    return false;  // 被停止信号中断，或永远无法满足
+                }
+                auto ready = [this, n, &stopped] () { return CanTakeLocked(n) || !FeasibleLocked(n) || stopped(); };
+                waiters_++;
+                if (stop_flag) {
+                    wait_.WaitUntil(lock, Clock::now() + std::chrono::milliseconds(100), ready);
+                } else {
+                    wait_.Wait(lock, ready);
+                }
+                waiters_--;
+            }
+            return true;
+        } else {
+            if (TryTakeLocked(n)) {
+                return true;
+            }
+            if (stopped() || !FeasibleLocked(n)) {
+                return false;
+            }
+            bool done = false;
+            uint64_t id = EnqueueLocked(n, nullptr, &done);
+            auto finished = [this, n, &done, &stopped] () { return done || !FeasibleLocked(n) || stopped(); };
+            while (!finished()) {
+                if (stop_flag) {
+                    wait_.WaitUntil(lock, Clock::now() + std::chrono::milliseconds(100), finished);
+                } else {
+                    wait_.Wait(lock, finished);
+                }
+            }
+            if (done) {
+                return true;  // token已经交付，即使同时收到了停止信号
+            }
+            RemoveLocked(queue_.index.at(id));
+            GrantAsyncLocked(granted);  // 队首放弃后，后面的请求可能已经可以满足
+            return false;
+        }
+    }
+
+    // 按FIFO顺序满足排队的请求（调用时已持有锁）：异步回调收集到granted中，阻塞等待者标记完成并唤醒
+    void GrantAsyncLocked (std::vector<std::function<void()>>& granted) {
+        if constexpr (kQueue) {
+            bool woke = false;
+            auto it = queue_.waiters.begin();
+            while (it != queue_.waiters.end()) {
+                if (it->parked) {
+                    ++it;  // 跳过暂时无法满足的请求
+                    continue;
+                }
+                if (!CanTakeLocked(it->n)) {
+                    break;
+                }
+                TakeLocked(it->n);
+                if (it->granted) {
+                    *it->granted = true;
+                    woke = true;
+                } else {
+                    granted.push_back(std::move(it->on_grant));
+                }
+                queue_.index.erase(it->id);
+                it = queue_.waiters.erase(it);
+            }
+            if (woke) {
+                wait_.NotifyAll();
+            }
+        } else {
+            (void)granted;
+        }
+    }
+
+    // 复制所有变化通知，与已满足的异步回调一起在锁外调用（调用时已持有锁）
+    void WatchersLocked (std::vector<std::function<void()>>& granted) {
+        if constexpr (kQueue) {
+            for (const auto& watcher : queue_.watchers) {
+                granted.push_back(watcher.second);
+            }
+        } else {
+            (void)granted;
+        }
+    }
+
+    // 在锁外调用已满足的异步回调
+    static void RunGranted (std::vector<std::function<void()>>& granted) {
+        for (auto& on_grant : granted) {
+            on_grant();
+        }
+    }
 };
 
 // 析构函数实现（空实现）
-TokenManager::~TokenManager(){
+template <typename Lock, typename Wait, typename Clock, typename Counter, typename Queue>
+BasicTokenManager<Lock, Wait, Clock, Counter, Queue>::~BasicTokenManager(){
 }
+
+/**
+ * @brief 默认的Token管理器：std::mutex + 条件变量 + steady_clock + size_t计数 + FIFO队列
+ */
+using TokenManager = BasicTokenManager<>;
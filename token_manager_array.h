@@ -0,0 +1,88 @@
+/**
+ * @file token_manager_array.h
+ * @brief 连续存放的TokenManager数组
+ *
+ * 大量桶（例如每个用户、每个连接一个）放在一块连续内存里，遍历和分配都更快。
+ * TokenManager按缓存行对齐，这里用对齐分配保证每个元素从缓存行边界开始，
+ * 相邻的桶由不同线程操作时不会伪共享。
+ * TokenManager不可复制、不可移动，不能直接放进std::vector，因此使用固定大小的数组。
+ * 可以指定NUMA节点，整块内存分配在该节点上，供固定在该节点上的线程使用。
+ */
+
+#pragma once
+
+#include "numa.h"
+#include "token_manager.h"
+#include <cstddef>
+#include <memory>
+#include <new>
+
+/**
+ * @class TokenManagerArray
+ * @brief 固定大小、按缓存行对齐的TokenManager数组
+ */
+class TokenManagerArray {
+private:
+    const size_t size_;             // 元素数量
+    const int node_;                // 内存所在的NUMA节点，小于0表示不指定
+    TokenManager* managers_;        // 对齐分配的连续内存
+
+public:
+    /**
+     * @brief 构造函数
+     * @param count 桶的数量
+     * @param max_tokens 每个桶的最大token数量
+     * @param node 分配在哪个NUMA节点上（见numa.h），默认不指定
+     */
+    TokenManagerArray(size_t count, size_t max_tokens, int node = -1)
+        : size_(count),
+          node_(node),
+          managers_(static_cast<TokenManager*>(
+              node < 0 ? ::operator new(sizeof(TokenManager) * count, std::align_val_t(alignof(TokenManager)))
+                       : NumaAllocate(sizeof(TokenManager) * count, node))) {
+        for (size_t i = 0; i < size_; i++) {
+            new (&managers_[i]) TokenManager(max_tokens);
+        }
+    }
+
+    TokenManagerArray(const TokenManagerArray&) = delete;
+    TokenManagerArray& operator=(const TokenManagerArray&) = delete;
+
+    /**
+     * @brief 析构函数
+     */
+    ~TokenManagerArray() {
+        for (size_t i = 0; i < size_; i++) {
+            managers_[i].~TokenManager();
+        }
+        if (node_ < 0) {
+            ::operator delete(managers_, std::align_val_t(alignof(TokenManager)));
+        } else {
+            NumaFree(managers_, sizeof(TokenManager) * size_);
+        }
+    }
+
+    /**
+     * @brief 按下标访问
+     */
+    TokenManager& operator[] (size_t index) { return managers_[index]; }
+    const TokenManager& operator[] (size_t index) const { return managers_[index]; }
+
+    /**
+     * @brief 获取元素数量
+     */
+    size_t size () const { return size_; }
+
+    TokenManager* begin () { return managers_; }
+    TokenManager* end () { return managers_ + size_; }
+
+    /**
+     * @brief 获取指向某个桶的shared_ptr
+     * @param array 由shared_ptr管理的数组
+     * @param index 下标
+     * @return 与数组共享所有权的指针，可以直接交给TokenProducer/TokenCustomer
+     */
+    static std::shared_ptr<TokenManager> Share (const std::shared_ptr<TokenManagerArray>& array, size_t index) {
+        return std::shared_ptr<TokenManager>(array, &(*array)[index]);
+    }
+};
@@ -0,0 +1,404 @@
+/**
+ * @file token_policies.h
+ * @brief BasicTokenManager的策略类 - 加锁方式、等待方式和排队方式
+ *
+ * BasicTokenManager按策略在编译期组合，不用的功能不产生任何代码和数据：
+ * - 加锁策略：std::mutex（默认）、SpinLock、AtomicLock（计数用原子变量无锁更新）、NullLock（单线程）
+ * - 等待策略：CondVarWait（默认）、FutexWait、SpinWait、AdaptiveWait（先自旋再睡眠）、NoWait（只允许非阻塞操作）
+ * - 排队策略：FifoQueue（std::mutex/SpinLock的默认）、NoQueue（AtomicLock/NullLock的默认）
+ * 时钟和计数宽度直接作为BasicTokenManager的模板参数。
+ */
+
+#pragma once
+
+#include "cpu_relax.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// ==================== 加锁策略 ====================
+
+/**
+ * @class SpinLock
+ * @brief 自旋锁，临界区很短且线程数不超过核数时比std::mutex更快
+ *
+ * 先用只读load自旋，锁释放后才尝试exchange，避免持续写缓存行。
+ */
+class SpinLock {
+private:
+    std::atomic<bool> locked_{false};
+
+public:
+    void lock () {
+        while (locked_.exchange(true, std::memory_order_acquire)) {
+            unsigned spins = 0;
+            while (locked_.load(std::memory_order_relaxed)) {
+                if (++spins < 64) {
+                    CpuRelax();
+                } else {
+                    std::this_thread::yield();  // 持锁线程可能被抢占，让出CPU
+                }
+            }
+        }
+    }
+
+    bool try_lock () {
+        return !locked_.load(std::memory_order_relaxed) &&
+               !locked_.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock () {
+        locked_.store(false, std::memory_order_release);
+    }
+};
+
+/**
+ * @struct NullLock
+ * @brief 空锁，只在单线程中使用
+ */
+struct NullLock {
+    void lock () {}
+    bool try_lock () { return true; }
+    void unlock () {}
+};
+
+/**
+ * @struct AtomicLock
+ * @brief 无锁模式：不加锁，token计数用原子变量CAS更新
+ *
+ * 多线程安全，但没有等待队列（只能配合NoQueue），不支持异步消费（ConsumeTokensAsync）；
+ * 阻塞等待需配合FutexWait或SpinWait。
+ */
+struct AtomicLock {
+    void lock () {}
+    bool try_lock () { return true; }
+    void unlock () {}
+};
+
+/**
+ * @brief 加锁策略的特性
+ */
+template <typename Lock>
+struct LockTraits {
+    static constexpr bool kAtomic = std::is_same<Lock, AtomicLock>::value;  // 计数使用原子变量
+    static constexpr bool kShared = !std::is_same<Lock, NullLock>::value;   // 会被多个线程访问
+};
+
+// ==================== 等待策略 ====================
+// 每个等待策略提供 Waiter<Lock>：
+//   Wait(lock, pred)                   等待直到pred()为true（pred在持锁时调用）
+//   WaitUntil(lock, deadline, pred)    带截止时间的等待，返回pred()
+//   NotifyAll()                        token增加后调用（持锁）
+//   kBlocking                          是否支持阻塞等待
+
+/**
+ * @struct CondVarWait
+ * @brief 条件变量等待（默认），需要配合真正的锁（std::mutex或SpinLock）
+ */
+struct CondVarWait {
+    template <typename Lock>
+    class Waiter {
+    private:
+        static_assert(LockTraits<Lock>::kShared && !LockTraits<Lock>::kAtomic,
+                      "CondVarWait requires a real lock (std::mutex or SpinLock)");
+        // std::mutex用更快的std::condition_variable，其他锁用condition_variable_any
+        using Cond = std::conditional_t<std::is_same<Lock, std::mutex>::value,
+                                        std::condition_variable, std::condition_variable_any>;
+        Cond cond_;
+
+    public:
+        static constexpr bool kBlocking = true;
+
+        template <typename Pred>
+        void Wait (std::unique_lock<Lock>& lock, Pred pred) {
+            cond_.wait(lock, pred);
+        }
+
+        template <typename TimePoint, typename Pred>
+        bool WaitUntil (std::unique_lock<Lock>& lock, TimePoint deadline, Pred pred) {
+            return cond_.wait_until(lock, deadline, pred);
+        }
+
+        void NotifyAll () {
+            cond_.notify_all();
+        }
+    };
+};
+
+/**
+ * @struct FutexWait
+ * @brief 基于Linux futex的等待，状态只有两个32位整数，没有等待者时通知不进入内核
+ *
+ * 可以配合AtomicLock使用（无锁计数+内核等待）。非Linux平台退化为让出CPU的轮询。
+ */
+struct FutexWait {
+    template <typename Lock>
+    class Waiter {
+    private:
+        std::atomic<uint32_t> seq_{0};       // 每次通知加1，等待者在这个字上睡眠
+        std::atomic<uint32_t> sleepers_{0};  // 正在睡眠的线程数
+
+    public:
+        static constexpr bool kBlocking = true;
+
+        template <typename Pred>
+        void Wait (std::unique_lock<Lock>& lock, Pred pred) {
+            for (;;) {
+                // 先读序号再检查条件：检查之后的通知一定会改变序号，futex不会错过
+                uint32_t seq = seq_.load();
+                if (pred()) {
+                    return;
+                }
+                Sleep(lock, seq, nullptr);
+            }
+        }
+
+        template <typename TimePoint, typename Pred>
+        bool WaitUntil (std::unique_lock<Lock>& lock, TimePoint deadline, Pred pred) {
+            using TimeClock = typename TimePoint::clock;
+            for (;;) {
+                uint32_t seq = seq_.load();
+                if (pred()) {
+                    return true;
+                }
+                auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - TimeClock::now());
+                if (remaining <= std::chrono::nanoseconds::zero()) {
+                    return pred();
+                }
+                Sleep(lock, seq, &remaining);
+            }
+        }
+
+        void NotifyAll () {
+            seq_.fetch_add(1);
+            if (sleepers_.load() > 0) {
+#if defined(__linux__)
+                syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq_), FUTEX_WAKE_PRIVATE, INT32_MAX,
+                        nullptr, nullptr, 0);
+#endif
+            }
+        }
+
+    private:
+        void Sleep (std::unique_lock<Lock>& lock, uint32_t seq, const std::chrono::nanoseconds* timeout) {
+            sleepers_.fetch_add(1);
+            lock.unlock();
+#if defined(__linux__)
+            timespec ts;
+            if (timeout) {
+                ts.tv_sec = static_cast<time_t>(timeout->count() / 1000000000);
+                ts.tv_nsec = static_cast<long>(timeout->count() % 1000000000);
+            }
+            // 序号已经变化时立即返回（EAGAIN），不会错过唤醒
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq_), FUTEX_WAIT_PRIVATE, seq,
+                    timeout ? &ts : nullptr, nullptr, 0);
+#else
+            (void)seq;
+            (void)timeout;
+            std::this_thread::yield();
+#endif
+            lock.lock();
+            sleepers_.fetch_sub(1);
+        }
+    };
+};
+
+/**
+ * @struct SpinWait
+ * @brief 自旋等待，没有任何通知开销，适合token很快就会到来、且有空闲核的场景
+ */
+struct SpinWait {
+    template <typename Lock>
+    class Waiter {
+    public:
+        static constexpr bool kBlocking = true;
+
+        template <typename Pred>
+        void Wait (std::unique_lock<Lock>& lock, Pred pred) {
+            unsigned spins = 0;
+            while (!pred()) {
+                Relax(lock, spins);
+            }
+        }
+
+        template <typename TimePoint, typename Pred>
+        bool WaitUntil (std::unique_lock<Lock>& lock, TimePoint deadline, Pred pred) {
+            using TimeClock = typename TimePoint::clock;
+            unsigned spins = 0;
+            while (!pred()) {
+                if (TimeClock::now() >= deadline) {
+                    return false;
+                }
+                Relax(lock, spins);
+            }
+            return true;
+        }
+
+        void NotifyAll () {}
+
+    private:
+        // 释放锁让生产者能添加token；自旋一段时间后改为让出CPU
+        static void Relax (std::unique_lock<Lock>& lock, unsigned& spins) {
+            lock.unlock();
+            if (++spins < 64) {
+                CpuRelax();
+            } else {
+                std::this_thread::yield();
+            }
+            lock.lock();
+        }
+    };
+};
+
+/**
+ * @struct AdaptiveWait
+ * @brief 先自旋、再睡眠的自适应等待，自旋时长按最近的补充间隔自动调整
+ *
+ * 每次通知（补充token）记录与上一次通知的间隔，取指数平均。等待时先自旋约两个补充间隔，
+ * token在自旋期间到来就省掉一次睡眠/唤醒（数十微秒）；仍未满足则改用futex睡眠。
+ * 补充间隔超过max_spin_ns（包括桶空闲、长时间没有补充）或只有一个CPU时不自旋，空闲时不占用CPU。
+ * 可以配合任意加锁策略，包括AtomicLock。
+ */
+template <int64_t MaxSpinNs = 50000>
+struct BasicAdaptiveWait {
+    template <typename Lock>
+    class Waiter {
+    private:
+        using SteadyClock = std::chrono::steady_clock;
+
+        typename FutexWait::template Waiter<Lock> park_;  // 睡眠/唤醒
+        std::atomic<int64_t> last_notify_ns_{0};          // 上一次通知的时间
+        std::atomic<int64_t> interval_ns_{MaxSpinNs + 1}; // 补充间隔的指数平均，初始不自旋
+
+    public:
+        static constexpr bool kBlocking = true;
+
+        template <typename Pred>
+        void Wait (std::unique_lock<Lock>& lock, Pred pred) {
+            if (!Spin(lock, pred, SteadyClock::time_point::max())) {
+                park_.Wait(lock, pred);
+            }
+        }
+
+        template <typename TimePoint, typename Pred>
+        bool WaitUntil (std::unique_lock<Lock>& lock, TimePoint deadline, Pred pred) {
+            using TimeClock = typename TimePoint::clock;
+            auto remaining = std::chrono::duration_cast<SteadyClock::duration>(deadline - TimeClock::now());
+            if (Spin(lock, pred, SteadyClock::now() + remaining)) {
+                return true;
+            }
+            return park_.WaitUntil(lock, deadline, pred);
+        }
+
+        void NotifyAll () {
+            int64_t now = NowNs();
+            int64_t last = last_notify_ns_.exchange(now, std::memory_order_relaxed);
+            if (last > 0) {
+                // 间隔的指数平均（权重1/8）；并发通知时偶尔丢失一次更新不影响估计
+                int64_t interval = std::min<int64_t>(now - last, 2 * MaxSpinNs);
+                int64_t avg = interval_ns_.load(std::memory_order_relaxed);
+                interval_ns_.store(avg + (interval - avg) / 8, std::memory_order_relaxed);
+            }
+            park_.NotifyAll();
+        }
+
+    private:
+        static int64_t NowNs () {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                SteadyClock::now().time_since_epoch()).count();
+        }
+
+        // 本次等待的自旋时长：约两个补充间隔；间隔过长、补充已经停止或只有一个CPU时为0
+        int64_t SpinBudget () const {
+            static const bool kSingleCpu = std::thread::hardware_concurrency() <= 1;
+            int64_t interval = interval_ns_.load(std::memory_order_relaxed);
+            if (kSingleCpu || interval > MaxSpinNs ||
+                NowNs() - last_notify_ns_.load(std::memory_order_relaxed) > 4 * MaxSpinNs) {
+                return 0;
+            }
+            return std::min<int64_t>(2 * interval, MaxSpinNs);
+        }
+
+        // 自旋等待pred()，在预算内满足返回true
+        template <typename Pred>
+        bool Spin (std::unique_lock<Lock>& lock, Pred pred, SteadyClock::time_point deadline) {
+            if (pred()) {
+                return true;
+            }
+            int64_t budget = SpinBudget();
+            if (budget == 0) {
+                return false;
+            }
+            SteadyClock::time_point end = std::min(deadline, SteadyClock::now() + std::chrono::nanoseconds(budget));
+            for (unsigned spins = 1;; spins++) {
+                lock.unlock();
+                CpuRelax();
+                lock.lock();
+                if (pred()) {
+                    return true;
+                }
+                // 每16轮读一次时钟，降低自旋本身的开销
+                if (spins % 16 == 0 && SteadyClock::now() >= end) {
+                    return false;
+                }
+            }
+        }
+    };
+};
+
+/**
+ * @brief 默认参数的自适应等待：补充间隔在50微秒以内时自旋
+ */
+using AdaptiveWait = BasicAdaptiveWait<>;
+
+/**
+ * @struct NoWait
+ * @brief 不支持阻塞等待，只能使用TryConsumeTokens/ConsumeTokensAsync；通知为空操作
+ */
+struct NoWait {
+    template <typename Lock>
+    class Waiter {
+    public:
+        static constexpr bool kBlocking = false;
+
+        void NotifyAll () {}
+    };
+};
+
+// ==================== 排队策略 ====================
+
+/**
+ * @struct FifoQueue
+ * @brief 等待队列：token不足的请求按FIFO排队，支持ConsumeTokensAsync、Watch和透支模式
+ *
+ * 队列、索引、变化通知列表和欠账一共约一百字节，不能与AtomicLock组合。
+ */
+struct FifoQueue {
+    static constexpr bool kEnabled = true;
+};
+
+/**
+ * @struct NoQueue
+ * @brief 没有等待队列：阻塞等待者被唤醒后竞争token，只提供同步接口，不产生任何数据成员
+ */
+struct NoQueue {
+    static constexpr bool kEnabled = false;
+};
+
+/**
+ * @brief 默认排队策略：多线程加锁模式为FifoQueue；AtomicLock（不支持）和NullLock（单线程，通常只做非阻塞判断）为NoQueue
+ */
+template <typename Lock>
+using DefaultQueue = std::conditional_t<LockTraits<Lock>::kShared && !LockTraits<Lock>::kAtomic, FifoQueue, NoQueue>;
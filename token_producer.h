@@ -1,76 +1,313 @@
 /**
  * @file token_producer.h
- * @brief Token生产者类 - 定期向TokenManager添加token的线程
- * 
- * TokenProducer在独立线程中运行，定期（每500ms）向TokenManager添加一个token。
+ * @brief Token生产者类 - 按配置速率向TokenManager添加token的线程
+ *
+ * TokenProducer在独立线程中运行，按配置的速率（默认每500ms一个）向TokenManager添加token。
+ * 也可以交给共享的RefillScheduler驱动，此时不再占用独立线程。
+ * 可选地挂接RateController，根据消费者积压和下游反馈自动调整速率。
+ * 运行中可以通过SetRate修改速率，无需重建生产者。
+ * 可以注入ClockSource（例如VirtualClock），在虚拟时间中快速、可重复地运行。
  * 支持优雅停止，可以通过stop()方法停止生产。
  */
 
 #pragma once
 
 #include "token_manager.h"
+#include "rate_controller.h"
+#include "refill_pacer.h"
+#include "refill_scheduler.h"
+#include "cpu_relax.h"
+#include "cache_line.h"
+#include "clock_source.h"
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <thread>
 
+/**
+ * @struct ProducerConfig
+ * @brief 生产者配置
+ *
+ * 默认值等价于原先的行为：每秒2个token（每500ms一个），每次补充1个。
+ *
+ * burst是下限而不是精确值：它小于一个唤醒间隔的产量时，正常节拍也会被截断、实际速率低于rate，
+ * 因此生产者会把它放大到至少4个唤醒间隔的产量（见RefillPacer::FitBurst）。
+ * 例如rate=1e6、min_interval=1ms时，每次唤醒补充约1000个，burst至少为4000。
+ * 需要严格限制单次补充量时应同时减小min_interval。
+ *
+ * 自旋等待的时长不超过当前唤醒间隔的1/kMaxSpinFraction，任何速率下自旋都只占一小部分CPU。
+ */
+struct ProducerConfig {
+    static constexpr int kMaxSpinFraction = 8;            // 自旋最多占唤醒间隔的1/8
+
+    double rate = 2.0;                                   // 每秒产生的token数量，截断到[RefillPacer::kMinRate, kMaxRate]
+    size_t burst = 1;                                    // 单次补充的最大token数量（追赶错过节拍的上限，可能被放大，见上）
+    std::chrono::nanoseconds min_interval{1000000};      // 最短唤醒间隔，速率更高时一次补充多个token
+    std::chrono::nanoseconds spin_window{50000};         // 截止时间前改为自旋等待的时长，0表示只睡眠
+};
+
 /**
  * @class TokenProducer
  * @brief Token生产者类
- * 
- * 在独立线程中运行，定期向TokenManager添加token。
- * 默认每500ms添加一个token，直到达到最大数量或调用stop()。
+ *
+ * 在独立线程中运行，按配置的速率向TokenManager添加token，直到调用stop()。
+ * 采用绝对截止时间调度（sleep_until），每次唤醒按起点累计计算应补充的数量，
+ * 因此调度延迟和加锁耗时不会累积成速率漂移，错过的节拍会在下一次唤醒时补上。
+ * 唤醒间隔较短时使用"先睡眠、再自旋"的混合等待，使节拍更准确。
+ * 如果构造时传入了RefillScheduler，则把补充任务注册到调度器上，由调度器线程统一补充。
  */
 class TokenProducer
 {
 private:
+    using Clock = std::chrono::steady_clock;
+
     std::shared_ptr<TokenManager> token_manager_;  // 共享的TokenManager指针
+    std::shared_ptr<RefillScheduler> scheduler_;   // 共享的补充调度器（为空时使用独立线程）
+    RefillScheduler::RefillId refill_id_{0};       // 在调度器中注册的补充任务ID
     std::thread prod_thread_;                       // 生产者线程
-    std::atomic<bool> running_{false};             // 运行标志（原子变量，线程安全）
+    const ProducerConfig config_;                   // 速率配置
+    std::shared_ptr<RateController> controller_;    // 自适应速率控制器（为空时速率固定）
+    std::shared_ptr<ClockSource> clock_;            // 注入的时钟（为空时使用steady_clock）
+    // 运行标志和目标速率由控制线程写入、生产者线程每轮读取，单独占一个缓存行，不与只读配置共享
+    alignas(kCacheLineSize) std::atomic<bool> running_{false};  // 运行标志（原子变量，线程安全）
+    std::atomic<double> rate_;                      // 目标速率，SetRate修改
+    std::mutex wake_mtx_;                           // 与wake_cond_配合，用于打断睡眠
+    std::condition_variable wake_cond_;             // 速率变化或停止时唤醒生产者线程
+    std::atomic<bool> wake_{false};                 // 有新的速率待生效
 
 public:
     /**
      * @brief 构造函数
      * @param token_manager 共享的TokenManager指针
-     * 
+     * @param config 速率配置（默认每500ms一个token）
+     *
      * 创建生产者对象，但不会自动启动线程。
      * 需要调用start()方法来启动生产线程。
      */
-    TokenProducer(std::shared_ptr<TokenManager> token_manager) : token_manager_(token_manager) {}
-    
+    TokenProducer(std::shared_ptr<TokenManager> token_manager, ProducerConfig config = ProducerConfig())
+        : token_manager_(std::move(token_manager)), config_(config), rate_(RefillPacer::ClampRate(config.rate)) {}
+
+    /**
+     * @brief 构造函数（由共享调度器驱动）
+     * @param token_manager 共享的TokenManager指针
+     * @param scheduler 共享的RefillScheduler，调用方负责启动它
+     * @param config 速率配置，补充精度受调度器tick限制
+     *
+     * start()时不创建线程，而是向调度器注册一个周期补充任务。
+     */
+    TokenProducer(std::shared_ptr<TokenManager> token_manager,
+                  std::shared_ptr<RefillScheduler> scheduler,
+                  ProducerConfig config = ProducerConfig())
+        : token_manager_(std::move(token_manager)), scheduler_(std::move(scheduler)), config_(config),
+          rate_(RefillPacer::ClampRate(config.rate)) {}
+
     /**
      * @brief 析构函数
-     * 
+     *
      * 自动停止生产者线程，确保资源正确释放。
      */
     ~TokenProducer() { stop(); }
 
+    /**
+     * @brief 启用自适应速率
+     * @param controller 速率控制器，需在start()之前设置
+     *
+     * 启用后初始速率取控制器的当前速率，之后每个调整周期根据TokenManager的等待者数量
+     * 和消费者报告的结果（见TokenCustomer::SetTask）重新计算速率。
+     */
+    void SetRateController (std::shared_ptr<RateController> controller) {
+        controller_ = std::move(controller);
+    }
+
+    /**
+     * @brief 注入时钟
+     * @param clock 时钟，需在start()之前设置
+     *
+     * 设置后生产者线程通过clock读取时间和睡眠（不再使用混合自旋），
+     * 使用VirtualClock时生产者线程登记为虚拟时间的参与线程。
+     * 只作用于独立线程模式，由RefillScheduler驱动时按调度器的真实时间补充。
+     */
+    void SetClock (std::shared_ptr<ClockSource> clock) {
+        clock_ = std::move(clock);
+    }
+
+    /**
+     * @brief 在运行中修改速率
+     * @param rate 新的速率（每秒token数），截断到[RefillPacer::kMinRate, kMaxRate]
+     *
+     * 从调用时刻起按新速率补充，已累计的部分不受影响。生产者线程正在睡眠时会被立即唤醒，
+     * 不必等到旧速率下的下一个节拍。使用调度器时转交给RefillScheduler::SetRate。
+     * 启用自适应速率时，下一次调整会以控制器的速率为准。
+     * 可以在start()之前调用（作为初始速率），但不要与start()/stop()并发调用。
+     */
+    void SetRate (double rate) {
+        rate = RefillPacer::ClampRate(rate);
+        rate_.store(rate);
+        if (scheduler_) {
+            if (refill_id_ != 0) {
+                scheduler_->SetRate(refill_id_, rate);
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(wake_mtx_);
+            wake_ = true;
+        }
+        wake_cond_.notify_one();
+        if (clock_) {
+            clock_->Notify();
+        }
+    }
+
+    /**
+     * @brief 获取最近一次设置的速率（截断之后；未启用自适应速率时即当前速率）
+     */
+    double Rate () const {
+        return rate_.load();
+    }
+
     /**
      * @brief 启动生产者线程
-     * 
-     * 创建并启动一个新线程，在该线程中定期生产token。
-     * 每500ms尝试添加一个token（如果未达到最大数量）。
+     *
+     * 创建并启动一个新线程，启动时立即生产一个token，之后按配置速率持续生产。
      * 线程会一直运行直到调用stop()。
+     * 使用调度器时只注册补充任务，不创建线程。
+     * @throw std::runtime_error 调度器拒绝注册补充任务
      */
     void start () {
         running_ = true;
-        prod_thread_ = std::thread([this]() {
+        const double rate = RefillPacer::ClampRate(controller_ ? controller_->Rate() : rate_.load());
+        if (scheduler_) {
+            refill_id_ = scheduler_->Register(token_manager_, rate, config_.burst, controller_);
+            if (refill_id_ == 0) {
+                running_ = false;
+                throw std::runtime_error("TokenProducer: RefillScheduler rejected the refill task");
+            }
+            return;
+        }
+        if (clock_) {
+            clock_->Attach();  // 在创建线程之前登记，线程启动前虚拟时间不会推进
+        }
+        prod_thread_ = std::thread([this, rate]() {
+            if (clock_) {
+                clock_->Bind();
+            }
+            RefillPacer pacer(rate, config_.burst);
+            auto interval = WakeInterval(pacer);
+            const auto epoch = Now();
+            auto grid = epoch;  // 节拍网格的起点，速率变化时重新对齐
+            double applied = controller_ ? rate_.load() : rate;  // 已生效的目标速率
             while (running_.load()) {
-                token_manager_->AddToken();  // 尝试添加token（如果未达到上限）
-                // 等待500ms后再生产下一个token
-                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+                auto now = Now();
+                double elapsed = std::chrono::duration<double>(now - epoch).count();
+                size_t due = pacer.Due(elapsed);
+                if (due > 0) {
+                    token_manager_->AddTokens(due);  // 尝试添加token（超过上限的部分被丢弃）
+                }
+                double target = rate_.load(std::memory_order_relaxed);
+                if (target != applied) {
+                    // SetRate修改了速率：之前的部分已按旧速率结算，从现在起按新速率累计
+                    applied = target;
+                    pacer.SetRate(target, elapsed);
+                    interval = WakeInterval(pacer);
+                    grid = now;
+                }
+                if (controller_ && controller_->Adjust(elapsed, token_manager_->GetWaiters())) {
+                    pacer.SetRate(controller_->Rate(), elapsed);
+                    interval = WakeInterval(pacer);
+                    grid = now;
+                }
+                // 下一个截止时间取节拍网格上晚于当前时间的第一个点，错过的节拍已在上面一并结算
+                auto ticks = (now - grid) / interval + 1;
+                WaitUntil(grid + ticks * interval, interval);
+            }
+            if (clock_) {
+                clock_->Detach();
             }
         });
     }
-    
+
     /**
      * @brief 停止生产者线程
-     * 
+     *
      * 设置运行标志为false，并等待线程结束。
      * 线程会在下一次循环检查时退出。
+     * 使用调度器时取消已注册的补充任务。
      */
     void stop () {
-        running_ = false;  // 设置停止标志
+        {
+            std::lock_guard<std::mutex> lock(wake_mtx_);
+            running_ = false;  // 设置停止标志
+        }
+        wake_cond_.notify_one();  // 打断睡眠，不必等到下一个节拍
+        if (clock_) {
+            clock_->Notify();
+        }
+        if (scheduler_ && refill_id_ != 0) {
+            scheduler_->Cancel(refill_id_);
+            refill_id_ = 0;
+        }
         if (prod_thread_.joinable()) {
-            prod_thread_.join();  // 等待线程结束
+            if (clock_) {
+                clock_->Join(prod_thread_);  // 等待期间不阻止虚拟时间推进
+            } else {
+                prod_thread_.join();  // 等待线程结束
+            }
+        }
+    }
+
+private:
+    // 当前时间（注入了时钟时取时钟的时间）
+    Clock::time_point Now () const {
+        return clock_ ? clock_->Now() : Clock::now();
+    }
+
+    /**
+     * @brief 根据当前速率计算唤醒间隔，并相应放大burst
+     *
+     * 启用自适应速率时唤醒间隔不超过控制器的调整周期，保证低速率下也能及时调整。
+     */
+    std::chrono::nanoseconds WakeInterval (RefillPacer& pacer) const {
+        auto interval = pacer.Interval(config_.min_interval);
+        if (controller_) {
+            interval = std::min(interval, controller_->AdjustInterval());
+        }
+        pacer.FitBurst(interval);
+        return interval;
+    }
+
+    /**
+     * @brief 等待到指定的截止时间
+     *
+     * 距离截止时间超过自旋时长时先睡眠到截止时间前自旋时长处，
+     * 剩余部分自旋等待，以消除睡眠唤醒的抖动。
+     * 自旋时长取spin_window和唤醒间隔的1/kMaxSpinFraction中的较小者，
+     * 避免高速率下唤醒间隔短于spin_window、线程从不睡眠而占满一个核。
+     * 睡眠可以被SetRate或stop()打断，此时立即返回。
+     * 注入了时钟时直接交给时钟等待。
+     */
+    void WaitUntil (Clock::time_point deadline, std::chrono::nanoseconds interval) {
+        if (clock_) {
+            clock_->WaitUntil(deadline, [this]() { return wake_.load() || !running_.load(); });
+            wake_ = false;
+            return;
+        }
+        const auto spin_window = std::min(config_.spin_window, interval / ProducerConfig::kMaxSpinFraction);
+        if (deadline - Clock::now() > spin_window) {
+            std::unique_lock<std::mutex> lock(wake_mtx_);
+            wake_cond_.wait_until(lock, deadline - spin_window, [this]() {
+                return wake_ || !running_.load();
+            });
+            if (wake_ || !running_.load()) {
+                wake_ = false;
+                return;
+            }
+        }
+        while (Clock::now() < deadline && running_.load(std::memory_order_relaxed)) {
+            CpuRelax();
         }
     }
 };
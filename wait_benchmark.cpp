@@ -0,0 +1,95 @@
+/**
+ * @file wait_benchmark.cpp
+ * @brief 等待策略基准测试
+ *
+ * 一个补充线程按固定间隔添加token，一个消费者线程阻塞在ConsumeTokens上，
+ * 测量从AddToken到消费者拿到token的延迟（授予延迟），以及桶空闲时消费者占用的CPU时间。
+ * 对比CondVarWait（默认）、FutexWait、SpinWait和AdaptiveWait：
+ * 补充间隔很短时AdaptiveWait的延迟接近SpinWait，空闲时的CPU占用接近CondVarWait。
+ * 单核机器上AdaptiveWait不自旋，结果与FutexWait相同。
+ *
+ * 编译：g++ -std=c++17 -O2 -pthread wait_benchmark.cpp -o wait_benchmark
+ * 运行：./wait_benchmark [补充间隔微秒] [补充次数]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "token_manager.h"
+
+using SteadyClock = std::chrono::steady_clock;
+
+static int64_t NowNs () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(SteadyClock::now().time_since_epoch()).count();
+}
+
+// 当前线程占用的CPU时间（纳秒）
+static int64_t ThreadCpuNs () {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// 忙等到指定时间，使补充间隔准确
+static void SpinUntil (int64_t deadline_ns) {
+    while (NowNs() < deadline_ns) {
+        CpuRelax();
+    }
+}
+
+template <typename Wait>
+static void Run (const std::string& name, int64_t interval_ns, size_t count) {
+    BasicTokenManager<std::mutex, Wait> manager(1);
+    std::atomic<int64_t> added_ns{0};
+    std::vector<int64_t> latencies;
+    latencies.reserve(count);
+    int64_t idle_cpu_ns = 0;
+
+    std::thread consumer([&]() {
+        for (size_t i = 0; i < count; i++) {
+            manager.ConsumeTokens(1);
+            latencies.push_back(NowNs() - added_ns.load());
+        }
+        // 空闲阶段：200ms内没有任何补充
+        int64_t cpu = ThreadCpuNs();
+        manager.ConsumeTokens(1);
+        idle_cpu_ns = ThreadCpuNs() - cpu;
+    });
+
+    int64_t next = NowNs();
+    for (size_t i = 0; i < count; i++) {
+        next += interval_ns;
+        SpinUntil(next);
+        added_ns = NowNs();
+        manager.AddToken();
+        while (manager.GetTokens() > 0) {}  // 等消费者取走，避免两次补充合并
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    manager.AddToken();
+    consumer.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << name << "\tp50 " << latencies[latencies.size() / 2] / 1000.0 << " us"
+              << "\tp99 " << latencies[latencies.size() * 99 / 100] / 1000.0 << " us"
+              << "\tidle cpu " << idle_cpu_ns / 1e6 << " ms / 200 ms" << std::endl;
+}
+
+int main (int argc, char* argv[]) {
+    int64_t interval_ns = (argc > 1 ? std::strtol(argv[1], nullptr, 10) : 10) * 1000;
+    size_t count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+    std::cout << "refill every " << interval_ns / 1000 << " us, " << count << " grants, "
+              << std::thread::hardware_concurrency() << " cpus" << std::endl;
+
+    Run<CondVarWait>("CondVarWait ", interval_ns, count);
+    Run<FutexWait>("FutexWait   ", interval_ns, count);
+    Run<SpinWait>("SpinWait    ", interval_ns, count);
+    Run<AdaptiveWait>("AdaptiveWait", interval_ns, count);
+    return 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * @file work_stealing_executor.h
+ * @brief 工作窃取线程池 - 用固定数量的线程运行大量轻量任务
+ *
+ * 每个工作线程有自己的任务双端队列：
+ * - 工作线程提交的任务压入自己队列的尾部，并从尾部取出（LIFO，缓存友好）
+ * - 外部线程提交的任务轮流分给各个工作线程
+ * - 自己的队列为空时，从其他线程队列的头部窃取任务（FIFO，减少与队列主人的竞争）
+ * 所有队列都空时工作线程在条件变量上休眠，提交任务时只在有休眠线程时才去唤醒。
+ *
+ * 用于让大量TokenCustomer以任务的形式运行，而不是每个消费者占用一个线程。
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class WorkStealingExecutor
+ * @brief 固定大小的工作窃取线程池
+ *
+ * 任务类型为std::function<void()>。stop()后尚未执行的任务会被丢弃，
+ * 因此应当先停止提交任务的一方（例如先停止消费者），再停止线程池。
+ */
+class WorkStealingExecutor {
+public:
+    using Task = std::function<void()>;
+
+private:
+    // 一个工作线程的任务队列
+    struct Worker {
+        std::mutex mtx;           // 保护tasks
+        std::deque<Task> tasks;   // 任务双端队列：主人从尾部取，窃取者从头部取
+    };
+
+    const size_t thread_count_;                     // 工作线程数量
+    std::vector<std::unique_ptr<Worker>> workers_;  // 每个工作线程的队列
+    std::vector<std::thread> threads_;              // 工作线程
+    std::atomic<bool> running_{false};              // 运行标志
+    std::atomic<size_t> pending_{0};                // 已提交但尚未取走的任务数
+    std::atomic<size_t> sleeping_{0};               // 正在休眠的工作线程数
+    std::atomic<size_t> next_{0};                   // 外部提交时轮询的下一个工作线程
+    std::mutex idle_mtx_;                           // 休眠用的互斥锁
+    std::condition_variable idle_cond_;             // 休眠用的条件变量
+
+    // 当前线程所属的线程池和工作线程下标（非工作线程为nullptr）
+    static WorkStealingExecutor*& CurrentExecutor () {
+        static thread_local WorkStealingExecutor* executor = nullptr;
+        return executor;
+    }
+    static size_t& CurrentIndex () {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+public:
+    /**
+     * @brief 构造函数
+     * @param threads 工作线程数量，0表示使用硬件并发数
+     *
+     * 创建线程池，但不会自动启动线程。需要调用start()方法来启动工作线程。
+     */
+    explicit WorkStealingExecutor(size_t threads = 0)
+        : thread_count_(threads > 0 ? threads : std::max<size_t>(1, std::thread::hardware_concurrency())) {
+        for (size_t i = 0; i < thread_count_; i++) {
+            workers_.emplace_back(new Worker());
+        }
+    }
+
+    /**
+     * @brief 析构函数
+     *
+     * 自动停止所有工作线程。
+     */
+    ~WorkStealingExecutor() { stop(); }
+
+    /**
+     * @brief 提交一个任务
+     * @param task 要执行的任务
+     *
+     * 在工作线程中提交时放入自己的队列，否则轮流放入各个工作线程的队列。
+     */
+    void Submit (Task task) {
+        size_t index = CurrentExecutor() == this ? CurrentIndex() : next_.fetch_add(1, std::memory_order_relaxed) % thread_count_;
+        pending_.fetch_add(1);  // 先计数再入队，保证pending_不会被取走方减成负数
+        {
+            std::lock_guard<std::mutex> lock(workers_[index]->mtx);
+            workers_[index]->tasks.push_back(std::move(task));
+        }
+        // 与工作线程休眠前的检查配对：要么它看到pending_ > 0，要么这里看到它在休眠
+        if (sleeping_.load() > 0) {
+            std::lock_guard<std::mutex> lock(idle_mtx_);
+            idle_cond_.notify_one();
+        }
+    }
+
+    /**
+     * @brief 启动所有工作线程
+     */
+    void start () {
+        running_ = true;
+        for (size_t i = 0; i < thread_count_; i++) {
+            threads_.emplace_back([this, i]() {
+                CurrentExecutor() = this;
+                CurrentIndex() = i;
+                Task task;
+                while (running_.load()) {
+                    if (Take(i, task)) {
+                        task();
+                        task = nullptr;
+                        continue;
+                    }
+                    // 所有队列都为空，休眠直到有新任务或停止
+                    std::unique_lock<std::mutex> lock(idle_mtx_);
+                    sleeping_.fetch_add(1);
+                    idle_cond_.wait(lock, [this]() {
+                        return pending_.load() > 0 || !running_.load();
+                    });
+                    sleeping_.fetch_sub(1);
+                }
+            });
+        }
+    }
+
+    /**
+     * @brief 停止所有工作线程
+     *
+     * 等待正在执行的任务完成后退出，队列中尚未执行的任务被丢弃。
+     */
+    void stop () {
+        {
+            std::lock_guard<std::mutex> lock(idle_mtx_);
+            running_ = false;
+        }
+        idle_cond_.notify_all();
+        for (auto& thread : threads_) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        threads_.clear();
+        for (auto& worker : workers_) {
+            std::lock_guard<std::mutex> lock(worker->mtx);
+            pending_.fetch_sub(worker->tasks.size());
+            worker->tasks.clear();
+        }
+    }
+
+    /**
+     * @brief 获取工作线程数量
+     */
+    size_t ThreadCount () const { return thread_count_; }
+
+    /**
+     * @brief 获取排队中的任务数量
+     */
+    size_t Pending () const { return pending_.load(); }
+
+private:
+    // 先从自己的队列尾部取，再依次从其他队列头部窃取
+    bool Take (size_t self, Task& task) {
+        {
+            Worker& own = *workers_[self];
+            std::lock_guard<std::mutex> lock(own.mtx);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                pending_.fetch_sub(1);
+                return true;
+            }
+        }
+        for (size_t k = 1; k < thread_count_; k++) {
+            Worker& victim = *workers_[(self + k) % thread_count_];
+            std::lock_guard<std::mutex> lock(victim.mtx);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                pending_.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+};